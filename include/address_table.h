@@ -0,0 +1,65 @@
+/*! \file address_table.h
+ *  \brief Layout of the nodes stored in the LMDB address table
+ */
+
+#ifndef ADDRESS_TABLE_H
+#define ADDRESS_TABLE_H
+
+#include <stdint.h>
+
+/*! \enum RegPerm
+ *  Access permission bits of an address table node
+ */
+enum RegPerm : uint8_t {
+    REG_PERM_NONE  = 0x0, /*!< No access */
+    REG_PERM_READ  = 0x1, /*!< Node is readable */
+    REG_PERM_WRITE = 0x2, /*!< Node is writable */
+};
+
+/*! \enum RegMode
+ *  Access mode of an address table node. Modes with the same meaning keep the spelling of the table, which readRegFromDB returns
+ */
+enum RegMode : uint8_t {
+    REG_MODE_UNKNOWN         = 0, /*!< Mode not understood */
+    REG_MODE_SINGLE          = 1, /*!< Single register */
+    REG_MODE_BLOCK           = 2, /*!< Incremental block of registers, "block" */
+    REG_MODE_PORT            = 3, /*!< Non-incremental port/FIFO, "port" */
+    REG_MODE_INCREMENTAL     = 4, /*!< As REG_MODE_BLOCK, "incremental" */
+    REG_MODE_NON_INCREMENTAL = 5, /*!< As REG_MODE_PORT, "non-incremental" */
+    REG_MODE_FIFO            = 6, /*!< As REG_MODE_PORT, "fifo" */
+};
+
+/*! \brief true for the modes whose words are all read from or written to the node address */
+inline bool regModeIsPort(uint8_t mode)
+{
+    return mode == REG_MODE_PORT || mode == REG_MODE_NON_INCREMENTAL || mode == REG_MODE_FIFO;
+}
+
+/*! \enum AddressTableFormat
+ *  Encoding of the values stored in the LMDB address table, recorded under AT_FORMAT_KEY
+ */
+enum AddressTableFormat : uint32_t {
+    AT_FORMAT_TEXT   = 0, /*!< address|permission|mask|mode|size text, tables without a format key */
+    AT_FORMAT_BINARY = 1, /*!< RegRecord */
+};
+
+static constexpr const char * AT_FORMAT_KEY = "__AT_FORMAT_VERSION__"; ///< LMDB key holding the AddressTableFormat of the table
+
+/*! \struct regRecord
+ *  Binary address table value, AT_FORMAT_BINARY.
+ *  Read in place from the LMDB map, LMDB only guarantees 2-byte alignment of values hence the packing.
+ *  Written and read on the same host, so fields are in native byte order
+ */
+typedef struct __attribute__((packed)) regRecord {
+    uint32_t address;  /*!< Register address */
+    uint32_t mask;     /*!< Register mask */
+    uint32_t size;     /*!< Node size in 32-bit words */
+    uint8_t  shift;    /*!< Number of trailing zero bits in the mask */
+    uint8_t  perm;     /*!< Permission bits, see RegPerm */
+    uint8_t  mode;     /*!< Access mode, see RegMode */
+    uint8_t  reserved; /*!< Padding, always 0 */
+} RegRecord;
+
+static_assert(sizeof(RegRecord) == 16, "RegRecord layout is part of the address table format");
+
+#endif
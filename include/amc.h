@@ -9,6 +9,8 @@
 #define AMC_H
 
 #include "utils.h"
+#include "utils/acquisition.h"
+#include "utils/result_stream.h"
 
 /*! \fn unsigned int fw_version_check(const char* caller_name, localArgs *la)
  *  \brief Returns AMC FW version
@@ -41,6 +43,10 @@ void getOHVFATMask(const RPCMsg *request, RPCMsg *response);
  */
 void getOHVFATMaskMultiLink(const RPCMsg *request, RPCMsg *response);
 
+static constexpr uint32_t SBIT_MONITOR_WINDOW_BX       = 4095; ///< Clock cycles recorded by the SBIT Monitor between a reset and its readout
+static constexpr uint32_t SBIT_READOUT_BUFFER_READOUTS = 1024; ///< Readouts buffered by sbitReadOutLocal(...) before they are passed to the result stream
+static constexpr uint32_t SBIT_STREAM_MAX_BYTES        = 16*1024*1024; ///< Byte budget of a streamed sbitReadOut called directly, whose clusters are held in memory until the acquisition ends
+
 /*! \fn std::vector<uint32_t> sbitReadOutLocal(localArgs *la, uint32_t ohN, uint32_t acquireTime, bool *maxNetworkSizeReached)
  *  \brief reads out sbits from optohybrid ohN for a number of seconds given by acquireTime and returns them to the user.
  *  \details The SBIT Monitor stores the 8 SBITs that are sent from the OH (they are all sent at the same time and correspond to the same clock cycle). Each SBIT clusters readout from the SBIT Monitor is a 16 bit word with bits [0:10] being the sbit address and bits [12:14] being the sbit size, bits 11 and 15 are not used.
@@ -50,13 +56,51 @@ void getOHVFATMaskMultiLink(const RPCMsg *request, RPCMsg *response);
  *  \details Each element of the output vector will be a 32 bit word.  Bits [0,10] will the address of the SBIT Cluster, bits [11:13] will be the cluster size, and bits [14:26] will be the difference between the SBIT and the input L1A (if any) in clock cycles.  While the SBIT Monitor stores the difference between the SBIT and input L1A as a 32 bit number (0xFFFFFFFF) any value higher 0xFFF (12 bits) will be truncated to 0xFFF.  This matches the time between readouts of 4095 clock cycles.
  *  \param la Local arguments structure
  *  \param ohN Optical link
- *  \param acquireTime acquisition time on the wall clock in seconds
+ *  \param acquireTime acquisition time in seconds
  *  \param maxNetworkSize pointer to a boolean, set to true if the returned vector reaches a byte count of 65000
  */
 std::vector<uint32_t> sbitReadOutLocal(localArgs *la, uint32_t ohN, uint32_t acquireTime, bool *maxNetworkSizeReached);
 
+/*! \fn std::vector<uint32_t> sbitReadOutLocal(localArgs *la, uint32_t ohN, AcquisitionControl & acq, bool logClusters=false)
+ *  \brief As sbitReadOutLocal(...) above, with the budgets of acq
+ *  \details The byte budget of acq is lowered to the max TCP/IP size, acq.stopReason() is AcquisitionControl::BYTES when it was reached.
+ *  \param la Local arguments structure
+ *  \param ohN Optical link
+ *  \param acq Acquisition time, event and byte budgets, receives the live time, dead time and number of readouts achieved
+ *  \param logClusters Log each valid cluster at DEBUG level
+ */
+std::vector<uint32_t> sbitReadOutLocal(localArgs *la, uint32_t ohN, AcquisitionControl & acq, bool logClusters=false);
+
+/*! \fn void sbitReadOutLocal(localArgs *la, ResultStream & storedSbits, uint32_t ohN, AcquisitionControl & acq, bool logClusters=false)
+ *  \brief As sbitReadOutLocal(...) above, appending the clusters to a result stream
+ *  \details The clusters are passed to the stream by blocks of SBIT_READOUT_BUFFER_READOUTS readouts, and at the end.
+ *           The acquisition also ends if the stream is closed.
+ *           The L1A delay and the clusters of a readout are fetched with one block read, and the monitor is reset for the
+ *           next window under the same MemhubLease; the lease is not held during the window.
+ *           Each readout counts SBIT_MONITOR_WINDOW_BX clock cycles of live time, the rest of the acquisition is dead time.
+ *  \param la Local arguments structure
+ *  \param storedSbits stream receiving the clusters, in the format described above
+ *  \param ohN Optical link
+ *  \param acq Acquisition time, event and byte budgets, an event being a readout with at least one valid cluster
+ *  \param logClusters Log each valid cluster at DEBUG level
+ */
+void sbitReadOutLocal(localArgs *la, ResultStream & storedSbits, uint32_t ohN, AcquisitionControl & acq, bool logClusters=false);
+
 /*! \fn void sbitReadOut(const RPCMsg *request, RPCMsg *response)
  *  \brief readout sbits using the SBIT Monitor.  See the local callable methods documentation for details.
+ *  \details With a "stream" word in the request the readout is limited to SBIT_STREAM_MAX_BYTES instead of 65000 bytes, the clusters are
+ *           fetched with utils.fetchResult, see utils/result_stream.h. The reply is only sent once the acquisition has ended,
+ *           so all the clusters are kept in the card memory until then and fetched afterwards.
+ *  \details Submitted as a calibration job with a "stream" word (see calibration_routines/jobs.h), the clusters are fetched
+ *           while the acquisition runs and the size is not limited. The stream holds RESULT_STREAM_CAPACITY words, once it
+ *           is full the readout waits for the client, which is counted as dead time. Cancelling the job ends the acquisition.
+ *  \details The acquisition time is given by "acquireTimeMs" in milliseconds, or "acquireTime" in seconds. Optional "maxEvents"
+ *           and "maxBytes" words end the acquisition once that many readouts with a valid cluster or bytes have been stored;
+ *           "maxBytes" can only lower the 65000 byte or SBIT_STREAM_MAX_BYTES limit.
+ *  \details The response reports the number of readouts (monitor resets) "nReadouts", the number of stored readouts "nStored",
+ *           the "elapsedTimeUs", "liveTimeUs" and "deadTimeUs" of the acquisition (saturating at 0xffffffff), the achieved
+ *           "readoutRate" in Hz, the "deadTimePerMille" and the AcquisitionControl::StopReason "stopReason".
+ *           A non zero "logClusters" word logs each valid cluster at DEBUG level.
  *  \param request RPC response message
  *  \param response RPC response message
  */
@@ -8,10 +8,12 @@
 #ifndef CALIBRATION_ROUTINES_H
 #define CALIBRATION_ROUTINES_H
 
+#include "calibration_routines/adaptive_scan.h"
 #include <map>
 #include <string>
 #include <tuple>
 #include "utils.h"
+#include "utils/reg_snapshot.h"
 #include <vector>
 
 //This could be imported from xhal legacyPreBoost branch...but I expect ctp7_modules develop to outlive that
@@ -54,22 +56,24 @@ struct vfat3DACAndSize{
     }
 };
 
-/*! \fn std::unordered_map<uint32_t, uint32_t> setSingleChanMask(int ohN, int vfatN, unsigned int ch, localArgs *la)
+/*! \fn void setSingleChanMask(int ohN, int vfatN, unsigned int ch, localArgs *la, RegSnapshot & origMasks)
  *  \brief Unmask the channel of interest and masks all the other
  *  \param ohN Optical link number
  *  \param vfatN VFAT position
  *  \param ch Channel of interest
  *  \param la Local arguments structure
- *  \return Original channel mask in a form of an unordered map <chanMaskAddr, mask>
+ *  \param origMasks Receives the original channel masks, restored with origMasks.restore() or when it goes out of scope
  */
-std::unordered_map<uint32_t, uint32_t> setSingleChanMask(int ohN, int vfatN, unsigned int ch, localArgs *la);
+void setSingleChanMask(int ohN, int vfatN, unsigned int ch, localArgs *la, RegSnapshot & origMasks);
 
-/*! \fn void applyChanMask(std::unordered_map<uint32_t, uint32_t> map_chanOrigMask, localArgs *la)
- *  \brief Applies channel mask
- *  \param map_chanOrigMask Original channel mask as obtained from setSingleChanMask mehod
+/*! \fn void maskAllChannelsLocal(localArgs *la, uint32_t ohN, uint32_t mask, RegSnapshot & origChanRegs)
+ *  \brief Masks all channels and disables their calpulse on the unmasked VFATs of link ohN
  *  \param la Local arguments structure
+ *  \param ohN Optical link number
+ *  \param mask VFAT mask, a value of 1 in the N^th bit indicates the N^th VFAT is masked
+ *  \param origChanRegs Receives the original channel registers, restored with origChanRegs.restore() or when it goes out of scope
  */
-void applyChanMask(std::unordered_map<uint32_t, uint32_t> map_chanOrigMask, localArgs *la);
+void maskAllChannelsLocal(localArgs *la, uint32_t ohN, uint32_t mask, RegSnapshot & origChanRegs);
 
 /*! \fn void confCalPulseLocal(localArgs *la, uint32_t ohN, uint32_t mask, uint32_t ch, bool toggleOn, bool currentPulse, uint32_t calScaleFactor)
  *  \brief Configures the calibration pulse for channel ch on all VFATs of ohN that are not in mask to either be on (toggleOn==true) or off (toggleOn==false).  If ch == 128 and toggleOn == False will write the CALPULSE_ENABLE bit for all channels of all vfats that are not masked on ohN to 0x0.
@@ -176,10 +180,112 @@ void ttcGenConfLocal(localArgs * la, uint32_t ohN, uint32_t mode, uint32_t type,
  */
 void ttcGenConf(const RPCMsg *request, RPCMsg *response);
 
-/*! \fn void genScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useUltra, bool useExtTrig)
+/*! \struct genScanRegs
+ *  \brief Register handles used by the DAC loop of the v3 generic scans, resolved once per scan
+ */
+typedef struct genScanRegs {
+    uint32_t ohN;                    ///< Optical link the handles belong to
+    std::vector<RegHandle> scanReg;  ///< CFG_<scanReg> of the 24 VFATs
+    std::vector<RegHandle> thrArm;   ///< CFG_THR_ARM_DAC of the 24 VFATs
+    std::vector<RegHandle> fireCnt;  ///< VFAT_DAQ_MONITOR CHANNEL_FIRE_COUNT of the 24 VFATs
+    std::vector<RegHandle> goodEvt;  ///< VFAT_DAQ_MONITOR GOOD_EVENTS_COUNT of the 24 VFATs
+    RegHandle l1aCounter;
+    RegHandle daqMonReset;
+    RegHandle daqMonEnable;
+    RegHandle ttcCntReset;
+    RegHandle ttcL1AEnable;
+    RegHandle genCyclicStart;
+    RegHandle genEnable;
+    RegHandle genCyclicRunning;
+} GenScanRegs;
+
+/*! \fn GenScanRegs resolveGenScanRegs(localArgs *la, uint32_t ohN, const std::string & scanReg)
+ *  \brief Resolves the registers used by genScanDacLoopLocal(...)
+ *  \param la Local arguments structure
+ *  \param ohN Optical link
+ *  \param scanReg DAC register to scan over name
+ */
+GenScanRegs resolveGenScanRegs(localArgs *la, uint32_t ohN, const std::string & scanReg);
+
+/*! \fn bool genScanCycleLocal(localArgs *la, const GenScanRegs & regs, uint32_t notmask, const uint32_t *dacVals, uint32_t nevts, bool useExtTrig, std::chrono::microseconds trigTimeout, uint32_t *goodEvts, uint32_t *fireCnts)
+ *  \brief One point of the v3 generic scans: writes scanReg of each VFAT, takes one trigger cycle and reads the VFAT_DAQ_MONITOR
+ *  \param la Local arguments structure
+ *  \param regs Register handles from resolveGenScanRegs(...)
+ *  \param notmask VFATs to measure, a 1 in the n^th bit selects the n^th VFAT
+ *  \param dacVals Value of the scan variable of each VFAT, indexed by VFAT
+ *  \param nevts Number of events per calibration point
+ *  \param useExtTrig Set to 1 in order to use the backplane triggers
+ *  \param trigTimeout Limit on the duration of the trigger cycle, see triggerCycleTimeout(...)
+ *  \param goodEvts Receives the GOOD_EVENTS_COUNT of the 24 VFATs, indexed by VFAT, only those in notmask are meaningful
+ *  \param fireCnts If given, receives the CHANNEL_FIRE_COUNT of the 24 VFATs, as goodEvts
+ *  \returns false if the trigger cycle did not complete
+ */
+bool genScanCycleLocal(localArgs *la, const GenScanRegs & regs, uint32_t notmask, const uint32_t *dacVals, uint32_t nevts, bool useExtTrig, std::chrono::microseconds trigTimeout, uint32_t *goodEvts, uint32_t *fireCnts=nullptr);
+
+/*! \fn bool genScanDacLoopLocal(localArgs *la, const GenScanRegs & regs, uint32_t *outData, uint32_t notmask, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, const std::string & scanReg, bool useExtTrig, std::chrono::microseconds trigTimeout)
+ *  \brief DAC loop of the v3 generic scans: for each DAC value writes scanReg, takes one trigger cycle and reads the VFAT_DAQ_MONITOR
+ *  \details TTC and VFAT_DAQ_MONITOR are expected to be configured by the caller
+ *  \param la Local arguments structure
+ *  \param regs Register handles from resolveGenScanRegs(...)
+ *  \param outData pointer to the results, layout as in genScanLocal(...)
+ *  \param notmask VFATs to scan, a 1 in the n^th bit selects the n^th VFAT
+ *  \param nevts Number of events per calibration point
+ *  \param dacMin Minimal value of scan variable
+ *  \param dacMax Maximal value of scan variable
+ *  \param dacStep Scan variable change step
+ *  \param scanReg DAC register to scan over name
+ *  \param useExtTrig Set to 1 in order to use the backplane triggers
+ *  \param trigTimeout Limit on the duration of one trigger cycle, see triggerCycleTimeout(...)
+ *  \returns false if a trigger cycle did not complete, the remaining points are not scanned
+ */
+bool genScanDacLoopLocal(localArgs *la, const GenScanRegs & regs, uint32_t *outData, uint32_t notmask, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, const std::string & scanReg, bool useExtTrig, std::chrono::microseconds trigTimeout);
+
+/*! \fn bool genScanAdaptiveLoopLocal(localArgs *la, const GenScanRegs & regs, AdaptiveScan & scan, uint32_t nevts, bool useExtTrig, std::chrono::microseconds trigTimeout)
+ *  \brief Replaces genScanDacLoopLocal(...) for an adaptive scan, the points are chosen by scan and their results recorded in it
+ *  \param la Local arguments structure
+ *  \param regs Register handles from resolveGenScanRegs(...)
+ *  \param scan Adaptive scan, see calibration_routines/adaptive_scan.h
+ *  \param nevts Number of events per calibration point
+ *  \param useExtTrig Set to 1 in order to use the backplane triggers
+ *  \param trigTimeout Limit on the duration of one trigger cycle, see triggerCycleTimeout(...)
+ *  \returns false if a trigger cycle did not complete
+ */
+bool genScanAdaptiveLoopLocal(localArgs *la, const GenScanRegs & regs, AdaptiveScan & scan, uint32_t nevts, bool useExtTrig, std::chrono::microseconds trigTimeout);
+
+/*! \fn std::chrono::microseconds triggerCycleTimeout(localArgs *la, uint32_t nevts, bool useExtTrig, uint32_t minTrigRate)
+ *  \brief Upper bound on the time taken by a trigger cycle of nevts L1As, used to bound the scan loops
+ *  \details With the TTC generator this is twice the time needed at the configured CYCLIC_L1A_GAP plus 100 ms.
+ *           With backplane triggers, whose rate is not known, 1 s plus the time for nevts L1As at minTrigRate,
+ *           or std::chrono::microseconds::max(), i.e. no limit, without a minTrigRate.
+ *  \param la Local arguments structure
+ *  \param nevts Number of L1As in the cycle
+ *  \param useExtTrig Triggers come from the backplane
+ *  \param minTrigRate Lowest backplane trigger rate in Hz the cycle may run at, 0 for no limit
+ */
+std::chrono::microseconds triggerCycleTimeout(localArgs *la, uint32_t nevts, bool useExtTrig, uint32_t minTrigRate=0);
+
+/*! \fn bool genScanPrepareLocal(localArgs *la, GenScanRegs & scanRegs, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, const std::string & scanReg, bool useExtTrig)
+ *  \brief Setup of the v3 generic scans: checks the VFAT sync, turns the calpulse on, resolves the registers and configures the TTC and the VFAT_DAQ_MONITOR
+ *  \details The caller turns the calpulse off at the end of the scan
+ *  \param la Local arguments structure
+ *  \param scanRegs Receives the register handles, see resolveGenScanRegs(...)
+ *  \param ohN Optical link
+ *  \param mask VFAT mask
+ *  \param ch Channel of interest
+ *  \param useCalPulse Use  calibration pulse if true
+ *  \param currentPulse Selects whether to use current or volage pulse
+ *  \param calScaleFactor
+ *  \param nevts Number of events per calibration point
+ *  \param scanReg DAC register to scan over name
+ *  \param useExtTrig Set to 1 in order to use the backplane triggers
+ *  \returns false if the scan cannot start, the error is set in the response
+ */
+bool genScanPrepareLocal(localArgs *la, GenScanRegs & scanRegs, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, const std::string & scanReg, bool useExtTrig);
+
+/*! \fn void genScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useUltra, bool useExtTrig, AdaptiveScan *adaptive, uint32_t minTrigRate)
  *  \brief Generic calibration routine. Local callable version of genScan
  *  \param la Local arguments structure
- *  \param outData pointer to the results of the scan
+ *  \param outData pointer to the results of the scan, not used for an adaptive scan
  *  \param ohN Optical link
  *  \param mask VFAT mask
  *  \param ch Channel of interest
@@ -193,16 +299,111 @@ void ttcGenConf(const RPCMsg *request, RPCMsg *response);
  *  \param scanReg DAC register to scan over name
  *  \param useUltra Set to 1 in order to use the ultra scan
  *  \param useExtTrig Set to 1 in order to use the backplane triggers
+ *  \param adaptive If given, the DAC points are chosen by this adaptive scan (v3 electronics only) and the results are recorded in it
+ *  \param minTrigRate Lowest trigger rate in Hz before a point is abandoned with backplane triggers or the ultra scan, 0 for no limit, see triggerCycleTimeout(...)
  */
-void genScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useUltra, bool useExtTrig);
+void genScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useUltra, bool useExtTrig, AdaptiveScan *adaptive=nullptr, uint32_t minTrigRate=0);
 
 /*! \fn void genScan(const RPCMsg *request, RPCMsg *response)
  *  \brief Generic calibration routine
+ *  \details With an "adaptive" word the scan is adaptive, see adaptiveScanFor(...): dacStep is the coarse step and the
+ *           response holds the sparse results in "nPoints" (points of each VFAT), "dacVals" and "data".
+ *           An optional "minTrigRate" word bounds the wait for triggers, see genScanLocal(...); without it the scan waits
+ *           for the backplane triggers without limit.
+ *           With a "stream" word in the request the result arrays are fetched with utils.fetchResult, see utils/result_stream.h
  *  \param request RPC request message
  *  \param response RPC response message
  */
 void genScan(const RPCMsg *request, RPCMsg *response);
 
+/*! \struct latencyScanPeak
+ *  \brief Summary of the latency scan of one VFAT, all fields are 0xdeaddead for a VFAT that was not scanned
+ */
+typedef struct latencyScanPeak {
+    uint32_t latency; ///< Latency with the most hits, 0xdeaddead if there were no hits
+    uint32_t width;   ///< Range of latencies around the peak with at least half of maxHits, in latency units
+    uint32_t maxHits; ///< CHANNEL_FIRE_COUNT at the peak
+} LatencyScanPeak;
+
+/*! \fn LatencyScanPeak findLatencyPeak(const uint32_t *hits, uint32_t nSteps, uint32_t latMin, uint32_t latStep)
+ *  \brief Finds the peak of a latency histogram and its full width at half maximum
+ *  \param hits Hits at latMin, latMin+latStep, ...
+ *  \param nSteps Number of bins of hits
+ *  \param latMin Latency of the first bin
+ *  \param latStep Latency step between bins
+ */
+LatencyScanPeak findLatencyPeak(const uint32_t *hits, uint32_t nSteps, uint32_t latMin, uint32_t latStep);
+
+/*! \fn void latencyScanLocal(localArgs *la, LatencyScanPeak *peaks, std::vector<uint32_t> *histograms, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t latMin, uint32_t latMax, uint32_t latStep, bool useExtTrig, uint32_t minTrigRate)
+ *  \brief Latency scan, v3 electronics only. Histograms the CHANNEL_FIRE_COUNT of each VFAT against CFG_LATENCY and finds its peak
+ *  \details The setup and the trigger cycles are those of genScanLocal(...) with scanReg "LATENCY".
+ *           If a trigger cycle does not complete the scan stops and no peak is reported.
+ *  \param la Local arguments structure
+ *  \param peaks Array of 24 receiving the peak of each VFAT, see findLatencyPeak(...)
+ *  \param histograms If given, receives the hits of each VFAT and latency, VFAT after VFAT, 24*((latMax-latMin)/latStep+1) words
+ *  \param ohN Optical link
+ *  \param mask VFAT mask
+ *  \param ch Channel of interest, 128 for any channel
+ *  \param useCalPulse Use  calibration pulse if true
+ *  \param currentPulse Selects whether to use current or volage pulse
+ *  \param calScaleFactor
+ *  \param nevts Number of events per latency
+ *  \param latMin Minimal latency
+ *  \param latMax Maximal latency
+ *  \param latStep Latency step
+ *  \param useExtTrig Set to 1 in order to use the backplane triggers
+ *  \param minTrigRate Lowest backplane trigger rate in Hz, 0 for no limit, see triggerCycleTimeout(...)
+ */
+void latencyScanLocal(localArgs *la, LatencyScanPeak *peaks, std::vector<uint32_t> *histograms, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t latMin, uint32_t latMax, uint32_t latStep, bool useExtTrig, uint32_t minTrigRate=0);
+
+/*! \fn void latencyScan(const RPCMsg *request, RPCMsg *response)
+ *  \brief Latency scan, see latencyScanLocal(...)
+ *  \details The request holds the words "ohN", "mask", "ch", "nevts", "useCalPulse", "currentPulse", "calScaleFactor" and
+ *           "useExtTrig" of genScan(...), and the latency range in "latMin", "latMax" and "latStep". The genScan(...) names
+ *           "dacMin", "dacMax" and "dacStep" are accepted in their place. An optional "minTrigRate" word is as for genScan(...).
+ *           The response holds the "peakLatency", "peakWidth" and "maxHits" of the 24 VFATs. With a non zero "histograms"
+ *           word the hits of each VFAT and latency are also returned in "data", VFAT after VFAT; with a "stream" word
+ *           in the request "data" is fetched with utils.fetchResult, see utils/result_stream.h.
+ *  \param request RPC request message
+ *  \param response RPC response message
+ */
+void latencyScan(const RPCMsg *request, RPCMsg *response);
+
+/*! \fn void genScanMultiLinkLocal(localArgs *la, uint32_t *outData, uint32_t ohMask, uint32_t NOH, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useExtTrig, uint32_t minTrigRate)
+ *  \brief As genScanLocal(...) but for all optohybrids in ohMask in one call, v3 electronics only
+ *  \details The scan register is written on all selected links at each DAC step before any triggers are sent, and the
+ *           setup (sync check, calpulse, TTC and VFAT_DAQ_MONITOR configuration) is done once for the whole scan.
+ *           The links do not share trigger cycles: the VFAT_DAQ_MONITOR counts the single link selected by OH_SELECT,
+ *           so one trigger cycle is taken per link and DAC step. The trigger time therefore grows with the number of
+ *           links as for successive genScanLocal(...) calls, only the per call setup and the register accesses are saved.
+ *           The VFAT mask of each link is taken from getOHVFATMaskLocal(...), links with an unmasked VFAT out of sync are skipped.
+ *  \param la Local arguments structure
+ *  \param outData pointer to the results of the scan, NOH*24*(dacMax-dacMin+1)/dacStep words, OH major, laid out per OH as in genScanLocal(...); entries of skipped links are 0xdeaddead
+ *  \param ohMask 12 bit mask, a 1 in the n^th bit selects the n^th OH
+ *  \param NOH Number of optohybrids on the AMC
+ *  \param ch Channel of interest
+ *  \param useCalPulse Use  calibration pulse if true
+ *  \param currentPulse Selects whether to use current or volage pulse
+ *  \param calScaleFactor
+ *  \param nevts Number of events per calibration point
+ *  \param dacMin Minimal value of scan variable
+ *  \param dacMax Maximal value of scan variable
+ *  \param dacStep Scan variable change step
+ *  \param scanReg DAC register to scan over name
+ *  \param useExtTrig Set to 1 in order to use the backplane triggers
+ *  \param minTrigRate Lowest backplane trigger rate in Hz, 0 for no limit, see triggerCycleTimeout(...)
+ */
+void genScanMultiLinkLocal(localArgs *la, uint32_t *outData, uint32_t ohMask, uint32_t NOH, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useExtTrig, uint32_t minTrigRate=0);
+
+/*! \fn void genScanMultiLink(const RPCMsg *request, RPCMsg *response)
+ *  \brief As genScan(...) but for all optohybrids on the AMC, see genScanMultiLinkLocal(...) for the trigger cycles taken
+ *  \details Here the RPCMsg request should have a "ohMask" word which specifies which OH's to scan, this is a 12 bit number where a 1 in the n^th bit indicates that the n^th OH should be scanned. An optional "NOH" word limits the number of optohybrids.
+ *  \details With a "stream" word in the request the result arrays are fetched with utils.fetchResult, see utils/result_stream.h
+ *  \param request RPC request message
+ *  \param response RPC response message
+ */
+void genScanMultiLink(const RPCMsg *request, RPCMsg *response);
+
 /*! \fn void sbitRateScanLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outDataTrigRate, uint32_t ohN, uint32_t maskOh, bool invertVFATPos, uint32_t ch, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, uint32_t waitTime)
  *  \brief SBIT rate scan. Local version of sbitRateScan
  *
@@ -230,45 +431,78 @@ void genScan(const RPCMsg *request, RPCMsg *response);
  */
 void sbitRateScanLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outDataTrigRate, uint32_t ohN, uint32_t maskOh, bool invertVFATPos, uint32_t ch, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, uint32_t waitTime);
 
-/*! \fn void sbitRateScanParallelLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outDataTrigRatePerVFAT, uint32_t *outDataTrigRateOverall, uint32_t ohN, uint32_t vfatmask, uint32_t ch, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg)
+static constexpr uint32_t BX_PER_SECOND             = 40079000; ///< LHC bunch crossings per second, the unit of SBIT_CNT_TIME_MAX
+static constexpr uint32_t SBIT_CNT_WINDOW_MARGIN_MS = 5;        ///< Time waited beyond the SBIT counting window before it is read
+
+/*! \fn void sbitRateScanParallelLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outDataTrigRatePerVFAT, uint32_t *outDataTrigRateOverall, uint32_t ch, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, uint32_t ohMask, uint32_t waitTime, AdaptiveScan *adaptive)
  *  \brief Parallel SBIT rate scan. Local version of sbitRateScan
  *
- *  * Measures the SBIT rate seen by OHv3 ohN for the non-masked VFATs defined in vfatmask as a function of scanReg
+ *  * Measures the SBIT rate seen by the OHv3s in ohMask for their non-masked VFATs as a function of scanReg
  *  * Will scan from dacMin to dacMax in steps of dacStep
  *  * The x-values (e.g. scanReg values) will be stored in outDataDacVal
  *  * For each VFAT the y-valued (e.g. rate) will be stored in outDataTrigRatePerVFAT
  *  * For the overall y-value (e.g. rate) will be stored in outDataTrigRateOverall
- *  * Each measured point will take one second
+ *  * Each measured point will take waitTime milliseconds, the counting window is set with SBIT_CNT_TIME_MAX
  *  * The measurement is performed for all channels (ch=128) or a specific channel (0 <= ch <= 127)
+ *  * The counters of a point are read before the next point is programmed and its window started with FPGA.TRIG.CNT.RESET,
+ *    which clears them. Windows are not left to run back to back: the DAC would change inside a counting window and the
+ *    window boundaries, which follow the BX clock, cannot be seen from here
  *
  *  \param la Local arguments structure
  *  \param outDataDacVal
- *  \param outDataTrigRatePerVFAT
+ *  \param outDataTrigRatePerVFAT Rate in Hz
  *  \param outDataTrigRateOverall
- *  \param ohN Optohybrid optical link number
- *  \param vfatMask VFAT mask
  *  \param ch Channel of interest
  *  \param dacMin Minimal value of scan variable
  *  \param dacMax Maximal value of scan variable
  *  \param dacStep Scan variable change step
  *  \param scanReg DAC register to scan over name
+ *  \param ohMask Optohybrids to scan, a 1 in the n^th bit selects the n^th OH
+ *  \param waitTime Measurement duration per point in milliseconds
+ *  \param adaptive If given, an array of 12 adaptive scans, one per optical link, choosing the DAC point of each VFAT.
+ *         The rates in Hz are recorded in them instead of the output arrays, which are not used
  */
-void sbitRateScanParallelLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outDataTrigRatePerVFAT, uint32_t *outDataTrigRateOverall, uint32_t ohN, uint32_t vfatmask, uint32_t ch, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg);
+void sbitRateScanParallelLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outDataTrigRatePerVFAT, uint32_t *outDataTrigRateOverall, uint32_t ch, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, uint32_t ohMask=0x3FF, uint32_t waitTime=1000, AdaptiveScan *adaptive=nullptr);
 
 /*! \fn void sbitRateScan(const RPCMsg *request, RPCMsg *response)
  *  \brief SBIT rate scan. See the local callable methods documentation for details
+ *  \details An optional "waitTime" word (milliseconds, default 1000) is passed to sbitRateScanParallelLocal(...)
+ *  \details With an "adaptive" word the scan is adaptive, see adaptiveScanFor(...): the response then holds the sparse
+ *           per VFAT rates of the 12 links in "nPoints" (12*24 entries), "dacVals" and "data"
+ *  \details With a "stream" word in the request the result arrays are fetched with utils.fetchResult, see utils/result_stream.h
  *  \param request RPC response message
  *  \param response RPC response message
  */
 void sbitRateScan(const RPCMsg *request, RPCMsg *response);
 
-/*! \fn void checkSbitMappingWithCalPulseLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay)
+static constexpr uint32_t SBIT_MONITOR_CLUSTERS = 8; ///< Clusters stored by the SBIT monitor for one clock cycle
+
+/*! \brief Receives the SBIT_MONITOR_CLUSTERS clusters read after pulse iPulse of channel chan of vfatN */
+typedef std::function<void(uint32_t vfatN, uint32_t chan, uint32_t iPulse, const uint32_t *clusters)> SbitMappingPulseHandler;
+
+/*! \fn bool checkSbitMappingVFATsLocal(localArgs *la, uint32_t ohN, uint32_t vfatsToPulse, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay, const SbitMappingPulseHandler & onPulse)
+ *  \brief SBIT mapping loop of checkSbitMappingWithCalPulseLocal(...) over the VFATs of vfatsToPulse
+ *  \details The channel registers and the trigger VFAT mask are saved and all channels masked once, then the channels of
+ *           each VFAT are pulsed in turn. The SBIT monitor clusters of a pulse are read with one batched read and passed
+ *           to onPulse. The other parameters are those of checkSbitMappingWithCalPulseLocal(...)
+ *  \param vfatsToPulse VFATs to test, a 1 in the n^th bit selects the n^th VFAT, none of them may be in mask
+ *  \param onPulse Called with the clusters of each pulse
+ *  \returns false, with an error in the response, if the mapping could not be done
+ */
+bool checkSbitMappingVFATsLocal(localArgs *la, uint32_t ohN, uint32_t vfatsToPulse, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay, const SbitMappingPulseHandler & onPulse);
+
+/*! \fn uint32_t packSbitCluster(uint32_t cluster, uint32_t vfatN, uint32_t chan)
+ *  \brief Packs an SBIT monitor cluster seen when pulsing channel chan of vfatN in the format of checkSbitMappingWithCalPulseLocal(...)
+ */
+uint32_t packSbitCluster(uint32_t cluster, uint32_t vfatN, uint32_t chan);
+
+/*! \fn void checkSbitMappingWithCalPulseLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t vfatN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay)
  *  \brief With all but one channel masked, pulses a given channel, and then checks which sbits are seen by the CTP7, repeats for all channels on vfatN; reports the (vfat,chan) pulsed and (vfat,sbit) observed where sbit=chan*2; additionally reports if the cluster was valid.
  *  \details The SBIT Monitor stores the 8 SBITs that are sent from the OH (they are all sent at the same time and correspond to the same clock cycle). Each SBIT clusters readout from the SBIT Monitor is a 16 bit word with bits [0:10] being the sbit address and bits [12:14] being the sbit size, bits 11 and 15 are not used.
  *  \details The possible values of the SBIT Address are [0,1535].  Clusters with address less than 1536 are considered valid (e.g. there was an sbit); otherwise an invalid (no sbit) cluster is returned.  The SBIT address maps to a given trigger pad following the equation \f$sbit = addr % 64\f$.  There are 64 such trigger pads per VFAT.  Each trigger pad corresponds to two VFAT channels.  The SBIT to channel mapping follows \f$sbit=floor(chan/2)\f$.  You can determine the VFAT position of the sbit via the equation \f$vfatPos=7-int(addr/192)+int((addr%192)/64)*8\f$.
  *  \details The SBIT size represents the number of adjacent trigger pads are part of this cluster.  The SBIT address always reports the lowest trigger pad number in the cluster.  The sbit size takes values [0,7].  So an sbit cluster with address 13 and with size of 2 includes 3 trigger pads for a total of 6 vfat channels and starts at channel \f$13*2=26\f$ and continues to channel \f$(2*15)+1=31\f$.
  *  \param la Local arguments structure
- *  \param outData pointer to an array of size (24*128*8*nevts) which stores the results of the scan, bits [0,7] channel pulsed; bits [8:15] sbit observed; bits [16:20] vfat pulsed; bits [21,25] vfat observed; bit 26 isValid; bits [27,29] are the cluster size
+ *  \param outData pointer to an array of size (128*8*nevts) which stores the results of the scan, bits [0,7] channel pulsed; bits [8:15] sbit observed; bits [16:20] vfat pulsed; bits [21,25] vfat observed; bit 26 isValid; bits [27,29] are the cluster size
  *  \param ohN Optical link
  *  \param vfatN specific vfat position to be tested
  *  \param mask VFATs to be excluded from the trigger
@@ -281,8 +515,18 @@ void sbitRateScan(const RPCMsg *request, RPCMsg *response);
  */
 void checkSbitMappingWithCalPulseLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t vfatN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay);
 
+/*! \fn void checkSbitMappingAllVFATsLocal(localArgs *la, std::vector<uint32_t> & outData, uint32_t ohN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay)
+ *  \brief As checkSbitMappingWithCalPulseLocal(...) for all the VFATs not in mask, in one pass
+ *  \param outData Receives the valid clusters only, packed as by checkSbitMappingWithCalPulseLocal(...), each word
+ *         holds the vfat and channel pulsed
+ */
+void checkSbitMappingAllVFATsLocal(localArgs *la, std::vector<uint32_t> & outData, uint32_t ohN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay);
+
 /*! \fn void checkSbitMappingWithCalPulse(const RPCMsg *request, RPCMsg *response)
  *  \brief Checks the sbit mapping using the calibration pulse. See the local callable methods documentation for details
+ *  \details With a non zero "allVFATs" word all the VFATs not in "mask" are tested, see checkSbitMappingAllVFATsLocal(...),
+ *           otherwise only "vfatN"
+ *  \details With a "stream" word in the request the result arrays are fetched with utils.fetchResult, see utils/result_stream.h
  *  \param request RPC response message
  *  \param response RPC response message
  */
@@ -306,27 +550,118 @@ void checkSbitMappingWithCalPulse(const RPCMsg *request, RPCMsg *response);
  */
 void checkSbitRateWithCalPulseLocal(localArgs *la, uint32_t *outDataCTP7Rate, uint32_t *outDataFPGAClusterCntRate, uint32_t *outDataVFATSBits, uint32_t ohN, uint32_t vfatN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t waitTime, uint32_t pulseRate, uint32_t pulseDelay);
 
+static constexpr uint32_t SBIT_RATE_GROUP_VFATS = 8; ///< VFATs pulsed together by checkSbitRateVFATsLocal(...), one column of the chamber
+
+/*! \fn void checkSbitRateVFATsLocal(localArgs *la, uint32_t *outDataCTP7Rate, uint32_t *outDataFPGAClusterCntRate, uint32_t *outDataVFATSBits, uint32_t ohN, uint32_t vfatsToPulse, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t waitTime, const std::vector<uint32_t> & pulseRates, uint32_t pulseDelay)
+ *  \brief As checkSbitRateWithCalPulseLocal(...) for several VFATs and pulse rates
+ *  \details The VFATs of vfatsToPulse are pulsed together by groups of SBIT_RATE_GROUP_VFATS consecutive VFATs (0-7, 8-15, 16-23).
+ *           These VFATs sit in different eta partitions, so their SBITs are never adjacent and cannot merge into one cluster,
+ *           and each group gives at most one cluster per VFAT, within the 8 clusters the OH sends per clock cycle.
+ *           For each channel all rates of pulseRates are measured in turn, and the VFAT, OH cluster and CTP7 counters
+ *           of a measurement are fetched with one batched read.
+ *           The OH cluster and CTP7 counters count the SBITs of the whole group: the value measured for a channel is the
+ *           rate of all the VFATs pulsed with it, and is repeated in the element of each of these VFATs. It is not a
+ *           per VFAT rate, which is given by outDataVFATSBits; with a group of one VFAT it is the rate of that VFAT alone.
+ *  \param la Local arguments structure
+ *  \param outDataCTP7Rate pointer to an array storing the value of GEM_AMC.TRIGGER.OHX.TRIGGER_RATE for X = ohN; array size 3072 elements per pulse rate,
+ *         idx = 3072 * rateIdx + 128 * vfat + chan. The value is the same for the VFATs pulsed together, see above; elements of VFATs not pulsed are not written
+ *  \param outDataFPGAClusterCntRate as outDataCTP7Rate but for the value of GEM_AMC.OH.OHX.FPGA.TRIG.CNT.CLUSTER_COUNT
+ *  \param outDataVFATSBits as outDataCTP7Rate but for the value of GEM_AMC.OH.OHX.FPGA.TRIG.CNT.VFATY_SBITS, Y being the vfat of the element
+ *  \param ohN Optical link
+ *  \param vfatsToPulse VFATs to be tested, a 1 in the n^th bit selects the n^th VFAT
+ *  \param mask VFATs to be excluded from the trigger
+ *  \param useCalPulse true (false) checks sbit mapping with calpulse on (off); useful for measuring noise
+ *  \param currentPulse Selects whether to use current or volage pulse
+ *  \param calScaleFactor
+ *  \param waitTime Measurement duration per point in milliseconds
+ *  \param pulseRates rates of calpulses to be sent in Hz
+ *  \param pulseDelay delay between CalPulse and L1A
+ */
+void checkSbitRateVFATsLocal(localArgs *la, uint32_t *outDataCTP7Rate, uint32_t *outDataFPGAClusterCntRate, uint32_t *outDataVFATSBits, uint32_t ohN, uint32_t vfatsToPulse, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t waitTime, const std::vector<uint32_t> & pulseRates, uint32_t pulseDelay);
+
 /*! \fn void checkSbitRateWithCalPulse(const RPCMsg *request, RPCMsg *response)
  *  \brief Checks the sbit rate using the calibration pulse. See the local callable methods documentation for details
+ *  \details With a "vfatsToPulse" word or a "pulseRates" array the rates are measured by checkSbitRateVFATsLocal(...),
+ *           for the VFATs of vfatsToPulse (default the single vfatN) and each of the pulseRates (default the single pulseRate),
+ *           and the arrays of the response hold 3072 elements per pulse rate. "outDataCTP7Rate" and "outDataFPGAClusterCntRate"
+ *           are then the rates of the whole group of VFATs pulsed together, repeated for each VFAT of the group.
+ *           With a "stream" word in the request the result arrays are fetched with utils.fetchResult, see utils/result_stream.h
  *  \param request RPC response message
  *  \param response RPC response message
  */
 void checkSbitRateWithCalPulse(const RPCMsg *request, RPCMsg *response);
 
-/*! \fn std::vector<uint32_t> dacScanLocal(localArgs *la, uint32_t ohN, uint32_t dacSelect, uint32_t dacStep=1, uint32_t mask=0xFF000000, bool useExtRefADC=false)
+static constexpr uint32_t DAC_SCAN_ADC_UPDATE_US = 20;  ///< Time for the update of the cached ADC value, including a 50% safety factor
+static constexpr uint32_t DAC_SCAN_RMS_SCALE     = 100; ///< The ADC RMS of dacScanLocal is in units of 1/DAC_SCAN_RMS_SCALE ADC counts
+static constexpr uint32_t DAC_SCAN_SETTLE_S      = 1;   ///< Wait after the VFATs are placed in run mode, before the DAC values are stable
+
+/*! \struct dacScanLink
+ *  \brief Register handles and results of the DAC scan of one optical link
+ */
+typedef struct dacScanLink {
+    uint32_t ohN;                      ///< Optical link
+    uint32_t notmask;                  ///< VFATs scanned, a 1 in the n^th bit selects the n^th VFAT
+    std::vector<RegHandle> dacReg;     ///< Scanned DAC register of the 24 VFATs
+    std::vector<RegHandle> adc;        ///< ADC0 or ADC1 of the 24 VFATs, the cached value if the firmware has it
+    std::vector<RegHandle> adcUpdate;  ///< ADC cache update registers of the 24 VFATs, not valid without ADC cache
+    std::vector<uint32_t> data;        ///< Scan results, as returned by dacScanLocal(...)
+    std::vector<uint32_t> rms;         ///< RMS of the points, as the adcRms of dacScanLocal(...)
+} DacScanLink;
+
+/*! \fn bool dacScanCheckArgsLocal(localArgs *la, uint32_t dacSelect, uint32_t dacStep, uint32_t nReads)
+ *  \brief Checks the firmware version and the arguments of a DAC scan, sets an error in the response if they are not valid
+ */
+bool dacScanCheckArgsLocal(localArgs *la, uint32_t dacSelect, uint32_t dacStep, uint32_t nReads);
+
+/*! \fn bool dacScanPrepareLocal(localArgs *la, DacScanLink & link, uint32_t ohN, uint32_t mask, uint32_t dacSelect, bool useExtRefADC)
+ *  \brief Checks the VFAT sync, resolves the registers of link, configures the DAC monitoring and places the VFATs in run mode
+ *  \details The caller waits DAC_SCAN_SETTLE_S before scanning and takes the VFATs out of run mode afterwards
+ *  \param la Local arguments structure
+ *  \param link Link to prepare
+ *  \param ohN Optical link
+ *  \param mask VFAT mask to use, a value of 1 in the N^th bit indicates the N^th VFAT is masked
+ *  \param dacSelect Monitor Sel for ADC monitoring in VFAT3, must be valid
+ *  \param useExtRefADC if (true) false use the (externally) internally referenced ADC on the VFAT3 for monitoring
+ *  \returns false, with an error in the response, if an unmasked VFAT is not synced
+ */
+bool dacScanPrepareLocal(localArgs *la, DacScanLink & link, uint32_t ohN, uint32_t mask, uint32_t dacSelect, bool useExtRefADC);
+
+/*! \fn void dacScanLoopLocal(localArgs *la, std::vector<DacScanLink> & links, uint32_t dacSelect, uint32_t dacStep, uint32_t nReads, bool parallel)
+ *  \brief Scans the DAC on prepared links and fills their data and rms
+ *  \details The links are on independent slow control links, so the VFATs of all links are sampled together: one VFAT
+ *           position at a time, or all VFATs at once in parallel mode. A sample sets the DAC of the VFATs in one batched
+ *           write, triggers their ADC cache update in one batched read, waits once and reads the ADCs in one batched read.
+ *  \param la Local arguments structure
+ *  \param links Links prepared with dacScanPrepareLocal(...)
+ *  \param dacSelect Monitor Sel for ADC monitoring in VFAT3
+ *  \param dacStep step size to scan the dac in
+ *  \param nReads Number of ADC samples per point
+ *  \param parallel Sample all VFATs of a link together
+ */
+void dacScanLoopLocal(localArgs *la, std::vector<DacScanLink> & links, uint32_t dacSelect, uint32_t dacStep, uint32_t nReads, bool parallel);
+
+/*! \fn std::vector<uint32_t> dacScanLocal(localArgs *la, uint32_t ohN, uint32_t dacSelect, uint32_t dacStep, uint32_t mask, bool useExtRefADC, uint32_t nReads, bool parallel, std::vector<uint32_t> *adcRms)
  *  \brief configures the VFAT3 DAC Monitoring and then scans the DAC and records the measured ADC values for all unmasked VFATs
+ *  \details Each point is the mean of nReads ADC samples, failed reads are left out. By default the VFATs are scanned one
+ *           after the other, in parallel mode they are sampled together, see dacScanLoopLocal(...).
  *  \param la Local arguments structure
  *  \param ohN Optical link
  *  \param dacSelect Monitor Sel for ADC monitoring in VFAT3, see documentation for GBL_CFG_CTR_4 in VFAT3 manual for more details
  *  \param dacStep step size to scan the dac in
  *  \param mask VFAT mask to use, a value of 1 in the N^th bit indicates the N^th VFAT is masked
  *  \param useExtRefADC if (true) false use the (externally) internally referenced ADC on the VFAT3 for monitoring
- *  \return Returns a std::vector<uint32_t> object of size 24*(dacMax-dacMin+1)/dacStep where dacMax and dacMin are described in the VFAT3 manual.  For each element bits [7:0] are the dacValue, bits [17:8] are the ADC readback value in either current or voltage units depending on dacSelect (again, see VFAT3 manual), bits [22:18] are the VFAT position, and bits [26:23] are the optohybrid number.
+ *  \param nReads Number of ADC samples per point
+ *  \param parallel Sample all VFATs together
+ *  \param adcRms If given, receives the RMS of the samples of each point, indexed as the returned data, in units of
+ *         1/DAC_SCAN_RMS_SCALE ADC counts, 0xdeaddead for masked VFATs and if all reads failed
+ *  \return Returns a std::vector<uint32_t> object of size 24*((dacMax-dacMin)/dacStep+1) where dacMax and dacMin are described in the VFAT3 manual.  For each element bits [7:0] are the dacValue, bits [17:8] are the ADC readback value in either current or voltage units depending on dacSelect (again, see VFAT3 manual), bits [22:18] are the VFAT position, and bits [26:23] are the optohybrid number.
  */
-std::vector<uint32_t> dacScanLocal(localArgs *la, uint32_t ohN, uint32_t dacSelect, uint32_t dacStep=1, uint32_t mask=0xFF000000, bool useExtRefADC=false);
+std::vector<uint32_t> dacScanLocal(localArgs *la, uint32_t ohN, uint32_t dacSelect, uint32_t dacStep=1, uint32_t mask=0xFF000000, bool useExtRefADC=false, uint32_t nReads=100, bool parallel=false, std::vector<uint32_t> *adcRms=nullptr);
 
 /*! \fn void dacScan(const RPCMsg *request, RPCMsg *response)
  *  \brief allows the host machine to perform a dacScan for all unmasked VFATs on a given optohybrid, see Local version for details.
+ *  \details Optional "nReads" (default 100) and "parallel" words are passed to dacScanLocal(...), the RMS of the points is
+ *           returned in "dacScanRms"
  *  \param request rpc request message
  *  \param response rpc responce message
  */
@@ -335,13 +670,57 @@ void dacScan(const RPCMsg *request, RPCMsg *response);
 /*! \fn void dacScanMultiLink(const RPCMsg *request, RPCMsg *response)
  *  \brief As dacScan(...) but for all optohybrids on the AMC
  *  \details Here the RPCMsg request should have a "ohMask" word which specifies which OH's to read from, this is a 12 bit number where a 1 in the n^th bit indicates that the n^th OH should be read back.
+ *  \details The "nReads" and "parallel" words are used as in dacScan(...), the RMS of the points is returned in "dacScanRmsAll"
+ *  \details With a "stream" word in the request the result arrays are fetched with utils.fetchResult, see utils/result_stream.h
+ *  \details See dacScanMultiLinkLocal(...)
  *  \param request rpc request message
  *  \param response rpc responce message
  */
 void dacScanMultiLink(const RPCMsg *request, RPCMsg *response);
 
+/*! \fn void dacScanMultiLinkLocal(localArgs *la, std::vector<uint32_t> & dacScanResultsAll, std::vector<uint32_t> & dacScanRmsAll, uint32_t ohMask, uint32_t NOH, uint32_t dacSelect, uint32_t dacStep, bool useExtRefADC, uint32_t nReads, bool parallel)
+ *  \brief As dacScanLocal(...) for the optohybrids in ohMask, local callable version of dacScanMultiLink
+ *  \details All links are configured first and settle together, then they are scanned together with dacScanLoopLocal(...).
+ *           The VFAT mask of each link is taken from getOHVFATMaskLocal(...), links with an unmasked VFAT out of sync are skipped.
+ *  \param la Local arguments structure
+ *  \param dacScanResultsAll Receives the dacScanLocal(...) results of the NOH links one after the other, 0xdeaddead for the links not scanned
+ *  \param dacScanRmsAll Receives the RMS of the points, in the same layout
+ *  \param ohMask Optohybrids to scan, a 1 in the n^th bit selects the n^th OH
+ *  \param NOH Number of optohybrids on the AMC
+ *  \param dacSelect Monitor Sel for ADC monitoring in VFAT3
+ *  \param dacStep step size to scan the dac in
+ *  \param useExtRefADC if (true) false use the (externally) internally referenced ADC on the VFAT3 for monitoring
+ *  \param nReads Number of ADC samples per point
+ *  \param parallel Sample all VFATs of a link together
+ */
+void dacScanMultiLinkLocal(localArgs *la, std::vector<uint32_t> & dacScanResultsAll, std::vector<uint32_t> & dacScanRmsAll, uint32_t ohMask, uint32_t NOH, uint32_t dacSelect, uint32_t dacStep, bool useExtRefADC, uint32_t nReads, bool parallel);
+
+/*! \fn void genChannelScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useUltra, bool useExtTrig, uint32_t minTrigRate)
+ *  \brief genScanLocal(...) for each of the 128 channels. Local callable version of genChannelScan
+ *  \details On v3 electronics the setup of genScanPrepareLocal(...) and the register
+ *           lookups are done once, between channels only VFAT_CHANNEL_SELECT and CALPULSE_ENABLE are changed.
+ *           On v2b electronics genScanLocal(...) is called for each channel.
+ *  \param la Local arguments structure
+ *  \param outData pointer to the results of the scan, 128 consecutive genScanLocal(...) results, one per channel
+ *  \param ohN Optical link
+ *  \param mask VFAT mask
+ *  \param useCalPulse Use  calibration pulse if true
+ *  \param currentPulse Selects whether to use current or volage pulse
+ *  \param calScaleFactor
+ *  \param nevts Number of events per calibration point
+ *  \param dacMin Minimal value of scan variable
+ *  \param dacMax Maximal value of scan variable
+ *  \param dacStep Scan variable change step
+ *  \param scanReg DAC register to scan over name
+ *  \param useUltra Set to 1 in order to use the ultra scan
+ *  \param useExtTrig Set to 1 in order to use the backplane triggers
+ *  \param minTrigRate Lowest trigger rate in Hz, 0 for no limit, as in genScanLocal(...)
+ */
+void genChannelScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useUltra, bool useExtTrig, uint32_t minTrigRate=0);
+
 /*! \fn void genChannelScan(const RPCMsg *request, RPCMsg *response)
  *  \brief Generic per channel scan. See the local callable methods documentation for details
+ *  \details With a "stream" word in the request the result arrays are fetched with utils.fetchResult, see utils/result_stream.h
  *  \param request RPC response message
  *  \param response RPC response message
  */
@@ -0,0 +1,100 @@
+/*!
+ * \file calibration_routines/adaptive_scan.h
+ * \brief Choice of the DAC points of an adaptive scan
+ * \details An adaptive scan makes a coarse pass over the whole DAC range, common to all VFATs, then bisects for each VFAT
+ *          the coarse interval where its response crosses a level: half way up the turn-on curve of an S-curve, or the
+ *          rate at the knee of a threshold scan. Each VFAT has its own scan register, so one measurement refines all of
+ *          them at once and the refinement costs about log2(coarseStep/fineStep) measurements instead of
+ *          coarseStep/fineStep. The result is a sparse list of (dacVal, value) pairs per VFAT.
+ */
+
+#ifndef CALIBRATION_ROUTINES_ADAPTIVE_SCAN_H
+#define CALIBRATION_ROUTINES_ADAPTIVE_SCAN_H
+
+#include "utils.h"
+
+#include <utility>
+#include <vector>
+
+/*! \class AdaptiveScan
+ *  \brief Hands out the DAC value of each VFAT for the next measurement and collects the measured values
+ *  \details The scan loop calls next() to get the points, measures them and passes the values to record(), until
+ *           next() returns 0. A fineStep not smaller than coarseStep gives the plain linear scan.
+ */
+class AdaptiveScan
+{
+  public:
+    typedef std::pair<uint32_t, uint32_t> Point; ///< (dacVal, value)
+
+    /*! \param notmask VFATs to scan, a 1 in the n^th bit selects the n^th VFAT
+     *  \param dacMin Minimal value of scan variable
+     *  \param dacMax Maximal value of scan variable
+     *  \param coarseStep Step of the coarse pass
+     *  \param fineStep Resolution of the refinement, the crossing is located within fineStep
+     */
+    AdaptiveScan(uint32_t notmask, uint32_t dacMin, uint32_t dacMax, uint32_t coarseStep, uint32_t fineStep);
+
+    /*! \brief Excludes the VFATs of vfatMask from the scan, to be called before the first next() */
+    void mask(uint32_t vfatMask) { m_notmask &= ~vfatMask & 0xFFFFFF; }
+
+    /*! \brief Refines around the point where the value crosses min+fraction*(max-min) of the coarse pass (default 0.5) */
+    void setRelativeLevel(double fraction);
+
+    /*! \brief Refines around the point where the value crosses level */
+    void setAbsoluteLevel(uint32_t level);
+
+    /*! \brief Fills dacVals with the DAC value of each VFAT for the next measurement
+     *  \returns the VFATs to measure, 0 once the scan is complete
+     */
+    uint32_t next(uint32_t * dacVals);
+
+    /*! \brief Records the values measured at the points returned by the last next(), indexed by VFAT.
+     *         0xdeaddead marks a failed measurement, the VFAT is then not refined further
+     */
+    void record(const uint32_t * values);
+
+    /*! \brief Measured points of a VFAT, sorted by DAC value */
+    const std::vector<Point> & points(uint32_t vfatN) const { return m_points[vfatN]; }
+
+    /*! \brief Number of measurements expected for the whole scan, used for progress reporting */
+    uint32_t plannedSteps() const;
+
+    uint32_t steps() const { return m_steps; } ///< measurements done so far
+
+    /*! \brief Appends the results: the number of points of each of the 24 VFATs to nPoints, then their DAC values and
+     *         measured values, VFAT after VFAT, to dacVals and values
+     */
+    void appendPoints(std::vector<uint32_t> & nPoints, std::vector<uint32_t> & dacVals, std::vector<uint32_t> & values) const;
+
+  private:
+    enum Phase { COARSE, REFINE, DONE };
+
+    void startRefinement();
+
+    uint32_t m_notmask;
+    uint32_t m_dacMin, m_dacMax, m_coarseStep, m_fineStep;
+    bool     m_relative;
+    double   m_fraction;
+    uint32_t m_level;
+
+    Phase    m_phase;
+    uint32_t m_coarseVal;    ///< next point of the coarse pass
+    uint32_t m_measuring;    ///< VFATs handed out by the last next()
+    uint32_t m_refining;     ///< VFATs whose crossing is not located yet
+    uint32_t m_steps;
+
+    uint32_t m_dacVals[24];  ///< points handed out by the last next()
+    uint32_t m_lo[24];       ///< bracket of the crossing of each VFAT
+    uint32_t m_hi[24];
+    bool     m_loAbove[24];  ///< value at m_lo is at or above the level
+    uint32_t m_vfatLevel[24];
+    std::vector<Point> m_points[24];
+};
+
+/*! \fn AdaptiveScan adaptiveScanFor(const RPCMsg *request, uint32_t notmask, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep)
+ *  \brief Adaptive scan requested by an RPC call: dacStep is the coarse step, the request may hold the "fineStep"
+ *         (default 1) and either an absolute "level" or a "levelPercent" of the coarse pass range (default 50)
+ */
+AdaptiveScan adaptiveScanFor(const RPCMsg *request, uint32_t notmask, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep);
+
+#endif
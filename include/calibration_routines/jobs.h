@@ -0,0 +1,91 @@
+/*!
+ * \file calibration_routines/jobs.h
+ * \brief Background execution of the calibration scans
+ * \details submitJob queues a call of one of the scan methods and returns at once with its "jobId". The scans run one
+ *          at a time on a worker thread, so the connection stays available for other requests. jobStatus reports the
+ *          progress, cancelJob stops a scan at the next scan point (the scan still restores the front-end
+ *          configuration it changed) and jobResult returns the response the method would have returned.
+ *          Jobs live in the rpcsvc process of the connection that submitted them and end with it.
+ */
+
+#ifndef CALIBRATION_ROUTINES_JOBS_H
+#define CALIBRATION_ROUTINES_JOBS_H
+
+#include "utils.h"
+
+static constexpr uint32_t CAL_JOB_MAX         = 16; ///< Finished jobs kept per connection, the oldest one is dropped beyond this
+static constexpr uint32_t CAL_JOB_EXIT_WAIT_S = 10; ///< Time given to a cancelled scan to restore the front-end when the process exits, after which the process is ended through die()
+
+/*! \enum CalJobState
+ *  Life cycle of a job, reported in the "state" word of jobStatus
+ */
+enum CalJobState {
+    CAL_JOB_QUEUED    = 0, ///< waiting for the worker
+    CAL_JOB_RUNNING   = 1, ///< scan in progress
+    CAL_JOB_DONE      = 2, ///< scan finished, the result is available
+    CAL_JOB_CANCELLED = 3, ///< cancelled, the result of a scan cancelled while running holds the points taken so far
+};
+
+/*! \fn bool calJobCancelled()
+ *  \brief Checked by the scan loops at each scan point
+ *  \returns true if the scan runs as a job and its cancellation was requested, always false for a synchronous call
+ */
+bool calJobCancelled();
+
+/*! \fn void calJobStage(uint32_t stage, uint32_t nStages)
+ *  \brief Splits the progress of a scan made of several sub-scans (channels, links), the progress reported by
+ *         calJobProgress is then that of stage out of nStages. Does nothing outside a job
+ */
+void calJobStage(uint32_t stage, uint32_t nStages);
+
+/*! \fn void calJobProgress(uint32_t done, uint32_t total, uint32_t ohN, uint32_t vfatN, uint32_t dacVal)
+ *  \brief Reports the progress of the current stage and the point being scanned. Does nothing outside a job
+ *  \param done Scan points done in this stage
+ *  \param total Scan points of this stage
+ *  \param ohN Optical link being scanned
+ *  \param vfatN VFAT being scanned, 0xffffffff if all of them are scanned together
+ *  \param dacVal Current value of the scan variable, the channel for the scans looping over channels
+ */
+void calJobProgress(uint32_t done, uint32_t total, uint32_t ohN, uint32_t vfatN, uint32_t dacVal);
+
+/*! \fn void submitJob(const RPCMsg *request, RPCMsg *response)
+ *  \brief Queues a scan
+ *  \details The request holds the scan method in the "job" string (dacScan, dacScanMultiLink, genScan, genScanMultiLink,
+ *           genChannelScan, latencyScan, sbitRateScan, checkSbitMappingWithCalPulse, checkSbitRateWithCalPulse or the
+ *           amc sbitReadOut) together with the parameters of that method. The response holds the "jobId".
+ *           With a "stream" word the response also holds a "streamId": the result arrays of the methods that accept
+ *           "stream" are then fetched with utils.fetchResult, using the streamId as its "jobId", while the scan runs.
+ *           Each array is buffered up to RESULT_STREAM_CAPACITY words, beyond which the scan waits for the client,
+ *           see utils/result_stream.h. Cancelling the job discards the results not fetched yet.
+ *  \param request RPC request message
+ *  \param response RPC response message
+ */
+void submitJob(const RPCMsg *request, RPCMsg *response);
+
+/*! \fn void jobStatus(const RPCMsg *request, RPCMsg *response)
+ *  \brief Reports the state of job "jobId"
+ *  \details The response holds the "job" method, the "state" (see CalJobState), the "percent" complete, the current
+ *           "ohN", "vfatN" and "dacVal", and the "elapsedMs" since the scan started.
+ *  \param request RPC request message
+ *  \param response RPC response message
+ */
+void jobStatus(const RPCMsg *request, RPCMsg *response);
+
+/*! \fn void cancelJob(const RPCMsg *request, RPCMsg *response)
+ *  \brief Cancels job "jobId"
+ *  \details A queued job is dropped, a running scan stops at its next scan point. The call does not wait for the scan
+ *           to stop, jobStatus reports CAL_JOB_CANCELLED once it has. The response holds the "state".
+ *  \param request RPC request message
+ *  \param response RPC response message
+ */
+void cancelJob(const RPCMsg *request, RPCMsg *response);
+
+/*! \fn void jobResult(const RPCMsg *request, RPCMsg *response)
+ *  \brief Returns the response of the scan of job "jobId" and forgets the job
+ *  \details Fails with an error while the job is queued or running.
+ *  \param request RPC request message
+ *  \param response RPC response message
+ */
+void jobResult(const RPCMsg *request, RPCMsg *response);
+
+#endif
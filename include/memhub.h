@@ -21,10 +21,119 @@ int memhub_close(memsvc_handle_t *handle);
  */
 int memhub_read(memsvc_handle_t handle, uint32_t addr, uint32_t words, uint32_t *data);
 int memhub_write(memsvc_handle_t handle, uint32_t addr, uint32_t words, const uint32_t *data);
+
+/* Hold the semaphore across several memhub_read/memhub_write calls, so a batch of transfers is not interleaved
+ * with other processes. Calls nest, the semaphore is released by the outermost memhub_unlock().
+ * These functions return -1 on error and 0 on success.
+ */
+int memhub_lock(void);
+int memhub_unlock(void);
+
+/* Statistics of the memhub lock backend. The POSIX semaphore (default) keeps them per process,
+ * the robust mutex backend (built with -DMEMHUB_ROBUST_MUTEX) keeps them in shared memory for all processes.
+ * A hold is the time from the outermost memhub_lock() to the matching memhub_unlock(), leases included.
+ */
+typedef struct memhub_lock_stats {
+    uint64_t acquisitions;   /* number of times the lock was taken */
+    uint64_t contended;      /* number of acquisitions that had to wait for another holder */
+    uint64_t owner_deaths;   /* number of times the lock was recovered from a dead owner */
+    uint64_t total_wait_ns;  /* sum of the time spent waiting for the lock */
+    uint64_t max_wait_ns;    /* longest wait for the lock */
+    uint64_t total_hold_ns;  /* sum of the time the lock was held */
+    uint64_t max_hold_ns;    /* longest hold of the lock */
+    uint64_t lease_yields;   /* number of times a lease released the lock after max_hold_us */
+    uint64_t lease_handoffs; /* lease yields after which another holder took the lock first */
+} memhub_lock_stats_t;
+
+void memhub_lock_get_stats(memhub_lock_stats_t *stats);
+
+/* Access statistics, kept in the /memhub_stats shared memory segment so any process can read them.
+ * Every memhub_read/memhub_write is accounted to the calling process and to the current context, normally the
+ * RPC method being served (set by GETLOCALARGS). Latencies are histogrammed in log2 bins: bin i counts accesses
+ * that took [2^i, 2^(i+1)) ns, the last bin also counts anything slower.
+ */
+#define MEMHUB_STATS_HIST_BINS 32
+#define MEMHUB_STATS_NAME_LEN 48
+#define MEMHUB_STATS_CONTEXTS 128 /* context slots, shared by all processes */
+#define MEMHUB_STATS_PROCESSES 64 /* process slots, reclaimed once the process is gone */
+
+enum memhub_access_kind {
+    MEMHUB_ACCESS_READ  = 0,
+    MEMHUB_ACCESS_WRITE = 1,
+    MEMHUB_ACCESS_KINDS = 2
+};
+
+typedef struct memhub_access_stats {
+    uint64_t calls[MEMHUB_ACCESS_KINDS];     /* number of memhub_read/memhub_write calls */
+    uint64_t words[MEMHUB_ACCESS_KINDS];     /* number of 32-bit words transferred */
+    uint64_t wait_ns[MEMHUB_ACCESS_KINDS];   /* time spent waiting for the lock */
+    uint64_t memsvc_ns[MEMHUB_ACCESS_KINDS]; /* time spent in memsvc_read/memsvc_write */
+    uint64_t wait_hist[MEMHUB_ACCESS_KINDS][MEMHUB_STATS_HIST_BINS];
+    uint64_t memsvc_hist[MEMHUB_ACCESS_KINDS][MEMHUB_STATS_HIST_BINS];
+} memhub_access_stats_t;
+
+typedef struct memhub_stats_slot {
+    uint32_t state;                     /* 0 free, 1 being claimed, 2 in use */
+    int32_t pid;                        /* owning process of a process slot, 0 for context slots */
+    char name[MEMHUB_STATS_NAME_LEN];   /* context name, NUL terminated */
+    memhub_access_stats_t stats;
+} memhub_stats_slot_t;
+
+typedef struct memhub_stats_table {
+    memhub_stats_slot_t contexts[MEMHUB_STATS_CONTEXTS];
+    memhub_stats_slot_t processes[MEMHUB_STATS_PROCESSES];
+} memhub_stats_table_t;
+
+/* Sets the context further accesses of this process are accounted to, NULL to stop accounting to a context */
+void memhub_set_context(const char *name);
+/* Returns the shared statistics table, NULL if it could not be mapped */
+const memhub_stats_table_t *memhub_get_stats_table(void);
+/* Zeroes all counters of all slots */
+void memhub_reset_stats(void);
+
+/* A lease holds the lock for a burst of accesses, e.g. a polling loop, instead of taking it around every word.
+ * memhub_lease_yield() should be called between accesses: once the lease has been held for longer than max_hold_us
+ * it releases the lock and takes it again, so other processes and threads are not starved.
+ * A lease taken while the thread already holds the lock nests in it and never yields.
+ * The lock must not be held across a sleep, release the lease first.
+ */
+#define MEMHUB_LEASE_MAX_HOLD_US 1000 /* default maximum hold time of a lease, in microseconds */
+
+typedef struct memhub_lease {
+    uint64_t start_ns;    /* monotonic time at which the lock was taken or last yielded, 0 if not held */
+    uint32_t max_hold_us; /* hold time after which memhub_lease_yield releases the lock */
+    uint32_t yields;      /* number of times this lease released the lock */
+} memhub_lease_t;
+
+/* These functions return -1 on error and 0 on success, memhub_lease_yield returns 1 if the lock was released */
+int memhub_lease_acquire(memhub_lease_t *lease, uint32_t max_hold_us);
+int memhub_lease_yield(memhub_lease_t *lease);
+int memhub_lease_release(memhub_lease_t *lease);
+
 void die(int signo);
 
 #ifdef __cplusplus
 }
+
+/* Scoped lease, released when it goes out of scope */
+class MemhubLease
+{
+  public:
+    explicit MemhubLease(uint32_t max_hold_us = MEMHUB_LEASE_MAX_HOLD_US) { memhub_lease_acquire(&m_lease, max_hold_us); }
+    ~MemhubLease() { release(); }
+
+    /* Lets other processes in if the lease has been held for longer than its maximum hold time */
+    bool yield() { return memhub_lease_yield(&m_lease) == 1; }
+
+    /* Releases the lock before the end of the scope, e.g. before sleeping */
+    void release() { if (m_lease.start_ns != 0) memhub_lease_release(&m_lease); }
+
+  private:
+    MemhubLease(const MemhubLease&) = delete;
+    MemhubLease& operator=(const MemhubLease&) = delete;
+
+    memhub_lease_t m_lease;
+};
 #endif
 
 #endif
@@ -0,0 +1,28 @@
+/*! \file mock/libmemsvc.h
+ *  \brief memsvc API for host builds, where the PetaLinux sysroot providing libmemsvc.h is not available
+ *  \details Only on the include path of the host builds (HOST=1, make mock, make bench), the board builds use the
+ *           header of the sysroot. The declarations are those of libmemsvc, implemented by src/mock/memsvc.cpp.
+ */
+
+#ifndef MOCK_LIBMEMSVC_H
+#define MOCK_LIBMEMSVC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct memsvc_handle *memsvc_handle_t;
+
+int memsvc_open(memsvc_handle_t *handle);
+int memsvc_close(memsvc_handle_t *handle);
+const char *memsvc_get_last_error(memsvc_handle_t handle);
+int memsvc_read(memsvc_handle_t handle, uint32_t addr, uint32_t words, uint32_t *data);
+int memsvc_write(memsvc_handle_t handle, uint32_t addr, uint32_t words, const uint32_t *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
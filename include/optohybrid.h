@@ -94,7 +94,7 @@ void configureScanModule(const RPCMsg *request, RPCMsg *response);
  */
 void configureVFATs(const RPCMsg *request, RPCMsg *response);
 
-/*! \fn void getUltraScanResultsLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep)
+/*! \fn void getUltraScanResultsLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, uint32_t minTrigRate)
  *  \brief Local callable version of getUltraScanResults
  *  \param la Local arguments structure
  *  \param outData Pointer to output data array
@@ -102,11 +102,13 @@ void configureVFATs(const RPCMsg *request, RPCMsg *response);
  *  \param dacMin Minimal value of scan variable
  *  \param dacMax Maximal value of scan variable
  *  \param dacStep Scan variable change step
+ *  \param minTrigRate Lowest average trigger rate in Hz the scan may run at before it is abandoned, 0 to wait without limit
  */
-void getUltraScanResultsLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep);
+void getUltraScanResultsLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, uint32_t minTrigRate=0);
 
 /*! \fn void getUltraScanResults(const RPCMsg *request, RPCMsg *response)
  *  \brief Returns results of an ultra scan routine
+ *  \details An optional "minTrigRate" word bounds the wait for the scan, see getUltraScanResultsLocal(...)
  *  \param request RPC response message
  *  \param response RPC response message
  */
@@ -10,10 +10,13 @@
 #include "moduleapi.h"
 //#include <libmemsvc.h>
 #include "memhub.h"
+#include "address_table.h"
 #include "lmdb_cpp_wrapper.h"
 #include "xhal/utils/XHALXMLParser.h"
 
 #include <unistd.h>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -34,22 +37,79 @@ typedef struct localArgs {
     RPCMsg *response; /*!< RPC response message */
 } LocalArgs;
 
+/*! \struct regInfo
+ *  Compiled properties of an address table node, as stored in the LMDB address table
+ */
+typedef struct regInfo {
+    uint32_t address; /*!< Register address */
+    uint32_t mask;    /*!< Register mask */
+    uint32_t shift;   /*!< Number of trailing zero bits in the mask */
+    uint32_t size;    /*!< Node size in 32-bit words */
+    uint8_t  perm;    /*!< Permission bits, see RegPerm */
+    uint8_t  mode;    /*!< Access mode, see RegMode */
+} RegInfo;
+
+/*! \struct regHandle
+ *  Register resolved once from the address table, read and written without any name formatting or lookup
+ */
+typedef struct regHandle {
+    std::string name; /*!< Resolved register name, used in error messages */
+    RegInfo info;     /*!< Compiled register properties */
+    bool valid;       /*!< false if the register is not in the address table */
+} RegHandle;
+
+static constexpr uint32_t LMDB_SIZE = 1UL * 1024UL * 1024UL * 50UL; ///< Maximum size of the LMDB object, currently 50 MiB
+
+/*! \fn bool openAddressTable()
+ *  \brief Opens the LMDB address table environment, database handle and reader transaction shared by all modules
+ *  \details Called from module_init, subsequent calls are no-ops.
+ *           LMDB does not allow the same environment to be opened twice in one process, so there is a single set of
+ *           handles living in the utils library. On failure the open is retried on the next RPC call.
+ *  \returns true if the address table is open
+ */
+bool openAddressTable();
+
+/*! \fn lmdb::dbi & getAddressTableDbi()
+ *  \brief Returns the shared address table database handle
+ */
+lmdb::dbi & getAddressTableDbi();
+
+/*! \class ScopedReadTxn
+ *  \brief Holds the shared address table reader transaction for the lifetime of an RPC call
+ *  \details The constructor renews the reader transaction with mdb_txn_renew, the destructor releases it
+ *           with mdb_txn_reset, so no environment, database or transaction is created per call.
+ *           Nested instances share the same snapshot. Each thread has its own reader transaction.
+ */
+class ScopedReadTxn
+{
+  public:
+    ScopedReadTxn();
+    ~ScopedReadTxn();
+
+    /*! \brief Releases the snapshot before leaving scope, the transaction itself is kept for the next call
+     */
+    void abort();
+
+    operator lmdb::txn&();
+
+  private:
+    ScopedReadTxn(const ScopedReadTxn&) = delete;
+    ScopedReadTxn& operator=(const ScopedReadTxn&) = delete;
+
+    bool m_active;
+};
+
 /*!
  * \brief returns a set up LocalArgs structure
+ * \details The shared reader transaction is renewed and stays active until the next GETLOCALARGS scope ends
  */
 LocalArgs getLocalArgs(RPCMsg *response);
 
-static constexpr uint32_t LMDB_SIZE = 1UL * 1024UL * 1024UL * 50UL; ///< Maximum size of the LMDB object, currently 50 MiB
-
 // FIXME: to be replaced with the above function when the struct is properly implemented
 #define GETLOCALARGS(response)                                  \
-    auto env = lmdb::env::create();                             \
-    env.set_mapsize(LMDB_SIZE);                                 \
-    std::string gem_path       = std::getenv("GEM_PATH");       \
-    std::string lmdb_data_file = gem_path+"/address_table.mdb"; \
-    env.open(lmdb_data_file.c_str(), 0, 0664);                  \
-    auto rtxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);     \
-    auto dbi  = lmdb::dbi::open(rtxn, nullptr);                 \
+    memhub_set_context(__func__);                               \
+    ScopedReadTxn rtxn;                                         \
+    lmdb::dbi & dbi = getAddressTableDbi();                     \
     LocalArgs la = {.rtxn     = rtxn,                           \
                     .dbi      = dbi,                            \
                     .response = response};
@@ -70,6 +130,84 @@ std::vector<std::string> split(const std::string &s, char delim);
 
 std::string serialize(xhal::utils::Node n);
 
+/*! \fn RegRecord serializeRecord(const xhal::utils::Node & n)
+ *  \brief Returns the binary address table value of a node
+ *  \param n Parsed address table node
+ */
+RegRecord serializeRecord(const xhal::utils::Node & n);
+
+/*! \fn bool parseRegInfo(const lmdb::val & db_res, RegInfo & info)
+ *  \brief Decodes an LMDB address table value into a RegInfo structure
+ *  \details Binary values are read in place, text values of tables without AT_FORMAT_KEY are parsed. The format is the one of the table seen by the read transaction of the calling thread
+ *  \param db_res LMDB call result
+ *  \param info RegInfo structure to fill
+ *  \returns true if the value could be decoded
+ */
+bool parseRegInfo(const lmdb::val & db_res, RegInfo & info);
+
+/*! \fn const RegInfo * getRegInfo(LocalArgs * la, const std::string & regName)
+ *  \brief Returns the compiled properties of a register
+ *  \details The first lookup of a register decodes its LMDB node into a process-wide cache keyed by register name,
+ *           later lookups of the same register are a single hash lookup. Only the registers actually used are decoded.
+ *           The cache is dropped whenever a new address table has been committed, which is checked each time the
+ *           reader transaction is renewed.
+ *  \param la Local arguments structure
+ *  \param regName Register name
+ *  \returns pointer to the cached node, or nullptr if the register is not in the address table
+ */
+const RegInfo * getRegInfo(LocalArgs * la, const std::string & regName);
+
+/*! \fn std::string formatRegName(const std::string & pattern, const std::vector<uint32_t> & indices)
+ *  \brief Replaces each "{}" in pattern by the next index, in order
+ *  \param pattern Register name pattern, e.g. "GEM_AMC.OH.OH{}.GEB.VFAT{}.CFG_RUN"
+ *  \param indices Values substituted for the placeholders
+ */
+std::string formatRegName(const std::string & pattern, const std::vector<uint32_t> & indices);
+
+/*! \fn RegHandle resolveReg(LocalArgs * la, const std::string & regName)
+ *  \brief Resolves a register name to a handle
+ *  \param la Local arguments structure
+ *  \param regName Register name
+ *  \returns the register handle, not valid if the register is not in the address table
+ */
+RegHandle resolveReg(LocalArgs * la, const std::string & regName);
+
+/*! \fn RegHandle resolve(LocalArgs * la, const std::string & pattern, Idx... indices)
+ *  \brief Resolves a register name pattern to a handle, e.g. resolve(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.CFG_RUN", ohN, vfatN)
+ *  \param la Local arguments structure
+ *  \param pattern Register name pattern, see formatRegName
+ *  \param indices Values substituted for the "{}" placeholders, in order
+ */
+template<typename... Idx>
+RegHandle resolve(LocalArgs * la, const std::string & pattern, Idx... indices)
+{
+    return resolveReg(la, formatRegName(pattern, {static_cast<uint32_t>(indices)...}));
+}
+
+/*! \fn std::vector<RegHandle> resolveFamily(LocalArgs * la, const std::string & pattern, uint32_t count, Idx... indices)
+ *  \brief Resolves an indexed family of registers, the last "{}" of the pattern runs from 0 to count-1
+ *  \details e.g. resolveFamily(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.CFG_RUN", oh::VFATS_PER_OH, ohN) returns one handle per VFAT
+ *  \param la Local arguments structure
+ *  \param pattern Register name pattern, see formatRegName
+ *  \param count Number of members of the family
+ *  \param indices Values substituted for the leading "{}" placeholders, in order
+ */
+template<typename... Idx>
+std::vector<RegHandle> resolveFamily(LocalArgs * la, const std::string & pattern, uint32_t count, Idx... indices)
+{
+    std::vector<RegHandle> family;
+    family.reserve(count);
+    for (uint32_t idx = 0; idx < count; ++idx) {
+        family.push_back(resolveReg(la, formatRegName(pattern, {static_cast<uint32_t>(indices)..., idx})));
+    }
+    return family;
+}
+
+/*! \fn void invalidateRegInfoCache()
+ *  \brief Drops the compiled register cache, it is refilled by the next lookups
+ */
+void invalidateRegInfoCache();
+
 /*! \brief This macro is used to terminate a function if an error occurs. It logs the message, write it to the `error` RPC key and returns the `error_code` value.
  *  \param response A pointer to the RPC response object.
  *  \param message The `std::string` error message.
@@ -130,6 +268,21 @@ void writeAddress(lmdb::val & db_res, uint32_t value, RPCMsg *response);
  */
 uint32_t readAddress(lmdb::val & db_res, RPCMsg *response);
 
+/*! \fn void writeAddress(const RegInfo & reg, uint32_t value, RPCMsg *response)
+ *  \brief Writes given value to the register address. Register mask is not applied
+ *  \param reg Compiled register properties
+ *  \param value Value to write
+ *  \param response RPC response message
+ */
+void writeAddress(const RegInfo & reg, uint32_t value, RPCMsg *response);
+
+/*! \fn uint32_t readAddress(const RegInfo & reg, RPCMsg *response)
+ *  \brief Reads the value at the register address. Register mask is not applied
+ *  \param reg Compiled register properties
+ *  \param response RPC response message
+ */
+uint32_t readAddress(const RegInfo & reg, RPCMsg *response);
+
 /*! \fn void writeRawReg(LocalArgs * la, const std::string & regName, uint32_t value)
  *  \brief Writes a value to a raw register. Register mask is not applied
  *  \param la Local arguments structure
@@ -159,6 +312,25 @@ uint32_t applyMask(uint32_t data, uint32_t mask);
  */
 uint32_t readReg(LocalArgs * la, const std::string & regName);
 
+/*! \fn uint32_t readReg(LocalArgs * la, const RegHandle & reg)
+ *  \brief Reads a value from a resolved register. Register mask is applied. Will return 0xdeaddead if register is no accessible
+ *  \param la Local arguments structure
+ *  \param reg Register handle
+ */
+uint32_t readReg(LocalArgs * la, const RegHandle & reg);
+
+/*! \fn uint32_t readRegs(LocalArgs * la, const std::vector<RegHandle> & regs, uint32_t * result)
+ *  \brief Reads a set of registers under a single memhub lock. Register masks are applied
+ *  \details Registers are sorted by address and registers sharing or following on from the previous address are
+ *           fetched with one memhub_read block transfer. Port (FIFO) registers are always read on their own.
+ *           Entries that are not accessible are set to 0xdeaddead, as readReg does.
+ *  \param la Local arguments structure
+ *  \param regs Register handles
+ *  \param result Array of regs.size() words receiving the values, in the order of regs
+ *  \returns the number of registers successfully read
+ */
+uint32_t readRegs(LocalArgs * la, const std::vector<RegHandle> & regs, uint32_t * result);
+
 /*!
  *  \brief Reads a block of values from a contiguous address space.
  *  \param la Local arguments structure
@@ -189,6 +361,79 @@ uint32_t readBlock(const uint32_t& regAddr,  uint32_t* result, const uint32_t& s
  */
 void writeReg(LocalArgs * la, const std::string & regName, uint32_t value);
 
+/*! \fn void writeReg(LocalArgs * la, const RegHandle & reg, uint32_t value)
+ *  \brief Writes a value to a resolved register. Register mask is applied
+ *  \param la Local arguments structure
+ *  \param reg Register handle
+ *  \param value Value to write
+ */
+void writeReg(LocalArgs * la, const RegHandle & reg, uint32_t value);
+
+/*! \class RegWriteBatch
+ *  \brief Collects register writes and commits them with one read-modify-write per 32-bit word
+ *  \details Writes are grouped by address, bitfields sharing a word are merged in the order they were added,
+ *           and the word is read only if the merged fields do not cover it entirely. Words are written in the order
+ *           their first field was added. A field that must follow another field of the same word, like a reset,
+ *           belongs in a separate batch or write.
+ *           The whole batch is written under a single memhub lock.
+ */
+class RegWriteBatch
+{
+  public:
+    /*! \brief Creates an empty batch
+     *  \param la Local arguments structure, errors are reported in its response
+     */
+    RegWriteBatch(LocalArgs * la);
+
+    /*! \brief Adds a write of value to a resolved register. Register mask is applied on commit
+     */
+    void add(const RegHandle & reg, uint32_t value);
+
+    /*! \brief Adds a write of value to a register. Register mask is applied on commit
+     */
+    void add(const std::string & regName, uint32_t value);
+
+    /*! \brief Writes all pending values and empties the batch
+     *  \returns the number of 32-bit words written
+     */
+    uint32_t commit();
+
+    /*! \brief Drops all pending values
+     */
+    void clear() { m_writes.clear(); }
+
+    size_t size() const { return m_writes.size(); }
+
+  private:
+    LocalArgs * m_la;
+    std::vector<std::pair<RegHandle, uint32_t> > m_writes;
+};
+
+static constexpr uint32_t WAIT_SPIN_US      = 20;    ///< waitForRegister polls back to back for this long before it starts sleeping
+static constexpr uint32_t WAIT_MAX_SLEEP_US = 10000; ///< Upper bound of the waitForRegister backoff
+
+/*! \fn bool waitForRegister(LocalArgs * la, const RegHandle & reg, const std::function<bool(uint32_t)> & predicate, std::chrono::steady_clock::time_point deadline)
+ *  \brief Polls a register until predicate holds for its value or the deadline passes
+ *  \details The register is read back to back for the first WAIT_SPIN_US, then with sleeps doubling from 1 us up to
+ *           WAIT_MAX_SLEEP_US, so short waits complete with little latency and long ones do not keep memhub busy.
+ *           The back to back polls hold a MemhubLease, which is released before the first sleep.
+ *           A timeout or a failed read is reported as an RPC error.
+ *  \param la Local arguments structure
+ *  \param reg Register handle
+ *  \param predicate Condition on the masked register value
+ *  \param deadline Time after which the wait is abandoned
+ *  \returns true if the condition was met, false on timeout or read error
+ */
+bool waitForRegister(LocalArgs * la, const RegHandle & reg, const std::function<bool(uint32_t)> & predicate,
+                     std::chrono::steady_clock::time_point deadline);
+
+/*! \fn std::chrono::steady_clock::time_point waitDeadline(std::chrono::microseconds timeout)
+ *  \brief Deadline timeout from now for waitForRegister
+ *  \details Saturates at time_point::max(), so std::chrono::microseconds::max() waits without limit
+ *  \param timeout Time allowed for the wait
+ */
+std::chrono::steady_clock::time_point waitDeadline(std::chrono::microseconds timeout);
+
 /*!
  *  \brief Writes a block of values to a contiguous address space.
  *  \detail Block writes are allowed on 'single' registers, provided:
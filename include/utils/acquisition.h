@@ -0,0 +1,81 @@
+/*!
+ * \file utils/acquisition.h
+ * \brief Time, event and byte budgets of a readout loop
+ */
+
+#ifndef UTILS_ACQUISITION_H
+#define UTILS_ACQUISITION_H
+
+#include <chrono>
+#include <stdint.h>
+
+/*! \class AcquisitionControl
+ *  \brief Decides when a readout loop stops and accounts for its live and dead time
+ *  \details The loop calls running() before each readout cycle, readout(liveNs) once per reset of the monitor being read
+ *           and event(bytes) for each event it stores. Times are taken from std::chrono::steady_clock, so they have
+ *           sub-microsecond resolution and do not follow changes of the wall clock.
+ */
+class AcquisitionControl
+{
+  public:
+    /*! \brief Condition which ended the acquisition */
+    enum StopReason {
+      RUNNING = 0, ///< not stopped yet
+      TIME    = 1, ///< acquisition time elapsed
+      EVENTS  = 2, ///< event budget reached
+      BYTES   = 3, ///< byte budget reached
+    };
+
+    /*! \param timeMs Acquisition time in milliseconds
+     *  \param maxEvents Stop once this many events have been stored, 0 for no limit
+     *  \param maxBytes Stop once this many bytes have been stored, 0 for no limit
+     */
+    explicit AcquisitionControl(uint32_t timeMs, uint64_t maxEvents = 0, uint64_t maxBytes = 0);
+
+    /*! \brief Lowers the byte budget to maxBytes if it is unlimited or larger */
+    void limitBytes(uint64_t maxBytes);
+
+    /*! \brief Starts the clock, otherwise started by the first running() */
+    void start();
+
+    /*! \brief Checks the budgets, stopping the clock once one of them is exhausted
+     *  \returns true while another readout cycle may start
+     */
+    bool running();
+
+    /*! \brief Counts a readout cycle, which reset the monitor and had it record for liveNs nanoseconds */
+    void readout(uint64_t liveNs) { ++m_readouts; m_liveNs += liveNs; }
+
+    /*! \brief Counts a stored event of the given size */
+    void event(uint64_t bytes) { ++m_events; m_bytes += bytes; }
+
+    StopReason stopReason() const { return m_stopReason; }
+
+    uint64_t readouts() const { return m_readouts; } ///< readout cycles, i.e. monitor resets
+    uint64_t events()   const { return m_events; }   ///< stored events
+    uint64_t bytes()    const { return m_bytes; }    ///< stored bytes
+
+    /*! \brief Time since start(), up to the stop once stopped, in microseconds */
+    uint64_t elapsedUs() const;
+
+    /*! \brief Time the monitor was recording in microseconds, at most elapsedUs() */
+    uint64_t liveUs() const;
+
+    /*! \brief elapsedUs() not covered by liveUs(), spent resetting, reading out and storing */
+    uint64_t deadUs() const { return elapsedUs()-liveUs(); }
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::chrono::milliseconds m_duration;
+    uint64_t m_maxEvents, m_maxBytes;
+
+    bool       m_started;
+    StopReason m_stopReason;
+    Clock::time_point m_start, m_stop;
+
+    uint64_t m_readouts, m_events, m_bytes;
+    uint64_t m_liveNs;
+};
+
+#endif
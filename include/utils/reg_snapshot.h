@@ -0,0 +1,59 @@
+/*!
+ * \file utils/reg_snapshot.h
+ * \brief Save and restore of the register state changed by a scan
+ */
+
+#ifndef UTILS_REG_SNAPSHOT_H
+#define UTILS_REG_SNAPSHOT_H
+
+#include "utils.h"
+
+#include <vector>
+
+/*! \class RegSnapshot
+ *  \brief Values of a set of registers, captured with batched reads and written back with one batched write
+ *  \details The values still held when the snapshot goes out of scope are restored, so a routine that returns early
+ *           or throws leaves the registers as it found them. Registers that could not be read are not restored.
+ */
+class RegSnapshot
+{
+  public:
+    /*! \brief Creates an empty snapshot
+     *  \param la Local arguments structure, errors are reported in its response
+     */
+    explicit RegSnapshot(LocalArgs * la);
+
+    /*! \brief Creates a snapshot of regs */
+    RegSnapshot(LocalArgs * la, const std::vector<RegHandle> & regs);
+
+    /*! \brief Restores the values still held */
+    ~RegSnapshot();
+
+    /*! \brief Reads the current values of regs with readRegs(...) and adds them to the snapshot
+     *  \returns the number of registers successfully read
+     */
+    uint32_t capture(const std::vector<RegHandle> & regs);
+
+    /*! \brief Writes the captured values back with a RegWriteBatch and empties the snapshot
+     *  \returns the number of 32-bit words written
+     */
+    uint32_t restore();
+
+    /*! \brief Empties the snapshot without restoring it */
+    void release();
+
+    size_t size() const { return m_regs.size(); }
+
+    /*! \brief Captured values in the order of capture, 0xdeaddead for the registers that could not be read */
+    const std::vector<uint32_t> & values() const { return m_values; }
+
+  private:
+    RegSnapshot(const RegSnapshot&) = delete;
+    RegSnapshot& operator=(const RegSnapshot&) = delete;
+
+    LocalArgs * m_la;
+    std::vector<RegHandle> m_regs;
+    std::vector<uint32_t>  m_values;
+};
+
+#endif
@@ -0,0 +1,171 @@
+/*!
+ * \file utils/result_stream.h
+ * \brief Chunked delivery of large RPC results
+ * \details Methods that accept a "stream" word do not put their result arrays in the response. They fill a job
+ *          holding one ResultStream per result array and reply with its "jobId" and the "<key>.size" of each array.
+ *          The client then calls utils.fetchResult with the jobId and key until "done" is set.
+ *
+ *          Called directly, the method replies once it has finished, so the job is only registered then and the client
+ *          fetches the complete arrays in chunks afterwards: the streams are unbounded and the method limits what it stores.
+ *          Run on a calibration job (see calibration_routines/jobs.h), the job is started with startResultJob() before the
+ *          method runs and bound to the worker thread with ResultJobScope. Its arrays are then fetched while the method
+ *          runs, through streams of RESULT_STREAM_CAPACITY words: the method waits for the client when one is full.
+ *          Jobs live in the rpcsvc process of the connection that created them.
+ */
+
+#ifndef UTILS_RESULT_STREAM_H
+#define UTILS_RESULT_STREAM_H
+
+#include "utils.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+
+static constexpr size_t   RESULT_CHUNK_WORDS = 16000; ///< Default and maximum number of words returned by one fetchResult call, keeps a response below 64 kB
+static constexpr uint32_t RESULT_MAX_JOBS    = 16;    ///< Jobs kept per connection, the oldest job is dropped beyond this
+static constexpr size_t   RESULT_STREAM_CAPACITY = 4*RESULT_CHUNK_WORDS; ///< Words buffered per array of a job fetched while its method runs
+
+/*! \class ResultStream
+ *  \brief FIFO of result words written by the method and read back by fetchResult
+ *  \details With a capacity, push blocks while the buffer is full until fetchResult drains it or the stream is closed,
+ *           so only the streams of a job started with startResultJob() are bounded. A stream of capacity 0 is unbounded.
+ */
+class ResultStream
+{
+  public:
+    explicit ResultStream(size_t capacity = 0);
+
+    /*! \brief Appends words, waiting for room if the stream is bounded. Words pushed after close() are discarded */
+    void push(const uint32_t * data, size_t words);
+    void push(const std::vector<uint32_t> & data) { push(data.data(), data.size()); }
+
+    /*! \brief Moves up to maxWords of the oldest words into out, does not wait for data
+     *  \returns the number of words moved
+     */
+    size_t fetch(std::vector<uint32_t> & out, size_t maxWords);
+
+    /*! \brief Marks the end of the data, also releases a producer waiting for room */
+    void close();
+
+    bool   closed()  const; ///< no more words will be pushed
+    bool   drained() const; ///< closed and every word has been fetched
+    size_t size()    const; ///< words waiting to be fetched
+    uint64_t total() const; ///< words pushed since the stream was created
+
+  private:
+    ResultStream(const ResultStream&) = delete;
+    ResultStream& operator=(const ResultStream&) = delete;
+
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_notFull;
+    std::deque<uint32_t>    m_words;
+    size_t   m_capacity;
+    bool     m_closed;
+    uint64_t m_total;
+};
+
+/*! \class ResultJob
+ *  \brief Set of named result streams returned by one method call
+ */
+class ResultJob
+{
+  public:
+    /*! \param capacity Capacity of the streams of the job, 0 for unbounded streams */
+    explicit ResultJob(size_t capacity = 0);
+
+    /*! \brief Returns the stream for key, creating it on first use. A stream created after close() is closed */
+    ResultStream & stream(const std::string & key);
+
+    /*! \brief Returns the stream for key, nullptr if there is none */
+    ResultStream * find(const std::string & key);
+
+    std::vector<std::string> keys() const;
+
+    /*! \brief Closes every stream, also releases a producer waiting for room */
+    void close();
+
+    bool     closed()  const; ///< close() was called
+    bool     drained() const; ///< every stream is drained
+    uint32_t id()      const { return m_id; } ///< id given by registerResultJob, 0 before
+
+  private:
+    friend uint32_t registerResultJob(std::shared_ptr<ResultJob> job);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::unique_ptr<ResultStream> > m_streams;
+    size_t   m_capacity;
+    bool     m_closed;
+    std::atomic<uint32_t> m_id;
+};
+
+/*! \class ResultJobScope
+ *  \brief Binds a job to the calling thread while in scope: resultJobFor(...) returns it instead of creating a new job
+ */
+class ResultJobScope
+{
+  public:
+    explicit ResultJobScope(std::shared_ptr<ResultJob> job);
+    ~ResultJobScope();
+
+  private:
+    ResultJobScope(const ResultJobScope&) = delete;
+    ResultJobScope& operator=(const ResultJobScope&) = delete;
+
+    std::shared_ptr<ResultJob> m_previous;
+};
+
+/*! \fn uint32_t registerResultJob(std::shared_ptr<ResultJob> job)
+ *  \brief Makes a job available to fetchResult
+ *  \returns the job id
+ */
+uint32_t registerResultJob(std::shared_ptr<ResultJob> job);
+
+/*! \fn std::shared_ptr<ResultJob> findResultJob(uint32_t jobId)
+ *  \brief Returns the job with the given id, nullptr if it does not exist (anymore)
+ */
+std::shared_ptr<ResultJob> findResultJob(uint32_t jobId);
+
+/*! \fn void releaseResultJob(uint32_t jobId)
+ *  \brief Forgets a job, its remaining data is discarded
+ */
+void releaseResultJob(uint32_t jobId);
+
+/*! \fn std::shared_ptr<ResultJob> startResultJob()
+ *  \brief Registers a new job of RESULT_STREAM_CAPACITY word streams, to be bound to the thread running the method
+ */
+std::shared_ptr<ResultJob> startResultJob();
+
+/*! \fn std::shared_ptr<ResultJob> resultJobFor(const RPCMsg *request)
+ *  \brief Returns the job bound to the calling thread if there is one, otherwise a new job if the request asks for a
+ *         streamed result ("stream" word present) and nullptr if it does not
+ */
+std::shared_ptr<ResultJob> resultJobFor(const RPCMsg *request);
+
+/*! \fn void setResultArray(RPCMsg *response, ResultJob *job, const std::string & key, const uint32_t *data, size_t words)
+ *  \brief Returns a result array: pushed to the key stream of job if there is one, set in the response otherwise
+ *  \details The key stream is closed once the array is pushed, each key is set once.
+ */
+void setResultArray(RPCMsg *response, ResultJob *job, const std::string & key, const uint32_t *data, size_t words);
+
+/*! \fn void publishResultJob(RPCMsg *response, std::shared_ptr<ResultJob> job)
+ *  \brief Closes job, registers it unless it was started with startResultJob(), sets "jobId" and the "<key>.size" of every
+ *         stream in the response
+ */
+void publishResultJob(RPCMsg *response, std::shared_ptr<ResultJob> job);
+
+/*! \fn void fetchResult(const RPCMsg *request, RPCMsg *response)
+ *  \brief Returns the next chunk of a streamed result
+ *  \details The request holds the "jobId" and the "key" of the result array, optionally "maxWords" (at most RESULT_CHUNK_WORDS).
+ *           The response holds the chunk in "data", the words still buffered in "remaining" and "done" set to 1 once the
+ *           array is complete and fully fetched. The job is released when all of its arrays are done.
+ *           While the method of the job runs, "data" may be empty and an array not created yet is reported empty.
+ *  \param request RPC request message
+ *  \param response RPC response message
+ */
+void fetchResult(const RPCMsg *request, RPCMsg *response);
+
+#endif
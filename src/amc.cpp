@@ -11,9 +11,9 @@
 #include "amc/blaster_ram.h"
 #include "amc/sca.h"
 
+#include <algorithm>
 #include <chrono>
 #include <string>
-#include <time.h>
 #include <thread>
 #include <vector>
 
@@ -113,16 +113,42 @@ void getOHVFATMaskMultiLink(const RPCMsg *request, RPCMsg *response)
 } //End getOHVFATMaskMultiLink(...)
 
 std::vector<uint32_t> sbitReadOutLocal(localArgs *la, uint32_t ohN, uint32_t acquireTime, bool *maxNetworkSizeReached)
+{
+    AcquisitionControl acq(acquireTime*1000);
+    std::vector<uint32_t> storedSbits = sbitReadOutLocal(la, ohN, acq);
+    (*maxNetworkSizeReached) = (acq.stopReason() == AcquisitionControl::BYTES);
+    return storedSbits;
+} //End sbitReadOutLocal(...)
+
+std::vector<uint32_t> sbitReadOutLocal(localArgs *la, uint32_t ohN, AcquisitionControl & acq, bool logClusters)
+{
+    //Max TCP/IP message is 65535, a readout adds 32 bytes beyond the budget at most
+    acq.limitBytes(65000);
+
+    ResultStream sbits;
+    sbitReadOutLocal(la, sbits, ohN, acq, logClusters);
+
+    std::vector<uint32_t> storedSbits;
+    sbits.fetch(storedSbits, sbits.size());
+    return storedSbits;
+} //End sbitReadOutLocal(...)
+
+void sbitReadOutLocal(localArgs *la, ResultStream & storedSbits, uint32_t ohN, AcquisitionControl & acq, bool logClusters)
 {
     //Setup the sbit monitor
     const int nclusters = 8;
     writeReg(la, "GEM_AMC.TRIGGER.SBIT_MONITOR.OH_SELECT", ohN);
     uint32_t addrSbitMonReset=getAddress(la, "GEM_AMC.TRIGGER.SBIT_MONITOR.RESET");
-    uint32_t addrSbitL1ADelay=getAddress(la, "GEM_AMC.TRIGGER.SBIT_MONITOR.L1A_DELAY");
-    uint32_t addrSbitCluster[nclusters];
-    for (int iCluster=0; iCluster < nclusters; ++iCluster) {
-        addrSbitCluster[iCluster] = getAddress(la, stdsprintf("GEM_AMC.TRIGGER.SBIT_MONITOR.CLUSTER%i",iCluster) );
-    }
+
+    //L1A delay first, then the clusters: the registers follow each other and are fetched in one block read
+    std::vector<RegHandle> sbitMonRegs = resolveFamily(la, "GEM_AMC.TRIGGER.SBIT_MONITOR.CLUSTER{}", nclusters);
+    sbitMonRegs.insert(sbitMonRegs.begin(), resolveReg(la, "GEM_AMC.TRIGGER.SBIT_MONITOR.L1A_DELAY"));
+    uint32_t sbitMonData[1+nclusters];
+    const uint32_t *clusterData = sbitMonData+1;
+
+    //Readouts with a valid cluster are packed into a buffer allocated once and handed to storedSbits when it is full
+    std::vector<uint32_t> sbitBuffer(SBIT_READOUT_BUFFER_READOUTS*nclusters);
+    size_t bufferedWords = 0;
 
     //Take the VFATs out of slow control only mode
     writeReg(la, "GEM_AMC.GEM_SYSTEM.VFAT3.SC_ONLY_MODE", 0x0);
@@ -130,62 +156,65 @@ std::vector<uint32_t> sbitReadOutLocal(localArgs *la, uint32_t ohN, uint32_t acq
     //[0:10] address of sbit cluster
     //[11:13] cluster size
     //[14:26] L1A Delay (consider anything over 4095 as overflow)
-    std::vector<uint32_t> storedSbits;
 
     //readout sbits
-    time_t acquisitionTime,startTime;
-    bool acquire=true;
-    startTime=time(NULL);
-    (*maxNetworkSizeReached) = false;
+    const uint64_t windowNs = uint64_t(SBIT_MONITOR_WINDOW_BX)*25;
     uint32_t l1ADelay;
-    while(acquire) {
-        if ( sizeof(uint32_t) * storedSbits.size() > 65000 ) { //Max TCP/IP message is 65535
-            (*maxNetworkSizeReached) = true;
-            break;
-        }
-
-        //Reset monitors
-        writeRawAddress(addrSbitMonReset, 0x1, la->response);
-
+    acq.start();
+    writeRawAddress(addrSbitMonReset, 0x1, la->response);
+    while(acq.running() && !storedSbits.closed()) { //the stream is closed if its calibration job is cancelled
         //wait for 4095 clock cycles then read L1A delay
-        std::this_thread::sleep_for (std::chrono::nanoseconds(4095*25));
-        l1ADelay = readRawAddress(addrSbitL1ADelay, la->response);
+        std::this_thread::sleep_for (std::chrono::nanoseconds(windowNs));
+
+        //L1A delay and clusters are read and the monitor reset for the next window under one memhub lease, not held while sleeping
+        {
+            MemhubLease lease;
+            readRegs(la, sbitMonRegs, sbitMonData);
+            writeRawAddress(addrSbitMonReset, 0x1, la->response);
+        }
+        acq.readout(windowNs);
+        l1ADelay = sbitMonData[0];
         if (l1ADelay > 4095) { //Anything larger than this consider as overflow
             l1ADelay = 4095; //(0xFFF in hex)
         }
 
         //get sbits
         bool anyValid=false;
-        std::vector<uint32_t> tempSBits; //will only be stored into storedSbits if anyValid is true
+        uint32_t *packedSbits = sbitBuffer.data()+bufferedWords; //only kept if anyValid is true
         for (int cluster=0; cluster<nclusters; ++cluster) {
             //bits [10:0] is the address of the cluster
             //bits [14:12] is the cluster size
             //bits 15 and 11 are not used
-            uint32_t thisCluster = readRawAddress(addrSbitCluster[cluster], la->response);
+            uint32_t thisCluster = clusterData[cluster];
             uint32_t sbitAddress = (thisCluster & 0x7ff);
             int clusterSize = (thisCluster >> 12) & 0x7;
             bool isValid = (sbitAddress < 1536); //Possible values are [0,(24*64)-1]
 
             if (isValid) {
-                LOGGER->log_message(LogManager::INFO,stdsprintf("valid sbit data: thisClstr %x; sbitAddr %x;",thisCluster,sbitAddress));
+                if (logClusters)
+                    LOGGER->log_message(LogManager::DEBUG,stdsprintf("valid sbit data: thisClstr %x; sbitAddr %x;",thisCluster,sbitAddress));
                 anyValid=true;
             }
 
             //Store the sbit
-            tempSBits.push_back( ((l1ADelay & 0x1fff) << 14) + ((clusterSize & 0x7) << 11) + (sbitAddress & 0x7ff) );
+            packedSbits[cluster] = ((l1ADelay & 0x1fff) << 14) + ((clusterSize & 0x7) << 11) + (sbitAddress & 0x7ff);
         } //End Loop over clusters
 
         if (anyValid) {
-            storedSbits.insert(storedSbits.end(),tempSBits.begin(),tempSBits.end());
-        }
-
-        acquisitionTime=difftime(time(NULL),startTime);
-        if (uint32_t(acquisitionTime) > acquireTime) {
-            acquire=false;
+            acq.event(nclusters*sizeof(uint32_t));
+            bufferedWords += nclusters;
+            if (bufferedWords == sbitBuffer.size()) {
+                storedSbits.push(sbitBuffer.data(), bufferedWords);
+                bufferedWords = 0;
+            }
         }
     } //End readout sbits
+    storedSbits.push(sbitBuffer.data(), bufferedWords);
 
-    return storedSbits;
+    uint64_t elapsedUs = acq.elapsedUs();
+    LOGGER->log_message(LogManager::INFO, stdsprintf("SBIT readout of OH%i: %llu readouts in %llu us (%.0f Hz), %llu stored, dead time %.1f%%",
+                ohN, (unsigned long long)acq.readouts(), (unsigned long long)elapsedUs, elapsedUs ? 1e6*acq.readouts()/elapsedUs : 0.,
+                (unsigned long long)acq.events(), elapsedUs ? 100.*acq.deadUs()/elapsedUs : 0.));
 } //End sbitReadOutLocal(...)
 
 void sbitReadOut(const RPCMsg *request, RPCMsg *response)
@@ -193,18 +222,48 @@ void sbitReadOut(const RPCMsg *request, RPCMsg *response)
     GETLOCALARGS(response);
 
     uint32_t ohN = request->get_word("ohN");
-    uint32_t acquireTime = request->get_word("acquireTime");
-
-    bool maxNetworkSizeReached = false;
+    uint32_t acquireTimeMs = request->get_key_exists("acquireTimeMs") ? request->get_word("acquireTimeMs") : request->get_word("acquireTime")*1000;
+    uint64_t maxEvents = request->get_key_exists("maxEvents") ? request->get_word("maxEvents") : 0;
+    uint64_t maxBytes = request->get_key_exists("maxBytes") ? request->get_word("maxBytes") : 0;
+    bool logClusters = request->get_key_exists("logClusters") && request->get_word("logClusters");
+
+    AcquisitionControl acq(acquireTimeMs, maxEvents, maxBytes);
+
+    //Live time, dead time and readout rate of the acquisition
+    auto setStats = [&]() {
+        auto saturate = [](uint64_t val) { return uint32_t(std::min<uint64_t>(val, 0xffffffff)); };
+        uint64_t elapsedUs = acq.elapsedUs();
+        response->set_word("nReadouts", saturate(acq.readouts()));
+        response->set_word("nStored", saturate(acq.events()));
+        response->set_word("elapsedTimeUs", saturate(elapsedUs));
+        response->set_word("liveTimeUs", saturate(acq.liveUs()));
+        response->set_word("deadTimeUs", saturate(acq.deadUs()));
+        response->set_word("readoutRate", elapsedUs ? uint32_t(1e6*acq.readouts()/elapsedUs) : 0);
+        response->set_word("deadTimePerMille", elapsedUs ? uint32_t(1000*acq.deadUs()/elapsedUs) : 0);
+        response->set_word("stopReason", acq.stopReason());
+    };
+
+    std::shared_ptr<ResultJob> job = resultJobFor(request);
+    if (job) {
+        //A job registered before the call (calibration job) is drained by the client during the acquisition through a bounded stream.
+        //Otherwise the client fetches the clusters once the reply is sent, i.e. after the acquisition, until then they are all held here
+        if (!job->id())
+            acq.limitBytes(SBIT_STREAM_MAX_BYTES);
+        sbitReadOutLocal(&la, job->stream("storedSbits"), ohN, acq, logClusters);
+        setStats();
+        publishResultJob(response, job);
+        rtxn.abort();
+        return;
+    }
 
-    time_t startTime=time(NULL);
-    std::vector<uint32_t> storedSbits = sbitReadOutLocal(&la, ohN, acquireTime, &maxNetworkSizeReached);
-    time_t approxLivetime=difftime(time(NULL),startTime);
+    std::vector<uint32_t> storedSbits = sbitReadOutLocal(&la, ohN, acq, logClusters);
 
-    if (maxNetworkSizeReached) {
-        response->set_word("maxNetworkSizeReached", maxNetworkSizeReached);
-        response->set_word("approxLiveTime",approxLivetime);
+    //Kept for the clients of the 65000 byte limit, which only knew the acquisition time to the second
+    if (acq.stopReason() == AcquisitionControl::BYTES && (!maxBytes || maxBytes > 65000)) {
+        response->set_word("maxNetworkSizeReached", true);
+        response->set_word("approxLiveTime", acq.elapsedUs()/1000000);
     }
+    setStats();
     response->set_word_array("storedSbits",storedSbits);
 
     rtxn.abort();
@@ -219,6 +278,7 @@ extern "C" {
             LOGGER->log_message(LogManager::ERROR, "Unable to load module");
             return; // Do not register our functions, we depend on memsvc.
         }
+        openAddressTable(); // retried on the first call if the address table is not available yet
 
         modmgr->register_method("amc", "getOHVFATMask",          getOHVFATMask);
         modmgr->register_method("amc", "getOHVFATMaskMultiLink", getOHVFATMaskMultiLink);
@@ -44,25 +44,49 @@ void ttcMMCMPhaseShiftLocal(localArgs* la,
   vec_ttcCtrlRegs.push_back(std::make_pair("PA_GTH_MANUAL_SEL_OVERRIDE"    , 0x1));
   vec_ttcCtrlRegs.push_back(std::make_pair("PA_GTH_MANUAL_COMBINED"        , 0x1));
   vec_ttcCtrlRegs.push_back(std::make_pair("GTH_TXDLYBYPASS"               , 0x1));
-  vec_ttcCtrlRegs.push_back(std::make_pair("PA_MANUAL_PLL_RESET"           , 0x1));
-  vec_ttcCtrlRegs.push_back(std::make_pair("CNT_RESET"                     , 0x1));
 
-  // write & readback of aforementioned registers
-  uint32_t readback;
+  // resets follow the configuration, in this order
+  std::vector<std::pair<std::string, uint32_t> > vec_ttcResetRegs;
+  vec_ttcResetRegs.push_back(std::make_pair("PA_MANUAL_PLL_RESET"          , 0x1));
+  vec_ttcResetRegs.push_back(std::make_pair("CNT_RESET"                    , 0x1));
+
+  // write & readback of aforementioned registers, configuration fields sharing a control word are written together
+  std::vector<RegHandle> vec_ttcCtrlHandles;
+  RegWriteBatch ttcCtrlBatch(la);
   for (auto ttcRegIter = vec_ttcCtrlRegs.begin(); ttcRegIter != vec_ttcCtrlRegs.end(); ++ttcRegIter) {
-    writeReg(la, strTTCCtrlBaseNode + (*ttcRegIter).first, (*ttcRegIter).second);
+    vec_ttcCtrlHandles.push_back(resolveReg(la, strTTCCtrlBaseNode + (*ttcRegIter).first));
+    ttcCtrlBatch.add(vec_ttcCtrlHandles.back(), (*ttcRegIter).second);
+  }
+  ttcCtrlBatch.commit();
+  std::this_thread::sleep_for(std::chrono::microseconds(250));
+
+  auto readbackMatches = [&](const RegHandle & reg, uint32_t readback, uint32_t expected) {
+    if (readback == expected)
+      return true;
+    std::stringstream errmsg;
+    errmsg << "Readback of " << reg.name
+           << " failed, value is " << readback
+           << ", expected " << expected;
+
+    LOGGER->log_message(LogManager::ERROR, "ttcMMCMPhaseShiftLocal: " + errmsg.str());
+    la->response->set_string("error", errmsg.str());
+    return false;
+  };
+
+  std::vector<uint32_t> vec_readback(vec_ttcCtrlHandles.size());
+  readRegs(la, vec_ttcCtrlHandles, vec_readback.data());
+  for (size_t regIdx = 0; regIdx < vec_ttcCtrlRegs.size(); ++regIdx) {
+    if (!readbackMatches(vec_ttcCtrlHandles[regIdx], vec_readback[regIdx], vec_ttcCtrlRegs[regIdx].second))
+      return;
+  }
+
+  // then the resets, each with its own settle time
+  for (auto ttcRegIter = vec_ttcResetRegs.begin(); ttcRegIter != vec_ttcResetRegs.end(); ++ttcRegIter) {
+    RegHandle reg = resolveReg(la, strTTCCtrlBaseNode + (*ttcRegIter).first);
+    writeReg(la, reg, (*ttcRegIter).second);
     std::this_thread::sleep_for(std::chrono::microseconds(250));
-    readback = readReg(la, strTTCCtrlBaseNode + (*ttcRegIter).first);
-    if (readback != (*ttcRegIter).second) {
-      std::stringstream errmsg;
-      errmsg << "Readback of " << strTTCCtrlBaseNode + (ttcRegIter->first).c_str()
-             << " failed, value is " << readback
-             << ", expected " << ttcRegIter->second;
-
-      LOGGER->log_message(LogManager::ERROR, "ttcMMCMPhaseShiftLocal: " + errmsg.str());
-      la->response->set_string("error", errmsg.str());
+    if (!readbackMatches(reg, readReg(la, reg), (*ttcRegIter).second))
       return;
-    }
   }
 
   if (readReg(la,strTTCCtrlBaseNode+"DISABLE_PHASE_ALIGNMENT") == 0x0) {
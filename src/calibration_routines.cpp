@@ -1,39 +1,55 @@
 #include <algorithm>
 #include "amc.h"
 #include "calibration_routines.h"
+#include "calibration_routines/adaptive_scan.h"
+#include "calibration_routines/jobs.h"
 #include <chrono>
 #include <math.h>
 #include <pthread.h>
 #include "optohybrid.h"
 #include <thread>
+#include "utils/result_stream.h"
 #include "vfat3.h"
 
-std::unordered_map<uint32_t, uint32_t> setSingleChanMask(int ohN, int vfatN, unsigned int ch, localArgs *la)
+void setSingleChanMask(int ohN, int vfatN, unsigned int ch, localArgs *la, RegSnapshot & origMasks)
 {
-    char regBuf[200];
-    std::unordered_map<uint32_t, uint32_t> map_chanOrigMask; //key -> reg addr; val -> reg value
-    uint32_t chanMaskAddr;
-    for (unsigned int chan=0; chan<128; ++chan) { //Loop Over All Channels
-        uint32_t chMask = 1;
-        if ( ch == chan) { //Do not mask the channel of interest
-            chMask = 0;
-        }
-        //store the original channel mask
-        sprintf(regBuf, "GEM_AMC.OH.OH%i.GEB.VFAT%i.VFAT_CHANNELS.CHANNEL%i.MASK",ohN,vfatN,chan);
-        chanMaskAddr=getAddress(la, regBuf);
-        map_chanOrigMask[chanMaskAddr]=readReg(la, regBuf);
+    //store the original channel masks
+    std::vector<RegHandle> chanMasks = resolveFamily(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.VFAT_CHANNELS.CHANNEL{}.MASK", 128, ohN, vfatN);
+    origMasks.capture(chanMasks);
 
-        //write the new channel mask
-        writeRawAddress(chanMaskAddr, chMask, la->response);
+    //write the new channel masks
+    RegWriteBatch maskWrites(la);
+    for (unsigned int chan=0; chan<128; ++chan) { //Loop Over All Channels
+        //Do not mask the channel of interest
+        maskWrites.add(chanMasks[chan], (ch == chan) ? 0 : 1);
     } //End Loop Over all Channels
-    return map_chanOrigMask;
+    maskWrites.commit();
 }
 
-void applyChanMask(std::unordered_map<uint32_t, uint32_t> map_chanOrigMask, localArgs *la)
+void maskAllChannelsLocal(localArgs *la, uint32_t ohN, uint32_t mask, RegSnapshot & origChanRegs)
 {
-    for (auto chanPtr = map_chanOrigMask.begin(); chanPtr != map_chanOrigMask.end(); ++chanPtr) {
-        writeRawAddress( (*chanPtr).first, (*chanPtr).second, la->response);
+    //Determine the inverse of the vfatmask
+    uint32_t notmask = ~mask & 0xFFFFFF;
+
+    std::vector<RegHandle> chanRegs;
+    for (int vfatN=0; vfatN<24; ++vfatN) {
+        if ( !( (notmask >> vfatN) & 0x1)) continue;
+        std::vector<RegHandle> vfatChanRegs = resolveFamily(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.VFAT_CHANNELS.CHANNEL{}", 128, ohN, vfatN);
+        chanRegs.insert(chanRegs.end(), vfatChanRegs.begin(), vfatChanRegs.end());
+    }
+
+    //Get current channel register data in one batched read
+    size_t first = origChanRegs.size();
+    origChanRegs.capture(chanRegs);
+
+    //Set the channel masks to true and disable the calpulse
+    RegWriteBatch chanWrites(la);
+    for (size_t idx=0; idx<chanRegs.size(); ++idx) {
+        uint32_t chanRegData = origChanRegs.values()[first+idx];
+        if (chanRegData == 0xdeaddead) continue;
+        chanWrites.add(chanRegs[idx], (chanRegData | (0x1 << 14)) & ~(0x1 << 15));
     }
+    chanWrites.commit();
 }
 
 bool confCalPulseLocal(localArgs *la, uint32_t ohN, uint32_t mask, uint32_t ch, bool toggleOn, bool currentPulse, uint32_t calScaleFactor)
@@ -179,8 +195,10 @@ void ttcGenConfLocal(localArgs * la, uint32_t ohN, uint32_t mode, uint32_t type,
         {
             LOGGER->log_message(LogManager::INFO, "ttcGenConfLocal: V3 behavior");
             writeReg(la, "GEM_AMC.TTC.GENERATOR.RESET", 0x1);
-            writeReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_L1A_GAP", L1Ainterval);
-            writeReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_CALPULSE_TO_L1A_GAP", pulseDelay);
+            RegWriteBatch ttcGenBatch(la);
+            ttcGenBatch.add("GEM_AMC.TTC.GENERATOR.CYCLIC_L1A_GAP", L1Ainterval);
+            ttcGenBatch.add("GEM_AMC.TTC.GENERATOR.CYCLIC_CALPULSE_TO_L1A_GAP", pulseDelay);
+            ttcGenBatch.commit();
             break;
         }//End v3 electronics behavior
         case 0x1: //v2b electronics behavior
@@ -265,117 +283,197 @@ void ttcGenConf(const RPCMsg *request, RPCMsg *response)
     rtxn.abort();
 }
 
-void genScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useUltra, bool useExtTrig)
+std::chrono::microseconds triggerCycleTimeout(localArgs *la, uint32_t nevts, bool useExtTrig, uint32_t minTrigRate)
 {
-    //Determine the inverse of the vfatmask
-    uint32_t notmask = ~mask & 0xFFFFFF;
+    if (useExtTrig) {
+        //Backplane trigger rate is not known here, only the caller can bound it
+        if (minTrigRate == 0)
+            return std::chrono::microseconds::max();
+        return std::chrono::microseconds(1000000 + uint64_t(nevts)*1000000/minTrigRate);
+    }
 
-    //Check firmware version
-    switch(fw_version_check("genScanLocal", la)) {
-        case 3: //v3 electronics behavior
-        {
-            uint32_t goodVFATs = vfatSyncCheckLocal(la, ohN);
-            char regBuf[200];
-            if ( (notmask & goodVFATs) != notmask)
-            {
-                sprintf(regBuf,"One of the unmasked VFATs is not Synced. goodVFATs: %x\tnotmask: %x",goodVFATs,notmask);
-                la->response->set_string("error",regBuf);
-                return;
-            }
+    //Twice the time the generator needs to send nevts L1As, one BX is 25 ns
+    uint64_t l1aGap = readReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_L1A_GAP");
+    return std::chrono::microseconds(100000 + 2*uint64_t(nevts)*l1aGap*25/1000);
+}
 
-            if (currentPulse && calScaleFactor > 3) {
-                sprintf(regBuf,"Bad value for CFG_CAL_FS: %x, Possible values are {0b00, 0b01, 0b10, 0b11}. Exiting.",calScaleFactor);
-                la->response->set_string("error",regBuf);
-                return;
-            }
+GenScanRegs resolveGenScanRegs(localArgs *la, uint32_t ohN, const std::string & scanReg)
+{
+    GenScanRegs regs;
+    regs.ohN              = ohN;
+    regs.scanReg          = resolveFamily(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.CFG_"+scanReg, 24, ohN);
+    regs.thrArm           = resolveFamily(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.CFG_THR_ARM_DAC", 24, ohN);
+    regs.fireCnt          = resolveFamily(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.VFAT{}.CHANNEL_FIRE_COUNT", 24);
+    regs.goodEvt          = resolveFamily(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.VFAT{}.GOOD_EVENTS_COUNT", 24);
+    regs.l1aCounter       = resolveReg(la, "GEM_AMC.TTC.CMD_COUNTERS.L1A");
+    regs.daqMonReset      = resolveReg(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.CTRL.RESET");
+    regs.daqMonEnable     = resolveReg(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.CTRL.ENABLE");
+    regs.ttcCntReset      = resolveReg(la, "GEM_AMC.TTC.CTRL.CNT_RESET");
+    regs.ttcL1AEnable     = resolveReg(la, "GEM_AMC.TTC.CTRL.L1A_ENABLE");
+    regs.genCyclicStart   = resolveReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_START");
+    regs.genEnable        = resolveReg(la, "GEM_AMC.TTC.GENERATOR.ENABLE");
+    regs.genCyclicRunning = resolveReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_RUNNING");
+    return regs;
+}
 
-            //Do we turn on the calpulse for the channel = ch?
-            if (useCalPulse) {
-                if (confCalPulseLocal(la, ohN, mask, ch, true, currentPulse, calScaleFactor) == false) {
-                    la->response->set_string("error",stdsprintf("Unable to configure calpulse ON for ohN %i mask %x chan %i", ohN, mask, ch));
-                    return; //Calibration pulse is not configured correctly
-                }
-            } //End use calibration pulse
+bool genScanCycleLocal(localArgs *la, const GenScanRegs & regs, uint32_t notmask, const uint32_t *dacVals, uint32_t nevts, bool useExtTrig, std::chrono::microseconds trigTimeout, uint32_t *goodEvts, uint32_t *fireCnts)
+{
+    //Write the scan reg value of each VFAT
+    for (int vfatN = 0; vfatN < 24; vfatN++) if ((notmask >> vfatN) & 0x1)
+    {
+        writeReg(la, regs.scanReg[vfatN], dacVals[vfatN]);
+    }
 
-            //Get addresses
-            uint32_t daqMonAddr[24];
-            uint32_t l1CntAddr = getAddress(la, "GEM_AMC.TTC.CMD_COUNTERS.L1A");
-            for (int vfatN = 0; vfatN < 24; vfatN++)
-            {
-                sprintf(regBuf,"GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.VFAT%i.GOOD_EVENTS_COUNT",vfatN);
-                daqMonAddr[vfatN] = getAddress(la, regBuf);
-            }
+    //Reset and enable the VFAT_DAQ_MONITOR
+    writeReg(la, regs.daqMonReset, 0x1);
+    writeReg(la, regs.daqMonEnable, 0x1);
+
+    //Start the triggers
+    bool cycleDone = true;
+    if (useExtTrig) {
+        writeReg(la, regs.ttcCntReset, 0x1);
+        writeReg(la, regs.ttcL1AEnable, 0x1);
+        cycleDone = waitForRegister(la, regs.l1aCounter, [nevts](uint32_t l1aCnt) { return l1aCnt >= nevts; },
+                                    waitDeadline(trigTimeout));
+        writeReg(la, regs.ttcL1AEnable, 0x0);
+    }
+    else{
+        writeReg(la, regs.genCyclicStart, 0x1);
+        if (readReg(la, regs.genEnable)) { //TTC Commands from TTC.GENERATOR
+            cycleDone = waitForRegister(la, regs.genCyclicRunning, [](uint32_t running) { return running == 0; },
+                                        waitDeadline(trigTimeout));
+        } //End TTC Commands from TTC.GENERATOR
+    }
 
-            //TTC Config
-            if (useExtTrig) {
-                writeReg(la, "GEM_AMC.TTC.CTRL.L1A_ENABLE", 0x0);
-                writeReg(la, "GEM_AMC.TTC.CTRL.CNT_RESET", 0x1);
-            }
-            else{
-                writeReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_L1A_COUNT", nevts);
-                writeReg(la, "GEM_AMC.TTC.GENERATOR.SINGLE_RESYNC", 0x1);
-            }
+    //Stop the DAQ monitor counters from incrementing
+    writeReg(la, regs.daqMonEnable, 0x0);
+    if (!cycleDone)
+        return false; //Error already reported
 
-            //Configure VFAT_DAQ_MONITOR
-            dacMonConfLocal(la, ohN, ch);
+    //Read the DAQ Monitor counters of all VFATs, one batched read per counter family
+    readRegs(la, regs.goodEvt, goodEvts);
+    if (fireCnts)
+        readRegs(la, regs.fireCnt, fireCnts);
+    return true;
+} //End genScanCycleLocal(...)
 
-            //Scan over DAC values
-            for (uint32_t dacVal = dacMin; dacVal <= dacMax; dacVal += dacStep)
-            {
-                //Write the scan reg value
-                for (int vfatN = 0; vfatN < 24; vfatN++) if ((notmask >> vfatN) & 0x1)
-                {
-                    writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_%s",ohN,vfatN,scanReg.c_str()), dacVal);
-                }
+bool genScanDacLoopLocal(localArgs *la, const GenScanRegs & regs, uint32_t *outData, uint32_t notmask, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, const std::string & scanReg, bool useExtTrig, std::chrono::microseconds trigTimeout)
+{
+    const uint32_t nDacVals = (dacMax-dacMin+1)/dacStep;
+    uint32_t dacVals[24];
+    uint32_t goodEvts[24];
+    for (uint32_t dacVal = dacMin; dacVal <= dacMax; dacVal += dacStep)
+    {
+        if (calJobCancelled())
+            break;
+        calJobProgress((dacVal-dacMin)/dacStep, nDacVals, regs.ohN, 0xffffffff, dacVal);
+
+        std::fill(dacVals, dacVals+24, dacVal);
+        if (!genScanCycleLocal(la, regs, notmask, dacVals, nevts, useExtTrig, trigTimeout, goodEvts))
+            return false; //Error already reported, do not scan the remaining points
+
+        for (int vfatN = 0; vfatN < 24; vfatN++) {
+            if ( !( (notmask >> vfatN) & 0x1)) continue;
+
+            int idx = vfatN*(dacMax-dacMin+1)/dacStep+(dacVal-dacMin)/dacStep;
+            outData[idx] = goodEvts[vfatN];
+
+            LOGGER->log_message(LogManager::DEBUG, stdsprintf("%s Value: %i; Readback Val: %i; Nhits: %i; Nev: %i; CFG_THR_ARM: %i",
+                         scanReg.c_str(),
+                         dacVal,
+                         readReg(la, regs.scanReg[vfatN]),
+                         readReg(la, regs.fireCnt[vfatN]),
+                         readReg(la, regs.goodEvt[vfatN]),
+                         readReg(la, regs.thrArm[vfatN])
+                )
+            );
+        } //End Loop over vfats
+    } //End Loop from dacMin to dacMax
+    return true;
+} //End genScanDacLoopLocal(...)
 
-                //Reset and enable the VFAT_DAQ_MONITOR
-                writeReg(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.CTRL.RESET", 0x1);
-                writeReg(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.CTRL.ENABLE", 0x1);
+bool genScanAdaptiveLoopLocal(localArgs *la, const GenScanRegs & regs, AdaptiveScan & scan, uint32_t nevts, bool useExtTrig, std::chrono::microseconds trigTimeout)
+{
+    uint32_t dacVals[24];
+    uint32_t goodEvts[24];
+    for (uint32_t measure = scan.next(dacVals); measure != 0; measure = scan.next(dacVals))
+    {
+        if (calJobCancelled())
+            break;
+        calJobProgress(scan.steps(), scan.plannedSteps(), regs.ohN, 0xffffffff, dacVals[__builtin_ctz(measure)]);
 
-                //Start the triggers
-                if (useExtTrig) {
-                    writeReg(la, "GEM_AMC.TTC.CTRL.CNT_RESET", 0x1);
-                    writeReg(la, "GEM_AMC.TTC.CTRL.L1A_ENABLE", 0x1);
+        if (!genScanCycleLocal(la, regs, measure, dacVals, nevts, useExtTrig, trigTimeout, goodEvts))
+            return false; //Error already reported, do not scan the remaining points
+        scan.record(goodEvts);
+    }
+    LOGGER->log_message(LogManager::INFO, stdsprintf("Adaptive scan of OH%i took %i trigger cycles", regs.ohN, scan.steps()));
+    return true;
+} //End genScanAdaptiveLoopLocal(...)
 
-                    uint32_t l1aCnt = 0;
-                    while(l1aCnt < nevts) {
-                        l1aCnt = readRawAddress(l1CntAddr, la->response);
-                        std::this_thread::sleep_for(std::chrono::microseconds(200));
-                    }
+bool genScanPrepareLocal(localArgs *la, GenScanRegs & scanRegs, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, const std::string & scanReg, bool useExtTrig)
+{
+    //Determine the inverse of the vfatmask
+    uint32_t notmask = ~mask & 0xFFFFFF;
 
-                    writeReg(la, "GEM_AMC.TTC.CTRL.L1A_ENABLE", 0x0);
-                    l1aCnt = readRawAddress(l1CntAddr, la->response);
-                }
-                else{
-                    writeReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_START", 0x1);
-                    if (readReg(la, "GEM_AMC.TTC.GENERATOR.ENABLE")) { //TTC Commands from TTC.GENERATOR
-                        while(readReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_RUNNING")) {
-                            std::this_thread::sleep_for(std::chrono::microseconds(50));
-                        }
-                    } //End TTC Commands from TTC.GENERATOR
-                }
+    uint32_t goodVFATs = vfatSyncCheckLocal(la, ohN);
+    char regBuf[200];
+    if ( (notmask & goodVFATs) != notmask)
+    {
+        sprintf(regBuf,"One of the unmasked VFATs is not Synced. goodVFATs: %x\tnotmask: %x",goodVFATs,notmask);
+        la->response->set_string("error",regBuf);
+        return false;
+    }
+
+    if (currentPulse && calScaleFactor > 3) {
+        sprintf(regBuf,"Bad value for CFG_CAL_FS: %x, Possible values are {0b00, 0b01, 0b10, 0b11}. Exiting.",calScaleFactor);
+        la->response->set_string("error",regBuf);
+        return false;
+    }
 
-                //Stop the DAQ monitor counters from incrementing
-                writeReg(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.CTRL.ENABLE", 0x0);
+    //Do we turn on the calpulse for the channel = ch?
+    if (useCalPulse) {
+        if (confCalPulseLocal(la, ohN, mask, ch, true, currentPulse, calScaleFactor) == false) {
+            la->response->set_string("error",stdsprintf("Unable to configure calpulse ON for ohN %i mask %x chan %i", ohN, mask, ch));
+            return false; //Calibration pulse is not configured correctly
+        }
+    } //End use calibration pulse
 
-                //Read the DAQ Monitor counters
-                for (int vfatN = 0; vfatN < 24; vfatN++) {
-                    if ( !( (notmask >> vfatN) & 0x1)) continue;
+    //Get register handles used in the scan loop
+    scanRegs = resolveGenScanRegs(la, ohN, scanReg);
 
-                    int idx = vfatN*(dacMax-dacMin+1)/dacStep+(dacVal-dacMin)/dacStep;
-                    outData[idx] = readRawAddress(daqMonAddr[vfatN], la->response);
+    //TTC Config
+    if (useExtTrig) {
+        writeReg(la, scanRegs.ttcL1AEnable, 0x0);
+        writeReg(la, scanRegs.ttcCntReset, 0x1);
+    }
+    else{
+        writeReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_L1A_COUNT", nevts);
+        writeReg(la, "GEM_AMC.TTC.GENERATOR.SINGLE_RESYNC", 0x1);
+    }
 
-                    LOGGER->log_message(LogManager::DEBUG, stdsprintf("%s Value: %i; Readback Val: %i; Nhits: %i; Nev: %i; CFG_THR_ARM: %i",
-                                 scanReg.c_str(),
-                                 dacVal,
-                                 readReg(la, stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_%s",ohN,vfatN,scanReg.c_str())),
-                                 readReg(la, stdsprintf("GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.VFAT%i.CHANNEL_FIRE_COUNT",vfatN)),
-                                 readReg(la, stdsprintf("GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.VFAT%i.GOOD_EVENTS_COUNT",vfatN)),
-                                 readReg(la, stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_THR_ARM_DAC",ohN,vfatN,scanReg.c_str()))
-                        )
-                    );
-                } //End Loop over vfats
-            } //End Loop from dacMin to dacMax
+    //Configure VFAT_DAQ_MONITOR
+    dacMonConfLocal(la, ohN, ch);
+    return true;
+} //End genScanPrepareLocal(...)
+
+void genScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useUltra, bool useExtTrig, AdaptiveScan *adaptive, uint32_t minTrigRate)
+{
+    //Determine the inverse of the vfatmask
+    uint32_t notmask = ~mask & 0xFFFFFF;
+
+    //Check firmware version
+    switch(fw_version_check("genScanLocal", la)) {
+        case 3: //v3 electronics behavior
+        {
+            GenScanRegs scanRegs;
+            if (!genScanPrepareLocal(la, scanRegs, ohN, mask, ch, useCalPulse, currentPulse, calScaleFactor, nevts, scanReg, useExtTrig))
+                return; //Error already reported
+
+            //Scan over DAC values
+            if (adaptive)
+                genScanAdaptiveLoopLocal(la, scanRegs, *adaptive, nevts, useExtTrig, triggerCycleTimeout(la, nevts, useExtTrig, minTrigRate));
+            else
+                genScanDacLoopLocal(la, scanRegs, outData, notmask, nevts, dacMin, dacMax, dacStep, scanReg, useExtTrig, triggerCycleTimeout(la, nevts, useExtTrig, minTrigRate));
 
             //If the calpulse for channel ch was turned on, turn it off
             if (useCalPulse) {
@@ -388,6 +486,12 @@ void genScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask,
         }//End v3 electronics behavior
         case 1: //v2b electronics behavior
         {
+            //The scan module walks the DAC range by itself
+            if (adaptive) {
+                la->response->set_string("error","Adaptive scans are only supported in V3 electronics");
+                return;
+            }
+
             //Determine scanmode
             std::map<int, std::string> map_strKnownRegs; //Key -> scanmode; val -> register
 
@@ -464,7 +568,7 @@ void genScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask,
             }
 
             //Get scan results
-            getUltraScanResultsLocal(la, outData, ohN, nevts, dacMin, dacMax, dacStep);
+            getUltraScanResultsLocal(la, outData, ohN, nevts, dacMin, dacMax, dacStep, minTrigRate);
             break;
         }//End v2b electronics behavior
         default:
@@ -497,14 +601,336 @@ void genScan(const RPCMsg *request, RPCMsg *response)
         useUltra = true;
     }
     bool useExtTrig = request->get_word("useExtTrig");
+    uint32_t minTrigRate = request->get_key_exists("minTrigRate") ? request->get_word("minTrigRate") : 0;
+
+    std::shared_ptr<ResultJob> job = resultJobFor(request);
+    if (request->get_key_exists("adaptive")) {
+        AdaptiveScan adaptive = adaptiveScanFor(request, ~mask & 0xFFFFFF, dacMin, dacMax, dacStep);
+        genScanLocal(&la, nullptr, ohN, mask, ch, useCalPulse, currentPulse, calScaleFactor, nevts, dacMin, dacMax, dacStep, scanReg, useUltra, useExtTrig, &adaptive, minTrigRate);
+
+        std::vector<uint32_t> nPoints, dacVals, data;
+        adaptive.appendPoints(nPoints, dacVals, data);
+        setResultArray(response, job.get(), "nPoints", nPoints.data(), nPoints.size());
+        setResultArray(response, job.get(), "dacVals", dacVals.data(), dacVals.size());
+        setResultArray(response, job.get(), "data", data.data(), data.size());
+        if (job)
+            publishResultJob(response, job);
+        rtxn.abort();
+        return;
+    }
 
-    uint32_t outData[24*(dacMax-dacMin+1)/dacStep];
-    genScanLocal(&la, outData, ohN, mask, ch, useCalPulse, currentPulse, calScaleFactor, nevts, dacMin, dacMax, dacStep, scanReg, useUltra, useExtTrig);
-    response->set_word_array("data",outData,24*(dacMax-dacMin+1)/dacStep);
+    std::vector<uint32_t> outData(24*(dacMax-dacMin+1)/dacStep);
+    genScanLocal(&la, outData.data(), ohN, mask, ch, useCalPulse, currentPulse, calScaleFactor, nevts, dacMin, dacMax, dacStep, scanReg, useUltra, useExtTrig, nullptr, minTrigRate);
+    setResultArray(response, job.get(), "data", outData.data(), outData.size());
+    if (job)
+        publishResultJob(response, job);
 
     rtxn.abort();
 }
 
+LatencyScanPeak findLatencyPeak(const uint32_t *hits, uint32_t nSteps, uint32_t latMin, uint32_t latStep)
+{
+    LatencyScanPeak peak = {0xdeaddead, 0, 0};
+    uint32_t peakIdx = 0;
+    for (uint32_t idx = 0; idx < nSteps; ++idx) {
+        if (hits[idx] > peak.maxHits) {
+            peak.maxHits = hits[idx];
+            peakIdx = idx;
+        }
+    }
+    if (peak.maxHits == 0)
+        return peak; //No hits at any latency
+
+    //Latencies around the peak with at least half of the maximum hits
+    uint32_t halfMax = (peak.maxHits+1)/2;
+    uint32_t lo = peakIdx, hi = peakIdx;
+    while (lo > 0 && hits[lo-1] >= halfMax)
+        --lo;
+    while (hi+1 < nSteps && hits[hi+1] >= halfMax)
+        ++hi;
+
+    peak.latency = latMin+peakIdx*latStep;
+    peak.width   = (hi-lo+1)*latStep;
+    return peak;
+} //End findLatencyPeak(...)
+
+void latencyScanLocal(localArgs *la, LatencyScanPeak *peaks, std::vector<uint32_t> *histograms, uint32_t ohN, uint32_t mask, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t latMin, uint32_t latMax, uint32_t latStep, bool useExtTrig, uint32_t minTrigRate)
+{
+    //Determine the inverse of the vfatmask
+    uint32_t notmask = ~mask & 0xFFFFFF;
+
+    const LatencyScanPeak noPeak = {0xdeaddead, 0xdeaddead, 0xdeaddead};
+    std::fill(peaks, peaks+24, noPeak);
+
+    if (latStep == 0 || latMin > latMax) {
+        la->response->set_string("error",stdsprintf("Bad latency range [%i,%i] with step %i", latMin, latMax, latStep));
+        return;
+    }
+
+    //The histograms are filled from the VFAT_DAQ_MONITOR, which only exists in v3 electronics
+    if (fw_version_check("latencyScanLocal", la) != 3) {
+        la->response->set_string("error","Latency scans are only supported in V3 electronics");
+        return;
+    }
+
+    GenScanRegs scanRegs;
+    if (!genScanPrepareLocal(la, scanRegs, ohN, mask, ch, useCalPulse, currentPulse, calScaleFactor, nevts, "LATENCY", useExtTrig))
+        return; //Error already reported
+
+    //CHANNEL_FIRE_COUNT of each VFAT and latency, VFAT after VFAT
+    const uint32_t nSteps = (latMax-latMin)/latStep+1;
+    std::vector<uint32_t> hits(24*nSteps, 0);
+
+    std::chrono::microseconds trigTimeout = triggerCycleTimeout(la, nevts, useExtTrig, minTrigRate);
+    uint32_t latVals[24];
+    uint32_t goodEvts[24];
+    uint32_t fireCnts[24];
+    bool complete = true;
+    for (uint32_t step = 0; step < nSteps; ++step)
+    {
+        if (calJobCancelled())
+            break;
+        uint32_t latency = latMin+step*latStep;
+        calJobProgress(step, nSteps, ohN, 0xffffffff, latency);
+
+        std::fill(latVals, latVals+24, latency);
+        if (!genScanCycleLocal(la, scanRegs, notmask, latVals, nevts, useExtTrig, trigTimeout, goodEvts, fireCnts)) {
+            complete = false; //Error already reported, do not scan the remaining latencies
+            break;
+        }
+
+        for (int vfatN = 0; vfatN < 24; vfatN++) if ((notmask >> vfatN) & 0x1)
+        {
+            hits[vfatN*nSteps+step] = fireCnts[vfatN];
+        }
+    } //End Loop from latMin to latMax
+
+    //If the calpulse for channel ch was turned on, turn it off
+    if (useCalPulse) {
+        if (confCalPulseLocal(la, ohN, mask, ch, false, currentPulse, calScaleFactor) == false) {
+            la->response->set_string("error",stdsprintf("Unable to configure calpulse OFF for ohN %i mask %x chan %i", ohN, mask, ch));
+        }
+    }
+
+    if (complete) {
+        for (int vfatN = 0; vfatN < 24; vfatN++) if ((notmask >> vfatN) & 0x1)
+        {
+            peaks[vfatN] = findLatencyPeak(hits.data()+vfatN*nSteps, nSteps, latMin, latStep);
+            LOGGER->log_message(LogManager::DEBUG, stdsprintf("OH%i VFAT%i latency peak at %i, width %i, max hits %i",
+                        ohN, vfatN, peaks[vfatN].latency, peaks[vfatN].width, peaks[vfatN].maxHits));
+        }
+    }
+
+    if (histograms)
+        histograms->swap(hits);
+} //End latencyScanLocal(...)
+
+void latencyScan(const RPCMsg *request, RPCMsg *response)
+{
+    GETLOCALARGS(response);
+
+    uint32_t nevts = request->get_word("nevts");
+    uint32_t ohN = request->get_word("ohN");
+    uint32_t ch = request->get_word("ch");
+    uint32_t mask = request->get_word("mask");
+    uint32_t latMin = request->get_key_exists("latMin") ? request->get_word("latMin") : request->get_word("dacMin");
+    uint32_t latMax = request->get_key_exists("latMax") ? request->get_word("latMax") : request->get_word("dacMax");
+    uint32_t latStep = request->get_key_exists("latStep") ? request->get_word("latStep") : request->get_word("dacStep");
+    bool useCalPulse = request->get_word("useCalPulse");
+    bool currentPulse = request->get_word("currentPulse");
+    uint32_t calScaleFactor = request->get_word("calScaleFactor");
+    bool useExtTrig = request->get_word("useExtTrig");
+    uint32_t minTrigRate = request->get_key_exists("minTrigRate") ? request->get_word("minTrigRate") : 0;
+    bool sendHistograms = request->get_key_exists("histograms") && request->get_word("histograms");
+
+    LatencyScanPeak peaks[24];
+    std::vector<uint32_t> histograms;
+    latencyScanLocal(&la, peaks, sendHistograms ? &histograms : nullptr, ohN, mask, ch, useCalPulse, currentPulse, calScaleFactor, nevts, latMin, latMax, latStep, useExtTrig, minTrigRate);
+
+    uint32_t peakLatency[24], peakWidth[24], maxHits[24];
+    for (int vfatN = 0; vfatN < 24; ++vfatN) {
+        peakLatency[vfatN] = peaks[vfatN].latency;
+        peakWidth[vfatN]   = peaks[vfatN].width;
+        maxHits[vfatN]     = peaks[vfatN].maxHits;
+    }
+    response->set_word_array("peakLatency",peakLatency,24);
+    response->set_word_array("peakWidth",peakWidth,24);
+    response->set_word_array("maxHits",maxHits,24);
+    if (sendHistograms) {
+        std::shared_ptr<ResultJob> job = resultJobFor(request);
+        setResultArray(response, job.get(), "data", histograms.data(), histograms.size());
+        if (job)
+            publishResultJob(response, job);
+    }
+
+    rtxn.abort();
+} //End latencyScan(...)
+
+void genScanMultiLinkLocal(localArgs *la, uint32_t *outData, uint32_t ohMask, uint32_t NOH, uint32_t ch, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useExtTrig, uint32_t minTrigRate)
+{
+    if (fw_version_check("genScanMultiLinkLocal", la) != 3) {
+        LOGGER->log_message(LogManager::ERROR, "genScanMultiLink is only supported in V3 electronics");
+        la->response->set_string("error","genScanMultiLink is only supported in V3 electronics");
+        return;
+    }
+
+    if (currentPulse && calScaleFactor > 3) {
+        la->response->set_string("error",stdsprintf("Bad value for CFG_CAL_FS: %x, Possible values are {0b00, 0b01, 0b10, 0b11}. Exiting.",calScaleFactor));
+        return;
+    }
+
+    const uint32_t nDacVals = (dacMax-dacMin+1)/dacStep;
+    std::fill(outData, outData+NOH*24*nDacVals, 0xdeaddead);
+
+    //Determine the unmasked VFATs of each selected link, links with a VFAT out of sync are dropped
+    std::vector<uint32_t> ohList;
+    std::vector<uint32_t> notmasks(NOH, 0);
+    for (uint32_t ohN = 0; ohN < NOH; ++ohN) {
+        if (!((ohMask >> ohN) & 0x1))
+            continue;
+
+        uint32_t notmask   = ~getOHVFATMaskLocal(la, ohN) & 0xFFFFFF;
+        uint32_t goodVFATs = vfatSyncCheckLocal(la, ohN);
+        if ( (notmask & goodVFATs) != notmask) {
+            LOGGER->log_message(LogManager::ERROR, stdsprintf("One of the unmasked VFATs on OH%i is not Synced. goodVFATs: %x\tnotmask: %x, skipping OH%i",ohN,goodVFATs,notmask,ohN));
+            la->response->set_string("error",stdsprintf("One of the unmasked VFATs on OH%i is not Synced. goodVFATs: %x\tnotmask: %x",ohN,goodVFATs,notmask));
+            continue;
+        }
+
+        if (useCalPulse && confCalPulseLocal(la, ohN, ~notmask & 0xFFFFFF, ch, true, currentPulse, calScaleFactor) == false) {
+            la->response->set_string("error",stdsprintf("Unable to configure calpulse ON for ohN %i chan %i", ohN, ch));
+            continue;
+        }
+
+        notmasks[ohN] = notmask;
+        ohList.push_back(ohN);
+    }
+
+    //Get register handles used in the scan loop
+    std::vector<std::vector<RegHandle> > scanRegHandles(NOH);
+    for (auto ohN : ohList)
+        scanRegHandles[ohN] = resolveFamily(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.CFG_"+scanReg, 24, ohN);
+    std::vector<RegHandle> goodEvtHandles = resolveFamily(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.VFAT{}.GOOD_EVENTS_COUNT", 24);
+    RegHandle l1aCounter       = resolveReg(la, "GEM_AMC.TTC.CMD_COUNTERS.L1A");
+    RegHandle daqMonReset      = resolveReg(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.CTRL.RESET");
+    RegHandle daqMonEnable     = resolveReg(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.CTRL.ENABLE");
+    RegHandle daqMonOHSelect   = resolveReg(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.CTRL.OH_SELECT");
+    RegHandle ttcCntReset      = resolveReg(la, "GEM_AMC.TTC.CTRL.CNT_RESET");
+    RegHandle ttcL1AEnable     = resolveReg(la, "GEM_AMC.TTC.CTRL.L1A_ENABLE");
+    RegHandle genCyclicStart   = resolveReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_START");
+    RegHandle genEnable        = resolveReg(la, "GEM_AMC.TTC.GENERATOR.ENABLE");
+    RegHandle genCyclicRunning = resolveReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_RUNNING");
+
+    //TTC Config
+    if (useExtTrig) {
+        writeReg(la, ttcL1AEnable, 0x0);
+        writeReg(la, ttcCntReset, 0x1);
+    }
+    else{
+        writeReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_L1A_COUNT", nevts);
+        writeReg(la, "GEM_AMC.TTC.GENERATOR.SINGLE_RESYNC", 0x1);
+    }
+
+    //Configure VFAT_DAQ_MONITOR, channel selection is common to all links
+    if (!ohList.empty())
+        dacMonConfLocal(la, ohList.front(), ch);
+
+    bool useGenerator = !useExtTrig && readReg(la, genEnable);
+    std::chrono::microseconds trigTimeout = triggerCycleTimeout(la, nevts, useExtTrig, minTrigRate);
+    bool cycleDone = true;
+    uint32_t goodEvts[24];
+    for (uint32_t dacVal = dacMin; dacVal <= dacMax && cycleDone && !calJobCancelled(); dacVal += dacStep) {
+        //Write the scan reg value on every link at once
+        RegWriteBatch dacWrites(la);
+        for (auto ohN : ohList)
+            for (int vfatN = 0; vfatN < 24; vfatN++) if ((notmasks[ohN] >> vfatN) & 0x1)
+                dacWrites.add(scanRegHandles[ohN][vfatN], dacVal);
+        dacWrites.commit();
+
+        //The VFAT_DAQ_MONITOR follows one link at a time, take one trigger cycle per link
+        for (auto ohN : ohList) {
+            calJobProgress((dacVal-dacMin)/dacStep, nDacVals, ohN, 0xffffffff, dacVal);
+            writeReg(la, daqMonEnable, 0x0);
+            writeReg(la, daqMonOHSelect, ohN);
+            writeReg(la, daqMonReset, 0x1);
+            writeReg(la, daqMonEnable, 0x1);
+
+            if (useExtTrig) {
+                writeReg(la, ttcCntReset, 0x1);
+                writeReg(la, ttcL1AEnable, 0x1);
+                cycleDone = waitForRegister(la, l1aCounter, [nevts](uint32_t l1aCnt) { return l1aCnt >= nevts; },
+                                            waitDeadline(trigTimeout));
+                writeReg(la, ttcL1AEnable, 0x0);
+            }
+            else{
+                writeReg(la, genCyclicStart, 0x1);
+                if (useGenerator) {
+                    cycleDone = waitForRegister(la, genCyclicRunning, [](uint32_t running) { return running == 0; },
+                                                waitDeadline(trigTimeout));
+                }
+            }
+
+            //Stop the DAQ monitor counters from incrementing and read them in one go
+            writeReg(la, daqMonEnable, 0x0);
+            if (!cycleDone)
+                break; //Error already reported, do not scan the remaining points
+            readRegs(la, goodEvtHandles, goodEvts);
+            for (int vfatN = 0; vfatN < 24; vfatN++) {
+                if ( !( (notmasks[ohN] >> vfatN) & 0x1)) continue;
+                int idx = ohN*24*nDacVals + vfatN*(dacMax-dacMin+1)/dacStep+(dacVal-dacMin)/dacStep;
+                outData[idx] = goodEvts[vfatN];
+            }
+        } //End Loop over links
+        LOGGER->log_message(LogManager::DEBUG, stdsprintf("%s Value: %i done on OH mask 0x%x", scanReg.c_str(), dacVal, ohMask));
+    } //End Loop from dacMin to dacMax
+
+    //If the calpulse for channel ch was turned on, turn it off
+    if (useCalPulse) {
+        for (auto ohN : ohList) {
+            if (confCalPulseLocal(la, ohN, ~notmasks[ohN] & 0xFFFFFF, ch, false, currentPulse, calScaleFactor) == false)
+                la->response->set_string("error",stdsprintf("Unable to configure calpulse OFF for ohN %i chan %i", ohN, ch));
+        }
+    }
+    return;
+} //End genScanMultiLinkLocal(...)
+
+void genScanMultiLink(const RPCMsg *request, RPCMsg *response)
+{
+    GETLOCALARGS(response);
+
+    uint32_t ohMask = request->get_word("ohMask");
+    uint32_t nevts = request->get_word("nevts");
+    uint32_t ch = request->get_word("ch");
+    uint32_t dacMin = request->get_word("dacMin");
+    uint32_t dacMax = request->get_word("dacMax");
+    uint32_t dacStep = request->get_word("dacStep");
+    bool useCalPulse = request->get_word("useCalPulse");
+    bool currentPulse = request->get_word("currentPulse");
+    uint32_t calScaleFactor = request->get_word("calScaleFactor");
+    bool useExtTrig = request->get_word("useExtTrig");
+    uint32_t minTrigRate = request->get_key_exists("minTrigRate") ? request->get_word("minTrigRate") : 0;
+    std::string scanReg = request->get_string("scanReg");
+
+    unsigned int NOH = readReg(&la, "GEM_AMC.GEM_SYSTEM.CONFIG.NUM_OF_OH");
+    if (request->get_key_exists("NOH")) {
+        unsigned int NOH_requested = request->get_word("NOH");
+        if (NOH_requested <= NOH)
+            NOH = NOH_requested;
+        else
+            LOGGER->log_message(LogManager::WARNING, stdsprintf("NOH requested (%i) > NUM_OF_OH AMC register value (%i), NOH request will be disregarded",NOH_requested,NOH));
+    }
+
+    std::shared_ptr<ResultJob> job = resultJobFor(request);
+    std::vector<uint32_t> outData(NOH*24*(dacMax-dacMin+1)/dacStep);
+    genScanMultiLinkLocal(&la, outData.data(), ohMask, NOH, ch, useCalPulse, currentPulse, calScaleFactor, nevts, dacMin, dacMax, dacStep, scanReg, useExtTrig, minTrigRate);
+    setResultArray(response, job.get(), "data", outData.data(), outData.size());
+    if (job)
+        publishResultJob(response, job);
+    LOGGER->log_message(LogManager::INFO, stdsprintf("Finished %s scans for OH Mask 0x%x", scanReg.c_str(), ohMask));
+
+    rtxn.abort();
+} //End genScanMultiLink(...)
+
 void sbitRateScanLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outDataTrigRate, uint32_t ohN, uint32_t maskOh, bool invertVFATPos, uint32_t ch, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, uint32_t waitTime)
 {
     char regBuf[200];
@@ -556,24 +982,24 @@ void sbitRateScanLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outData
 
             //If ch!=128 store the original channel mask settings
             //Then mask all other channels except for channel ch
-            std::unordered_map<uint32_t, uint32_t> map_chanOrigMask; //key -> reg addr; val -> reg value
-            if ( ch != 128) map_chanOrigMask = setSingleChanMask(ohN,vfatN,ch,la);
+            RegSnapshot origRegs(la);
+            if ( ch != 128) setSingleChanMask(ohN,vfatN,ch,la,origRegs);
 
             //Get the OH Rate Monitor Address
             sprintf(regBuf,"GEM_AMC.TRIGGER.OH%i.TRIGGER_RATE",ohN);
             uint32_t ohTrigRateAddr = getAddress(la, regBuf);
 
             //Store the original OH VFAT Mask, and then reset it
-            sprintf(regBuf,"GEM_AMC.OH.OH%i.FPGA.TRIG.CTRL.VFAT_MASK",ohN);
-            uint32_t ohVFATMaskAddr = getAddress(la, regBuf);
-            uint32_t maskOhOrig = readRawAddress(ohVFATMaskAddr, la->response);   //We'll write this later
-            writeRawAddress(ohVFATMaskAddr, maskOh, la->response);
+            RegHandle ohVFATMask = resolve(la, "GEM_AMC.OH.OH{}.FPGA.TRIG.CTRL.VFAT_MASK", ohN);
+            origRegs.capture({ohVFATMask}); //We'll write this later
+            writeReg(la, ohVFATMask, maskOh);
 
             //Take the VFATs out of slow control only mode
             writeReg(la, "GEM_AMC.GEM_SYSTEM.VFAT3.SC_ONLY_MODE", 0x0);
 
             //Loop from dacMin to dacMax in steps of dacStep
-            for (uint32_t dacVal = dacMin; dacVal <= dacMax; dacVal += dacStep) {
+            for (uint32_t dacVal = dacMin; dacVal <= dacMax && !calJobCancelled(); dacVal += dacStep) {
+                calJobProgress((dacVal-dacMin)/dacStep, (dacMax-dacMin+1)/dacStep, ohN, vfatN, dacVal);
                 sprintf(regBuf,"GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_%s",ohN,vfatN,scanReg.c_str());
                 writeReg(la, regBuf, dacVal);
                 std::this_thread::sleep_for(std::chrono::milliseconds(waitTime));
@@ -583,11 +1009,8 @@ void sbitRateScanLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outData
                 outDataTrigRate[idx] = readRawAddress(ohTrigRateAddr, la->response);
             } //End Loop from dacMin to dacMax
 
-            //Restore the original channel masks if specific channel was requested
-            if ( ch != 128) applyChanMask(map_chanOrigMask, la);
-
-            //Restore the original maskOh
-            writeRawAddress(ohVFATMaskAddr, maskOhOrig, la->response);
+            //Restore the original channel masks if specific channel was requested, and the original maskOh
+            origRegs.restore();
 
             break;
         }//End v3 electronics behavior
@@ -602,7 +1025,7 @@ void sbitRateScanLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outData
     return;
 } //End sbitRateScanLocal(...)
 
-void sbitRateScanParallelLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outDataTrigRatePerVFAT, uint32_t *outDataTrigRateOverall, uint32_t ch, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, uint32_t ohMask=0x3FF)
+void sbitRateScanParallelLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t *outDataTrigRatePerVFAT, uint32_t *outDataTrigRateOverall, uint32_t ch, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, uint32_t ohMask, uint32_t waitTime, AdaptiveScan *adaptive)
 {
     char regBuf[200];
     // Check that OH mask does not exceeds 0x3FF
@@ -612,8 +1035,14 @@ void sbitRateScanParallelLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t
          la->response->set_string("error",regBuf);
          return;
     }
+    // SBIT_CNT_TIME_MAX counts bunch crossings in a 32 bit register
+    uint64_t cntTimeMax = uint64_t(BX_PER_SECOND)*waitTime/1000;
+    if (waitTime == 0 || cntTimeMax > 0xffffffff) {
+         la->response->set_string("error",stdsprintf("Bad value for waitTime: %i ms, the SBIT counting window must be between 1 and %i ms", waitTime, uint32_t(0xffffffffULL*1000/BX_PER_SECOND)));
+         return;
+    }
     uint32_t vfatmask[12] = {0};
-    std::unordered_map<uint32_t, uint32_t> origVFATmasks[12][24];
+    RegSnapshot origChanMasks(la);
     switch (fw_version_check("SBIT Rate Scan", la)){
         case 3:
         {
@@ -634,22 +1063,22 @@ void sbitRateScanParallelLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t
                         {
                             //Skip this vfat if it's masked
                             if ( !( (notmask >> vfat) & 0x1)) continue;
-                            origVFATmasks[ohN][vfat] = setSingleChanMask(ohN,vfat,ch,la);
+                            setSingleChanMask(ohN,vfat,ch,la,origChanMasks);
                         } //End loop over all vfats
                     } //End loop over vfat channels
                 } //End case this OH is not masked
             } //End loop over optohybrids
 
-            //Get the SBIT Rate Monitor Address
-            uint32_t ohTrigRateAddr[12][25]; //idx 0->23 VFAT counters; idx 24 overall rate
+            //Get the SBIT Rate Monitor registers
+            std::vector<RegHandle> sbitCntHandles[12]; //idx 0->23 VFAT counters; idx 24 overall rate
+            std::vector<RegHandle> scanRegHandles[12];
+            RegHandle cntResetHandles[12];
             for (int ohN = 0; ohN < 12; ++ohN) {
                 if ((ohMask >> ohN) & 0x1) {
-                    sprintf(regBuf,"GEM_AMC.TRIGGER.OH%i.TRIGGER_RATE",ohN);
-                    ohTrigRateAddr[ohN][24] = getAddress(la, regBuf);
-                    for(int vfat=0; vfat<24; ++vfat){
-                        sprintf(regBuf,"GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.VFAT%i_SBITS",ohN,vfat);
-                        ohTrigRateAddr[ohN][vfat] = getAddress(la, regBuf);
-                    } //End loop over all VFATs
+                    sbitCntHandles[ohN] = resolveFamily(la, "GEM_AMC.OH.OH{}.FPGA.TRIG.CNT.VFAT{}_SBITS", 24, ohN);
+                    sbitCntHandles[ohN].push_back(resolve(la, "GEM_AMC.TRIGGER.OH{}.TRIGGER_RATE", ohN));
+                    scanRegHandles[ohN]  = resolveFamily(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.CFG_"+scanReg, 24, ohN);
+                    cntResetHandles[ohN] = resolve(la, "GEM_AMC.OH.OH{}.FPGA.TRIG.CNT.RESET", ohN);
                 }
             } //End loop over optohybrids
 
@@ -660,65 +1089,120 @@ void sbitRateScanParallelLocal(localArgs *la, uint32_t *outDataDacVal, uint32_t
             for (int ohN = 0; ohN < 12; ++ohN) {
                 if ((ohMask >> ohN) & 0x1) {
                     writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.SBIT_CNT_PERSIST",ohN), 0x0); //reset all counters after SBIT_CNT_TIME_MAX
-                    writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.SBIT_CNT_TIME_MAX",ohN), 0x02638e98); //count for 1 second
+                    writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.SBIT_CNT_TIME_MAX",ohN), uint32_t(cntTimeMax)); //count for waitTime milliseconds
                 }
             }
 
-            //Loop from dacMin to dacMax in steps of dacStep
-            for (uint32_t dacVal = dacMin; dacVal <= dacMax; dacVal += dacStep) {
+            //Set the scan register value on all the optohybrids at once
+            auto setDacVal = [&](uint32_t dacVal) {
                 LOGGER->log_message(LogManager::INFO, stdsprintf("Setting %s to %i for all optohybrids in 0x%x",scanReg.c_str(),dacVal,ohMask));
-
-                //Set the scan register value
+                RegWriteBatch dacWrites(la);
                 for (int ohN = 0; ohN < 12; ++ohN) {
                     if ((ohMask >> ohN) & 0x1) {
                         uint32_t notmask = ~vfatmask[ohN] & 0xFFFFFF;
                         for(int vfat=0; vfat<24; ++vfat){
                             if ( !( (notmask >> vfat) & 0x1)) continue;
-                            sprintf(regBuf,"GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_%s",ohN,vfat,scanReg.c_str());
-                            writeReg(la, regBuf, dacVal);
+                            dacWrites.add(scanRegHandles[ohN][vfat], dacVal);
                         } //End Loop Over all VFATs
                     } // End checking whether the OH is masked
                 } // End loop over optohybrids
+                dacWrites.commit();
+            };
 
-                //Reset the counters
+            //Reset the counters, this starts a new counting window
+            std::chrono::steady_clock::time_point windowEnd;
+            auto startWindow = [&]() {
                 for (int ohN = 0; ohN < 12; ++ohN) {
                     if ((ohMask >> ohN) & 0x1) {
-                        writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.RESET",ohN), 0x1);
+                        writeReg(la, cntResetHandles[ohN], 0x1);
                     } // End checking whether the OH is masked
                 } // End loop over optohybrids
+                windowEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitTime + SBIT_CNT_WINDOW_MARGIN_MS);
+            };
 
-                //Wait just over 1 second
-                std::this_thread::sleep_for(std::chrono::milliseconds(1005));
-
-                //Read the counters
+            //Read the counters of the last completed window, VFAT counts are converted to Hz
+            auto readCounters = [&](uint32_t dacVal) {
+                uint32_t sbitCnts[25];
                 for (int ohN = 0; ohN < 12; ++ohN) {
                     if ((ohMask >> ohN) & 0x1) {
+                        readRegs(la, sbitCntHandles[ohN], sbitCnts);
                         uint32_t notmask = ~vfatmask[ohN] & 0xFFFFFF;
                         int idx = ohN*(dacMax-dacMin+1)/dacStep + (dacVal-dacMin)/dacStep;
                         outDataDacVal[idx] = dacVal;
-                        outDataTrigRateOverall[idx] = readRawAddress(ohTrigRateAddr[ohN][24], la->response);
+                        outDataTrigRateOverall[idx] = sbitCnts[24];
                         for(int vfat=0; vfat<24; ++vfat){
                             if ( !( (notmask >> vfat) & 0x1)) continue;
 
                             idx = ohN*24*(dacMax-dacMin+1)/dacStep + vfat*(dacMax-dacMin+1)/dacStep+(dacVal-dacMin)/dacStep;
-                            outDataTrigRatePerVFAT[idx] = readRawAddress(ohTrigRateAddr[ohN][vfat], la->response);
+                            outDataTrigRatePerVFAT[idx] = sbitCnts[vfat] == 0xdeaddead ? 0xdeaddead : uint32_t(uint64_t(sbitCnts[vfat])*1000/waitTime);
                         } //End Loop Over all VFATs
                     } // End checking whether the OH is masked
                 } // End loop over optohybrids
-            } //End Loop from dacMin to dacMax
-
-            //Restore the original channel masks if specific channel was requested
-            if( ch != 128) {
+            };
+
+            if (adaptive) {
+                //Each VFAT is set to its own point, one counting window measures all of them
+                uint32_t dacVals[12][24];
+                uint32_t measure[12] = {0};
+                uint32_t sbitCnts[25];
+                uint32_t rates[24];
+                int firstOH = ohMask ? __builtin_ctz(ohMask) : 0;
                 for (int ohN = 0; ohN < 12; ++ohN) {
-                    if ((ohMask >> ohN) & 0x1) {
-                        uint32_t notmask = ~vfatmask[ohN] & 0xFFFFFF;
-                        for(int vfat=0; vfat<24; ++vfat){
-                            if ( !( (notmask >> vfat) & 0x1)) continue;
-                            applyChanMask(origVFATmasks[ohN][vfat], la);
+                    if ((ohMask >> ohN) & 0x1)
+                        adaptive[ohN].mask(vfatmask[ohN]);
+                }
+                while (!calJobCancelled()) {
+                    calJobProgress(adaptive[firstOH].steps(), adaptive[firstOH].plannedSteps(), 0xffffffff, 0xffffffff, 0);
+
+                    uint32_t anyMeasure = 0;
+                    RegWriteBatch dacWrites(la);
+                    for (int ohN = 0; ohN < 12; ++ohN) {
+                        if ((ohMask >> ohN) & 0x1) {
+                            measure[ohN] = adaptive[ohN].next(dacVals[ohN]);
+                            for (int vfat = 0; vfat < 24; ++vfat) {
+                                if ((measure[ohN] >> vfat) & 0x1)
+                                    dacWrites.add(scanRegHandles[ohN][vfat], dacVals[ohN][vfat]);
+                            }
+                            anyMeasure |= measure[ohN];
+                        }
+                    }
+                    if (!anyMeasure)
+                        break;
+                    dacWrites.commit();
+
+                    startWindow();
+                    std::this_thread::sleep_until(windowEnd);
+
+                    for (int ohN = 0; ohN < 12; ++ohN) {
+                        if (measure[ohN]) {
+                            readRegs(la, sbitCntHandles[ohN], sbitCnts);
+                            for (int vfat = 0; vfat < 24; ++vfat)
+                                rates[vfat] = sbitCnts[vfat] == 0xdeaddead ? 0xdeaddead : uint32_t(uint64_t(sbitCnts[vfat])*1000/waitTime);
+                            adaptive[ohN].record(rates);
                         }
                     }
                 }
+                LOGGER->log_message(LogManager::INFO, stdsprintf("Adaptive %s scan took %i counting windows", scanReg.c_str(), adaptive[firstOH].steps()));
+            } else {
+                //Loop from dacMin to dacMax in steps of dacStep
+                setDacVal(dacMin);
+                startWindow();
+                for (uint32_t dacVal = dacMin; dacVal <= dacMax; dacVal += dacStep) {
+                    calJobProgress((dacVal-dacMin)/dacStep, (dacMax-dacMin+1)/dacStep, 0xffffffff, 0xffffffff, dacVal);
+
+                    //Wait for the end of the counting window and read it out before the reset of the next window clears it
+                    std::this_thread::sleep_until(windowEnd);
+                    readCounters(dacVal);
+
+                    if (dacVal + dacStep > dacMax || calJobCancelled())
+                        break;
+                    setDacVal(dacVal + dacStep);
+                    startWindow();
+                } //End Loop from dacMin to dacMax
             }
+
+            //Restore the original channel masks if specific channel was requested
+            origChanMasks.restore();
             break;
         }//End v3 electronics behavior
         default:
@@ -742,20 +1226,42 @@ void sbitRateScan(const RPCMsg *request, RPCMsg *response)
     uint32_t dacMax = request->get_word("dacMax");
     uint32_t dacStep = request->get_word("dacStep");
     std::string scanReg = request->get_string("scanReg");
+    uint32_t waitTime = 1000;
+    if (request->get_key_exists("waitTime"))
+        waitTime = request->get_word("waitTime");
+
+    std::shared_ptr<ResultJob> job = resultJobFor(request);
+    if (request->get_key_exists("adaptive")) {
+        //The VFAT masks are applied per link inside sbitRateScanParallelLocal(...)
+        std::vector<AdaptiveScan> adaptive(12, adaptiveScanFor(request, 0xFFFFFF, dacMin, dacMax, dacStep));
+        sbitRateScanParallelLocal(&la, nullptr, nullptr, nullptr, ch, dacMin, dacMax, dacStep, scanReg, ohMask, waitTime, adaptive.data());
+
+        std::vector<uint32_t> nPoints, dacVals, data;
+        for (auto const& scan : adaptive)
+            scan.appendPoints(nPoints, dacVals, data);
+        setResultArray(response, job.get(), "nPoints", nPoints.data(), nPoints.size());
+        setResultArray(response, job.get(), "dacVals", dacVals.data(), dacVals.size());
+        setResultArray(response, job.get(), "data", data.data(), data.size());
+        if (job)
+            publishResultJob(response, job);
+        return;
+    }
 
-    uint32_t outDataTrigRatePerVFAT[12*24*(dacMax-dacMin+1)/dacStep];
-    uint32_t outDataDacValPerOH[12*(dacMax-dacMin+1)/dacStep];
-    uint32_t outDataTrigRatePerOH[12*(dacMax-dacMin+1)/dacStep];
-    sbitRateScanParallelLocal(&la, outDataDacValPerOH, outDataTrigRatePerVFAT, outDataTrigRatePerOH, ch, dacMin, dacMax, dacStep, scanReg, ohMask);
+    std::vector<uint32_t> outDataTrigRatePerVFAT(12*24*(dacMax-dacMin+1)/dacStep);
+    std::vector<uint32_t> outDataDacValPerOH(12*(dacMax-dacMin+1)/dacStep);
+    std::vector<uint32_t> outDataTrigRatePerOH(12*(dacMax-dacMin+1)/dacStep);
+    sbitRateScanParallelLocal(&la, outDataDacValPerOH.data(), outDataTrigRatePerVFAT.data(), outDataTrigRatePerOH.data(), ch, dacMin, dacMax, dacStep, scanReg, ohMask, waitTime);
 
-    response->set_word_array("outDataVFATRate", outDataTrigRatePerVFAT, 12*24*(dacMax-dacMin+1)/dacStep);
-    response->set_word_array("outDataDacValue", outDataDacValPerOH, 12*(dacMax-dacMin+1)/dacStep);
-    response->set_word_array("outDataCTP7Rate", outDataTrigRatePerOH, 12*(dacMax-dacMin+1)/dacStep);
+    setResultArray(response, job.get(), "outDataVFATRate", outDataTrigRatePerVFAT.data(), outDataTrigRatePerVFAT.size());
+    setResultArray(response, job.get(), "outDataDacValue", outDataDacValPerOH.data(), outDataDacValPerOH.size());
+    setResultArray(response, job.get(), "outDataCTP7Rate", outDataTrigRatePerOH.data(), outDataTrigRatePerOH.size());
+    if (job)
+        publishResultJob(response, job);
 
     return;
 } //End sbitRateScan(...)
 
-void checkSbitMappingWithCalPulseLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t vfatN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay)
+bool checkSbitMappingVFATsLocal(localArgs *la, uint32_t ohN, uint32_t vfatsToPulse, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay, const SbitMappingPulseHandler & onPulse)
 {
     //Determine the inverse of the vfatmask
     uint32_t notmask = ~mask & 0xFFFFFF;
@@ -765,31 +1271,31 @@ void checkSbitMappingWithCalPulseLocal(localArgs *la, uint32_t *outData, uint32_
         LOGGER->log_message(LogManager::ERROR, "checkSbitMappingWithCalPulse is only supported in V3 electronics");
         sprintf(regBuf,"checkSbitMappingWithCalPulse is only supported in V3 electronics");
         la->response->set_string("error",regBuf);
-        return;
+        return false;
+    }
+
+    if (vfatsToPulse & ~notmask) {
+        la->response->set_string("error",stdsprintf("The vfats of interest %x should not be part of the vfats to be masked: %x",vfatsToPulse, mask));
+        return false;
     }
 
     uint32_t goodVFATs = vfatSyncCheckLocal(la, ohN);
     if ( (notmask & goodVFATs) != notmask) {
         sprintf(regBuf,"One of the unmasked VFATs is not Synced. goodVFATs: %x\tnotmask: %x",goodVFATs,notmask);
         la->response->set_string("error",regBuf);
-        return;
+        return false;
     }
 
     if (currentPulse && calScaleFactor > 3) {
         sprintf(regBuf,"Bad value for CFG_CAL_FS: %x, Possible values are {0b00, 0b01, 0b10, 0b11}. Exiting.",calScaleFactor);
         la->response->set_string("error",regBuf);
-        return;
+        return false;
     }
 
-    //Get current channel register data, mask all channels and disable calpulse
-    uint32_t chanRegData_orig[3072]; //original channel register data
-    uint32_t chanRegData_tmp[3072]; //temporary channel register data
-    getChannelRegistersVFAT3Local(la, ohN, mask, chanRegData_orig);
-    for (int idx=0; idx < 3072; ++idx) {
-        chanRegData_tmp[idx]=chanRegData_orig[idx]+(0x1 << 14); //set channel mask to true
-        chanRegData_tmp[idx]=chanRegData_tmp[idx]-(0x1 << 15); //disable calpulse
-    }
-    setChannelRegistersVFAT3SimpleLocal(la, ohN, mask, chanRegData_tmp);
+    //Store current channel register data and trigger VFAT mask, mask all channels and disable calpulse
+    RegHandle ohVFATMask = resolve(la, "GEM_AMC.OH.OH{}.FPGA.TRIG.CTRL.VFAT_MASK", ohN);
+    RegSnapshot origRegs(la, {ohVFATMask});
+    maskAllChannelsLocal(la, ohN, mask, origRegs);
 
     //Setup TTC Generator
     ttcGenConfLocal(la, ohN, 0, 0, pulseDelay, L1Ainterval, nevts, true);
@@ -803,109 +1309,138 @@ void checkSbitMappingWithCalPulseLocal(localArgs *la, uint32_t *outData, uint32_
     //Take the VFATs out of slow control only mode
     writeReg(la, "GEM_AMC.GEM_SYSTEM.VFAT3.SC_ONLY_MODE", 0x0);
 
-    //Setup the sbit monitor
-    const int nclusters = 8;
+    //Setup the sbit monitor, the clusters of one pulse are read together
     writeReg(la, "GEM_AMC.TRIGGER.SBIT_MONITOR.OH_SELECT", ohN);
     uint32_t addrSbitMonReset=getAddress(la, "GEM_AMC.TRIGGER.SBIT_MONITOR.RESET");
-    uint32_t addrSbitCluster[nclusters];
-    for (int iCluster=0; iCluster < nclusters; ++iCluster) {
-        sprintf(regBuf, "GEM_AMC.TRIGGER.SBIT_MONITOR.CLUSTER%i",iCluster);
-        addrSbitCluster[iCluster] = getAddress(la, regBuf);
-    }
+    std::vector<RegHandle> sbitClusters = resolveFamily(la, "GEM_AMC.TRIGGER.SBIT_MONITOR.CLUSTER{}", SBIT_MONITOR_CLUSTERS);
+    uint32_t clusters[SBIT_MONITOR_CLUSTERS];
+
+    uint32_t nVFATs = __builtin_popcount(vfatsToPulse);
+    uint32_t iVFAT = 0;
+    for (uint32_t vfatN=0; vfatN < 24 && !calJobCancelled(); ++vfatN) { //Loop over the VFATs to pulse
+        if ( !( (vfatsToPulse >> vfatN) & 0x1)) continue;
+        calJobStage(iVFAT++, nVFATs);
+
+        //mask all other vfats from trigger
+        writeReg(la, ohVFATMask, 0xffffff & ~(1 << (vfatN)));
+
+        //Place this vfat into run mode
+        writeReg(la,stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_RUN",ohN, vfatN), 0x1);
+
+        std::vector<RegHandle> chanMasks = resolveFamily(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.VFAT_CHANNELS.CHANNEL{}.MASK", 128, ohN, vfatN);
+        for (uint32_t chan=0; chan < 128 && !calJobCancelled(); ++chan) { //Loop over all channels
+            calJobProgress(chan, 128, ohN, vfatN, chan);
+            //unmask this channel
+            writeReg(la, chanMasks[chan], 0x0);
+
+            //Turn on the calpulse for this channel
+            if (confCalPulseLocal(la, ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan, useCalPulse, currentPulse, calScaleFactor) == false) {
+                la->response->set_string("error",stdsprintf("Unable to configure calpulse %b for ohN %i mask %x chan %i", useCalPulse, ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan));
+                return false; //Calibration pulse is not configured correctly
+            }
 
-    if (!((notmask >> vfatN) & 0x1)) {
-        la->response->set_string("error",stdsprintf("The vfat of interest %i should not be part of the vfats to be masked: %x",vfatN, mask));
-        return;
-    }
+            //Start Pulsing
+            for (unsigned int iPulse=0; iPulse < nevts; ++iPulse) { //Pulse this channel
+                //Reset monitors
+                writeRawAddress(addrSbitMonReset, 0x1, la->response);
 
-    //mask all other vfats from trigger
-    writeReg(la,stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CTRL.VFAT_MASK",ohN), 0xffffff & ~(1 << (vfatN)));
+                //Start the TTC Generator
+                if (useCalPulse) {
+                    writeRawAddress(addrTtcStart, 0x1, la->response);
+                }
 
-    //Place this vfat into run mode
-    writeReg(la,stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_RUN",ohN, vfatN), 0x1);
+                //Sleep for 200 us + pulseDelay * 25 ns * (0.001 us / ns)
+                std::this_thread::sleep_for(std::chrono::microseconds(200+int(ceil(pulseDelay*25*0.001))));
 
-    for (int chan=0; chan < 128; ++chan) { //Loop over all channels
-        //unmask this channel
-        writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.VFAT_CHANNELS.CHANNEL%i.MASK",ohN,vfatN,chan), 0x0);
+                //Check clusers
+                readRegs(la, sbitClusters, clusters);
+                onPulse(vfatN, chan, iPulse, clusters);
+            } //End Pulses for this channel
 
-        //Turn on the calpulse for this channel
-        if (confCalPulseLocal(la, ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan, useCalPulse, currentPulse, calScaleFactor) == false) {
-            la->response->set_string("error",stdsprintf("Unable to configure calpulse %b for ohN %i mask %x chan %i", useCalPulse, ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan));
-            return; //Calibration pulse is not configured correctly
-        }
+            //Turn off the calpulse for this channel
+            if (confCalPulseLocal(la, ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan, false, currentPulse, calScaleFactor) == false) {
+                la->response->set_string("error",stdsprintf("Unable to configure calpulse OFF for ohN %i mask %x chan %i", ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan));
+                return false; //Calibration pulse is not configured correctly
+            }
 
-        //Start Pulsing
-        for (unsigned int iPulse=0; iPulse < nevts; ++iPulse) { //Pulse this channel
-            //Reset monitors
-            writeRawAddress(addrSbitMonReset, 0x1, la->response);
+            //mask this channel
+            writeReg(la, chanMasks[chan], 0x1);
+        } //End Loop over all channels
 
-            //Start the TTC Generator
-            if (useCalPulse) {
-                writeRawAddress(addrTtcStart, 0x1, la->response);
-            }
+        //Place this vfat out of run mode
+        writeReg(la,stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_RUN",ohN, vfatN), 0x0);
+    } //End Loop over the VFATs to pulse
 
-            //Sleep for 200 us + pulseDelay * 25 ns * (0.001 us / ns)
-            std::this_thread::sleep_for(std::chrono::microseconds(200+int(ceil(pulseDelay*25*0.001))));
+    //turn off TTC Generator
+    ttcGenToggleLocal(la, ohN, false);
 
-            //Check clusers
-            for (int cluster=0; cluster<nclusters; ++cluster) {
-                //int idx = vfatN * posPerVFAT + chan * posPerChan + iPulse * posPerEvt + cluster; //Array index
-                int idx = chan * (nevts*nclusters) + (iPulse*nclusters+cluster);
+    //Return channel register settings and trigger vfat mask to their original values
+    origRegs.restore();
 
-                //bits [10:0] is the address of the cluster
-                //bits [14:12] is the cluster size
-                //bits 15 and 11 are not used
-                uint32_t thisCluster = readRawAddress(addrSbitCluster[cluster], la->response);
-                int clusterSize = (thisCluster >> 12) & 0x7;
-                uint32_t sbitAddress = (thisCluster & 0x7ff);
-                bool isValid = (sbitAddress < 1536); //Possible values are [0,(24*64)-1]
-                int vfatObserved = 7-int(sbitAddress/192)+int((sbitAddress%192)/64)*8;
-                int sbitObserved = sbitAddress % 64;
+    return true;
+} //End checkSbitMappingVFATsLocal(...)
 
-                outData[idx] = ((clusterSize & 0x7 ) << 27) + ((isValid & 0x1) << 26) + ((vfatObserved & 0x1f) << 21) + ((vfatN & 0x1f) << 16) + ((sbitObserved & 0xff) << 8) + (chan & 0xff);
+uint32_t packSbitCluster(uint32_t cluster, uint32_t vfatN, uint32_t chan)
+{
+    //bits [10:0] is the address of the cluster
+    //bits [14:12] is the cluster size
+    //bits 15 and 11 are not used
+    int clusterSize = (cluster >> 12) & 0x7;
+    uint32_t sbitAddress = (cluster & 0x7ff);
+    bool isValid = (sbitAddress < 1536); //Possible values are [0,(24*64)-1]
+    int vfatObserved = 7-int(sbitAddress/192)+int((sbitAddress%192)/64)*8;
+    int sbitObserved = sbitAddress % 64;
+
+    return ((clusterSize & 0x7 ) << 27) + ((isValid & 0x1) << 26) + ((vfatObserved & 0x1f) << 21) + ((vfatN & 0x1f) << 16) + ((sbitObserved & 0xff) << 8) + (chan & 0xff);
+} //End packSbitCluster(...)
 
-                if (isValid) {
+void checkSbitMappingWithCalPulseLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t vfatN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay)
+{
+    if (vfatN >= 24) {
+        la->response->set_string("error",stdsprintf("The vfat of interest %i does not exist",vfatN));
+        return;
+    }
+
+    checkSbitMappingVFATsLocal(la, ohN, 0x1 << vfatN, mask, useCalPulse, currentPulse, calScaleFactor, nevts, L1Ainterval, pulseDelay,
+        [&](uint32_t, uint32_t chan, uint32_t iPulse, const uint32_t *clusters) {
+            for (uint32_t cluster=0; cluster<SBIT_MONITOR_CLUSTERS; ++cluster) {
+                //int idx = vfatN * posPerVFAT + chan * posPerChan + iPulse * posPerEvt + cluster; //Array index
+                int idx = chan * (nevts*SBIT_MONITOR_CLUSTERS) + (iPulse*SBIT_MONITOR_CLUSTERS+cluster);
+                outData[idx] = packSbitCluster(clusters[cluster], vfatN, chan);
+
+                if ((outData[idx] >> 26) & 0x1) {
                     LOGGER->log_message(
                             LogManager::INFO,
                             stdsprintf(
-                                "valid sbit data: useCalPulse %i; thisClstr %x; clstrSize %x; sbitAddr %x; isValid %x; vfatN %i; vfatObs %i; chan %i; sbitObs %i",
-                                useCalPulse, thisCluster, clusterSize, sbitAddress, isValid, vfatN, vfatObserved, chan, sbitObserved));
+                                "valid sbit data: useCalPulse %i; thisClstr %x; vfatN %i; chan %i; packed %x",
+                                useCalPulse, clusters[cluster], vfatN, chan, outData[idx]));
                 }
             } //End Loop over clusters
-        } //End Pulses for this channel
+        });
 
-        //Turn off the calpulse for this channel
-        if (confCalPulseLocal(la, ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan, false, currentPulse, calScaleFactor) == false) {
-            la->response->set_string("error",stdsprintf("Unable to configure calpulse OFF for ohN %i mask %x chan %i", ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan));
-            return; //Calibration pulse is not configured correctly
-        }
-
-        //mask this channel
-        writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.VFAT_CHANNELS.CHANNEL%i.MASK",ohN,vfatN,chan), 0x1);
-    } //End Loop over all channels
-
-    //Place this vfat out of run mode
-    writeReg(la,stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_RUN",ohN, vfatN), 0x0);
-    //} //End Loop over all VFATs
-
-    //turn off TTC Generator
-    ttcGenToggleLocal(la, ohN, false);
-
-    //Return channel register settings to their original values
-    setChannelRegistersVFAT3SimpleLocal(la, ohN, mask, chanRegData_orig);
+    return;
+} //End checkSbitMappingWithCalPulseLocal(...)
 
-    //Set trigger vfat mask for this OH back to 0
-    writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CTRL.VFAT_MASK",ohN), 0x0);
+void checkSbitMappingAllVFATsLocal(localArgs *la, std::vector<uint32_t> & outData, uint32_t ohN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t L1Ainterval, uint32_t pulseDelay)
+{
+    checkSbitMappingVFATsLocal(la, ohN, ~mask & 0xFFFFFF, mask, useCalPulse, currentPulse, calScaleFactor, nevts, L1Ainterval, pulseDelay,
+        [&](uint32_t vfatN, uint32_t chan, uint32_t iPulse, const uint32_t *clusters) {
+            for (uint32_t cluster=0; cluster<SBIT_MONITOR_CLUSTERS; ++cluster) {
+                uint32_t packed = packSbitCluster(clusters[cluster], vfatN, chan);
+                if ((packed >> 26) & 0x1)
+                    outData.push_back(packed);
+            } //End Loop over clusters
+        });
 
+    LOGGER->log_message(LogManager::INFO, stdsprintf("SBIT mapping of OH%i: %zu valid clusters", ohN, outData.size()));
     return;
-} //End checkSbitMappingWithCalPulseLocal(...)
+} //End checkSbitMappingAllVFATsLocal(...)
 
 void checkSbitMappingWithCalPulse(const RPCMsg *request, RPCMsg *response)
 {
     GETLOCALARGS(response);
 
     uint32_t ohN = request->get_word("ohN");
-    uint32_t vfatN = request->get_word("vfatN");
     uint32_t mask = request->get_word("mask");
     bool useCalPulse = request->get_word("useCalPulse");
     bool currentPulse = request->get_word("currentPulse");
@@ -914,18 +1449,28 @@ void checkSbitMappingWithCalPulse(const RPCMsg *request, RPCMsg *response)
     uint32_t L1Ainterval = request->get_word("L1Ainterval");
     uint32_t pulseDelay = request->get_word("pulseDelay");
 
-    uint32_t outData[128*8*nevts];
-    checkSbitMappingWithCalPulseLocal(&la, outData, ohN, vfatN, mask, useCalPulse, currentPulse, calScaleFactor, nevts, L1Ainterval, pulseDelay);
+    std::shared_ptr<ResultJob> job = resultJobFor(request);
+    std::vector<uint32_t> outData;
+    if (request->get_key_exists("allVFATs") && request->get_word("allVFATs")) {
+        checkSbitMappingAllVFATsLocal(&la, outData, ohN, mask, useCalPulse, currentPulse, calScaleFactor, nevts, L1Ainterval, pulseDelay);
+    } else {
+        uint32_t vfatN = request->get_word("vfatN");
+        outData.resize(128*SBIT_MONITOR_CLUSTERS*nevts);
+        checkSbitMappingWithCalPulseLocal(&la, outData.data(), ohN, vfatN, mask, useCalPulse, currentPulse, calScaleFactor, nevts, L1Ainterval, pulseDelay);
+    }
 
-    response->set_word_array("data",outData,128*8*nevts);
+    setResultArray(response, job.get(), "data", outData.data(), outData.size());
+    if (job)
+        publishResultJob(response, job);
 
     rtxn.abort();
 } //End checkSbitMappingWithCalPulse()
 
-void checkSbitRateWithCalPulseLocal(localArgs *la, uint32_t *outDataCTP7Rate, uint32_t *outDataFPGAClusterCntRate, uint32_t *outDataVFATSBits, uint32_t ohN, uint32_t vfatN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t waitTime, uint32_t pulseRate, uint32_t pulseDelay)
+void checkSbitRateVFATsLocal(localArgs *la, uint32_t *outDataCTP7Rate, uint32_t *outDataFPGAClusterCntRate, uint32_t *outDataVFATSBits, uint32_t ohN, uint32_t vfatsToPulse, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t waitTime, const std::vector<uint32_t> & pulseRates, uint32_t pulseDelay)
 {
     //Determine the inverse of the vfatmask
     uint32_t notmask = ~mask & 0xFFFFFF;
+    vfatsToPulse &= 0xFFFFFF;
 
     char regBuf[200];
     if ( fw_version_check("checkSbitRateWithCalPulse", la) < 3) {
@@ -948,36 +1493,26 @@ void checkSbitRateWithCalPulseLocal(localArgs *la, uint32_t *outDataCTP7Rate, ui
         return;
     }
 
+    if ((vfatsToPulse & notmask) != vfatsToPulse) {
+        la->response->set_string("error",stdsprintf("The vfats of interest %x should not be part of the vfats to be masked: %x",vfatsToPulse, mask));
+        return;
+    }
+
     //Get current channel register data, mask all channels and disable calpulse
     LOGGER->log_message(LogManager::INFO, stdsprintf("Storing vfat3 channel registers on ohN %i", ohN));
-    uint32_t chanRegData_orig[3072]; //original channel register data
-    uint32_t chanRegData_tmp[3072]; //temporary channel register data
+    RegSnapshot origRegs(la, {resolve(la, "GEM_AMC.OH.OH{}.FPGA.TRIG.CTRL.VFAT_MASK", ohN)});
     LOGGER->log_message(LogManager::INFO, stdsprintf("Masking all channels and disabling calpulse for vfats on ohN %i", ohN));
-    getChannelRegistersVFAT3Local(la, ohN, mask, chanRegData_orig);
-    for (int idx=0; idx < 3072; ++idx) {
-        chanRegData_tmp[idx]=chanRegData_orig[idx]+(0x1 << 14); //set channel mask to true
-        chanRegData_tmp[idx]=chanRegData_tmp[idx]-(0x1 << 15); //disable calpulse
-    }
-    setChannelRegistersVFAT3SimpleLocal(la, ohN, mask, chanRegData_tmp);
+    maskAllChannelsLocal(la, ohN, mask, origRegs);
 
     //Setup TTC Generator
-    uint32_t L1Ainterval;
-    if (pulseRate > 0) {
-        L1Ainterval = int(40079000 / pulseRate);
-    }
-    else{
-        L1Ainterval = 0;
-    }
     uint32_t addrTtcReset = getAddress(la, "GEM_AMC.TTC.GENERATOR.RESET");
     uint32_t addrTtcStart = getAddress(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_START");
 
-    //Get Trigger addresses
-    uint32_t ohTrigRateAddr[26]; //idx 0->23 VFAT counters; idx 24 rate measured by OH FPGA; idx 25 rate measured by CTP7
-    for (int vfat=0; vfat<24; ++vfat) {
-        ohTrigRateAddr[vfat] = getAddress(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.VFAT%i_SBITS",ohN,vfat));
-    } //End Loop over all VFATs
-    ohTrigRateAddr[24] = getAddress(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.CLUSTER_COUNT",ohN));
-    ohTrigRateAddr[25] = getAddress(la, stdsprintf("GEM_AMC.TRIGGER.OH%i.TRIGGER_RATE",ohN));
+    //Get Trigger registers, read together after each measurement
+    std::vector<RegHandle> trigRateRegs = resolveFamily(la, "GEM_AMC.OH.OH{}.FPGA.TRIG.CNT.VFAT{}_SBITS", 24, ohN); //idx 0->23 VFAT counters
+    trigRateRegs.push_back(resolve(la, "GEM_AMC.OH.OH{}.FPGA.TRIG.CNT.CLUSTER_COUNT", ohN)); //idx 24 rate measured by OH FPGA
+    trigRateRegs.push_back(resolve(la, "GEM_AMC.TRIGGER.OH{}.TRIGGER_RATE", ohN));           //idx 25 rate measured by CTP7
+    uint32_t trigRates[26];
     uint32_t addTrgCntResetOH = getAddress(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.RESET",ohN));
     uint32_t addTrgCntResetCTP7 = getAddress(la,"GEM_AMC.TRIGGER.CTRL.CNT_RESET");
 
@@ -992,90 +1527,145 @@ void checkSbitRateWithCalPulseLocal(localArgs *la, uint32_t *outDataCTP7Rate, ui
     //Prep the SBIT counters
     LOGGER->log_message(LogManager::INFO, stdsprintf("Preping SBIT Counters for ohN %i", ohN));
     writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.SBIT_CNT_PERSIST",ohN), 0x0); //reset all counters after SBIT_CNT_TIME_MAX
-    writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.SBIT_CNT_TIME_MAX",ohN), uint32_t(0x02638e98*waitTime/1000.) ); //count for a number of BX's specified by waitTime
-
-    if (!((notmask >> vfatN) & 0x1)) {
-        la->response->set_string("error",stdsprintf("The vfat of interest %i should not be part of the vfats to be masked: %x",vfatN, mask));
-        return;
+    writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CNT.SBIT_CNT_TIME_MAX",ohN), uint32_t(BX_PER_SECOND*waitTime/1000.) ); //count for a number of BX's specified by waitTime
+
+    //VFATs of a column are pulsed together, see SBIT_RATE_GROUP_VFATS
+    std::vector<uint32_t> groups;
+    for (uint32_t first = 0; first < 24; first += SBIT_RATE_GROUP_VFATS) {
+        uint32_t group = vfatsToPulse & (((0x1 << SBIT_RATE_GROUP_VFATS)-1) << first);
+        if (group)
+            groups.push_back(group);
     }
 
-    //mask all other vfats from trigger
-    LOGGER->log_message(LogManager::INFO, stdsprintf("Masking VFATs %x from trigger in ohN %i", 0xffffff & ~(1 << (vfatN)), ohN));
-    writeReg(la,stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CTRL.VFAT_MASK",ohN), 0xffffff & ~(1 << (vfatN)));
-
-    //Place this vfat into run mode
-    LOGGER->log_message(LogManager::INFO, stdsprintf("Placing vfatN %i on ohN %i in run mode", vfatN, ohN));
-    writeReg(la,stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_RUN",ohN, vfatN), 0x1);
-
-    LOGGER->log_message(LogManager::INFO, stdsprintf("Looping over all channels of vfatN %i on ohN %i", vfatN, ohN));
-    for (int chan=0; chan < 128; ++chan) { //Loop over all channels
-        //unmask this channel
-        LOGGER->log_message(LogManager::INFO, stdsprintf("Unmasking channel %i on vfat %i of OH %i", chan, vfatN, ohN));
-        writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.VFAT_CHANNELS.CHANNEL%i.MASK",ohN,vfatN,chan), 0x0);
-
-        //Turn on the calpulse for this channel
-        LOGGER->log_message(LogManager::INFO, stdsprintf("Enabling calpulse for channel %i on vfat %i of OH %i", chan, vfatN, ohN));
-        if (confCalPulseLocal(la, ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan, useCalPulse, currentPulse, calScaleFactor) == false) {
-            la->response->set_string("error",stdsprintf("Unable to configure calpulse %b for ohN %i mask %x chan %i", useCalPulse, ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan));
-            return; //Calibration pulse is not configured correctly
+    const uint32_t nRates = pulseRates.size();
+    for (uint32_t iGroup = 0; iGroup < groups.size() && !calJobCancelled(); ++iGroup) {
+        uint32_t group = groups[iGroup];
+        uint32_t groupMask = ~group & 0xFFFFFF;
+        uint32_t progressVFAT = (group & (group-1)) ? 0xffffffff : __builtin_ctz(group); //the vfat if it is alone in the group
+        calJobStage(iGroup, groups.size());
+
+        //mask all other vfats from trigger
+        LOGGER->log_message(LogManager::INFO, stdsprintf("Masking VFATs %x from trigger in ohN %i", groupMask, ohN));
+        writeReg(la,stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CTRL.VFAT_MASK",ohN), groupMask);
+
+        //Run mode and channel mask registers of the vfats in this group
+        std::vector<RegHandle> runRegs;
+        std::vector<std::vector<RegHandle> > chanMaskRegs;
+        for (int vfatN = 0; vfatN < 24; ++vfatN) if ((group >> vfatN) & 0x1) {
+            runRegs.push_back(resolve(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.CFG_RUN", ohN, vfatN));
+            chanMaskRegs.push_back(resolveFamily(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.VFAT_CHANNELS.CHANNEL{}.MASK", 128, ohN, vfatN));
         }
 
-        //Reset counters
-        LOGGER->log_message(LogManager::INFO, "Reseting trigger counters on OH & CTP7");
-        writeRawAddress(addTrgCntResetOH, 0x1, la->response);
-        writeRawAddress(addTrgCntResetCTP7, 0x1, la->response);
-        //also use daq monitor here...?
+        //Place these vfats into run mode
+        LOGGER->log_message(LogManager::INFO, stdsprintf("Placing vfats %x on ohN %i in run mode", group, ohN));
+        RegWriteBatch runMode(la);
+        for (auto const& reg : runRegs)
+            runMode.add(reg, 0x1);
+        runMode.commit();
+
+        LOGGER->log_message(LogManager::INFO, stdsprintf("Looping over all channels of vfats %x on ohN %i", group, ohN));
+        for (int chan=0; chan < 128 && !calJobCancelled(); ++chan) { //Loop over all channels
+            calJobProgress(chan, 128, ohN, progressVFAT, chan);
+
+            //unmask this channel
+            LOGGER->log_message(LogManager::INFO, stdsprintf("Unmasking channel %i on vfats %x of OH %i", chan, group, ohN));
+            RegWriteBatch chanMasks(la);
+            for (auto const& vfatMasks : chanMaskRegs)
+                chanMasks.add(vfatMasks[chan], 0x0);
+            chanMasks.commit();
+
+            //Turn on the calpulse for this channel
+            LOGGER->log_message(LogManager::INFO, stdsprintf("Enabling calpulse for channel %i on vfats %x of OH %i", chan, group, ohN));
+            if (confCalPulseLocal(la, ohN, groupMask, chan, useCalPulse, currentPulse, calScaleFactor) == false) {
+                la->response->set_string("error",stdsprintf("Unable to configure calpulse %b for ohN %i mask %x chan %i", useCalPulse, ohN, groupMask, chan));
+                return; //Calibration pulse is not configured correctly
+            }
 
-        //Start the TTC Generator
-        LOGGER->log_message(LogManager::INFO, stdsprintf("Configuring TTC Generator to use OH %i with pulse delay %i and L1Ainterval %i",ohN,pulseDelay,L1Ainterval));
-        ttcGenConfLocal(la, ohN, 0, 0, pulseDelay, L1Ainterval, 0, true);
-        writeReg(la, "GEM_AMC.TTC.GENERATOR.SINGLE_RESYNC", 0x1);
-        writeReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_L1A_COUNT", 0x0); //Continue until stopped
-        LOGGER->log_message(LogManager::INFO, "Starting TTC Generator");
-        writeRawAddress(addrTtcStart, 0x1, la->response);
-
-        //Sleep for waitTime of milliseconds
-        std::this_thread::sleep_for(std::chrono::milliseconds(waitTime));
-
-        //Read All Trigger Registers
-        LOGGER->log_message(LogManager::INFO, "Reading trigger counters");
-        outDataCTP7Rate[chan]=readRawAddress(ohTrigRateAddr[25], la->response);
-        outDataFPGAClusterCntRate[chan]=readRawAddress(ohTrigRateAddr[24], la->response)*waitTime/1000.;
-        outDataVFATSBits[chan]=readRawAddress(ohTrigRateAddr[vfatN], la->response)*waitTime/1000.;
-
-        //Reset the TTC Generator
-        LOGGER->log_message(LogManager::INFO, "Stopping TTC Generator");
-        writeRawAddress(addrTtcReset, 0x1, la->response);
-
-        //Turn off the calpulse for this channel
-        LOGGER->log_message(LogManager::INFO, stdsprintf("Disabling calpulse for channel %i on vfat %i of OH %i", chan, vfatN, ohN));
-        if (confCalPulseLocal(la, ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan, false, currentPulse, calScaleFactor) == false) {
-            la->response->set_string("error",stdsprintf("Unable to configure calpulse OFF for ohN %i mask %x chan %i", ohN, ~((0x1)<<vfatN) & 0xFFFFFF, chan));
-            return; //Calibration pulse is not configured correctly
-        }
+            for (uint32_t iRate = 0; iRate < nRates; ++iRate) {
+                uint32_t L1Ainterval;
+                if (pulseRates[iRate] > 0) {
+                    L1Ainterval = int(BX_PER_SECOND / pulseRates[iRate]);
+                }
+                else{
+                    L1Ainterval = 0;
+                }
+
+                //Reset counters
+                LOGGER->log_message(LogManager::INFO, "Reseting trigger counters on OH & CTP7");
+                writeRawAddress(addTrgCntResetOH, 0x1, la->response);
+                writeRawAddress(addTrgCntResetCTP7, 0x1, la->response);
+
+                //Start the TTC Generator
+                LOGGER->log_message(LogManager::INFO, stdsprintf("Configuring TTC Generator to use OH %i with pulse delay %i and L1Ainterval %i",ohN,pulseDelay,L1Ainterval));
+                ttcGenConfLocal(la, ohN, 0, 0, pulseDelay, L1Ainterval, 0, true);
+                writeReg(la, "GEM_AMC.TTC.GENERATOR.SINGLE_RESYNC", 0x1);
+                writeReg(la, "GEM_AMC.TTC.GENERATOR.CYCLIC_L1A_COUNT", 0x0); //Continue until stopped
+                LOGGER->log_message(LogManager::INFO, "Starting TTC Generator");
+                writeRawAddress(addrTtcStart, 0x1, la->response);
+
+                //Sleep for waitTime of milliseconds
+                std::this_thread::sleep_for(std::chrono::milliseconds(waitTime));
 
-        //mask this channel
-        LOGGER->log_message(LogManager::INFO, stdsprintf("Masking channel %i on vfat %i of OH %i", chan, vfatN, ohN));
-        writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.VFAT_CHANNELS.CHANNEL%i.MASK",ohN,vfatN,chan), 0x1);
-    } //End Loop over all channels
+                //Read All Trigger Registers, CTP7 and OH cluster rates are shared by the vfats of the group
+                LOGGER->log_message(LogManager::INFO, "Reading trigger counters");
+                readRegs(la, trigRateRegs, trigRates);
+                for (int vfatN = 0; vfatN < 24; ++vfatN) if ((group >> vfatN) & 0x1) {
+                    uint32_t idx = 3072*iRate + 128*vfatN + chan;
+                    outDataCTP7Rate[idx]=trigRates[25];
+                    outDataFPGAClusterCntRate[idx]=trigRates[24]*waitTime/1000.;
+                    outDataVFATSBits[idx]=trigRates[vfatN]*waitTime/1000.;
+                }
+
+                //Reset the TTC Generator
+                LOGGER->log_message(LogManager::INFO, "Stopping TTC Generator");
+                writeRawAddress(addrTtcReset, 0x1, la->response);
+            } //End Loop over pulse rates
+
+            //Turn off the calpulse for this channel
+            LOGGER->log_message(LogManager::INFO, stdsprintf("Disabling calpulse for channel %i on vfats %x of OH %i", chan, group, ohN));
+            if (confCalPulseLocal(la, ohN, groupMask, chan, false, currentPulse, calScaleFactor) == false) {
+                la->response->set_string("error",stdsprintf("Unable to configure calpulse OFF for ohN %i mask %x chan %i", ohN, groupMask, chan));
+                return; //Calibration pulse is not configured correctly
+            }
 
-    //Place this vfat out of run mode
-    LOGGER->log_message(LogManager::INFO, stdsprintf("Finished looping over all channels.  Taking vfatN %i on ohN %i out of run mode", vfatN, ohN));
-    writeReg(la,stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.CFG_RUN",ohN, vfatN), 0x0);
+            //mask this channel
+            LOGGER->log_message(LogManager::INFO, stdsprintf("Masking channel %i on vfats %x of OH %i", chan, group, ohN));
+            for (auto const& vfatMasks : chanMaskRegs)
+                chanMasks.add(vfatMasks[chan], 0x1);
+            chanMasks.commit();
+        } //End Loop over all channels
+
+        //Place these vfats out of run mode
+        LOGGER->log_message(LogManager::INFO, stdsprintf("Finished looping over all channels.  Taking vfats %x on ohN %i out of run mode", group, ohN));
+        for (auto const& reg : runRegs)
+            runMode.add(reg, 0x0);
+        runMode.commit();
+    } //End Loop over groups of vfats
 
     //turn off TTC Generator
     LOGGER->log_message(LogManager::INFO, "Disabling TTC Generator");
     ttcGenToggleLocal(la, ohN, false);
 
     //Return channel register settings to their original values
-    LOGGER->log_message(LogManager::INFO, stdsprintf("Reverting vfat3 channel registers on ohN %i to original values",ohN));
-    setChannelRegistersVFAT3SimpleLocal(la, ohN, mask, chanRegData_orig);
-
-    //Set trigger vfat mask for this OH back to 0
-    LOGGER->log_message(LogManager::INFO, stdsprintf("Reverting GEM_AMC.OH.OH%i.FPGA.TRIG.CTRL.VFAT_MASK to 0x0", ohN));
-    writeReg(la, stdsprintf("GEM_AMC.OH.OH%i.FPGA.TRIG.CTRL.VFAT_MASK",ohN), 0x0);
+    LOGGER->log_message(LogManager::INFO, stdsprintf("Reverting vfat3 channel registers and GEM_AMC.OH.OH%i.FPGA.TRIG.CTRL.VFAT_MASK to original values",ohN));
+    origRegs.restore();
 
     return;
+} //End checkSbitRateVFATsLocal()
+
+void checkSbitRateWithCalPulseLocal(localArgs *la, uint32_t *outDataCTP7Rate, uint32_t *outDataFPGAClusterCntRate, uint32_t *outDataVFATSBits, uint32_t ohN, uint32_t vfatN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t waitTime, uint32_t pulseRate, uint32_t pulseDelay)
+{
+    if (vfatN > 23) {
+        la->response->set_string("error",stdsprintf("Bad vfatN %i, possible values are [0,23]",vfatN));
+        return;
+    }
+
+    std::vector<uint32_t> ctp7Rate(3072), clusterCntRate(3072), vfatSBits(3072);
+    checkSbitRateVFATsLocal(la, ctp7Rate.data(), clusterCntRate.data(), vfatSBits.data(), ohN, 0x1 << vfatN, mask, useCalPulse, currentPulse, calScaleFactor, waitTime, {pulseRate}, pulseDelay);
+
+    std::copy_n(ctp7Rate.begin()+128*vfatN, 128, outDataCTP7Rate);
+    std::copy_n(clusterCntRate.begin()+128*vfatN, 128, outDataFPGAClusterCntRate);
+    std::copy_n(vfatSBits.begin()+128*vfatN, 128, outDataVFATSBits);
 } //End checkSbitRateWithCalPulseLocal()
 
 void checkSbitRateWithCalPulse(const RPCMsg *request, RPCMsg *response)
@@ -1083,15 +1673,35 @@ void checkSbitRateWithCalPulse(const RPCMsg *request, RPCMsg *response)
     GETLOCALARGS(response);
 
     uint32_t ohN = request->get_word("ohN");
-    uint32_t vfatN = request->get_word("vfatN");
     uint32_t mask = request->get_word("mask");
     bool useCalPulse = request->get_word("useCalPulse");
     bool currentPulse = request->get_word("currentPulse");
     uint32_t calScaleFactor = request->get_word("calScaleFactor");
     uint32_t waitTime = request->get_word("waitTime");
-    uint32_t pulseRate = request->get_word("pulseRate");
     uint32_t pulseDelay = request->get_word("pulseDelay");
 
+    if (request->get_key_exists("vfatsToPulse") || request->get_key_exists("pulseRates")) {
+        uint32_t vfatsToPulse = request->get_key_exists("vfatsToPulse") ? request->get_word("vfatsToPulse") : 0x1 << request->get_word("vfatN");
+        std::vector<uint32_t> pulseRates = request->get_key_exists("pulseRates") ? request->get_word_array("pulseRates") : std::vector<uint32_t>(1, request->get_word("pulseRate"));
+
+        std::vector<uint32_t> outDataCTP7Rate(3072*pulseRates.size());
+        std::vector<uint32_t> outDataFPGAClusterCntRate(3072*pulseRates.size());
+        std::vector<uint32_t> outDataVFATSBits(3072*pulseRates.size());
+        checkSbitRateVFATsLocal(&la, outDataCTP7Rate.data(), outDataFPGAClusterCntRate.data(), outDataVFATSBits.data(), ohN, vfatsToPulse, mask, useCalPulse, currentPulse, calScaleFactor, waitTime, pulseRates, pulseDelay);
+
+        std::shared_ptr<ResultJob> job = resultJobFor(request);
+        setResultArray(response, job.get(), "outDataCTP7Rate", outDataCTP7Rate.data(), outDataCTP7Rate.size());
+        setResultArray(response, job.get(), "outDataFPGAClusterCntRate", outDataFPGAClusterCntRate.data(), outDataFPGAClusterCntRate.size());
+        setResultArray(response, job.get(), "outDataVFATSBits", outDataVFATSBits.data(), outDataVFATSBits.size());
+        if (job)
+            publishResultJob(response, job);
+        rtxn.abort();
+        return;
+    }
+
+    uint32_t vfatN = request->get_word("vfatN");
+    uint32_t pulseRate = request->get_word("pulseRate");
+
     uint32_t outDataCTP7Rate[128];
     uint32_t outDataFPGAClusterCntRate[128];
     uint32_t outDataVFATSBits[128];
@@ -1104,80 +1714,43 @@ void checkSbitRateWithCalPulse(const RPCMsg *request, RPCMsg *response)
     rtxn.abort();
 } //End checkSbitRateWithCalPulse()
 
-std::vector<uint32_t> dacScanLocal(localArgs *la, uint32_t ohN, uint32_t dacSelect, uint32_t dacStep, uint32_t mask, bool useExtRefADC)
+bool dacScanPrepareLocal(localArgs *la, DacScanLink & link, uint32_t ohN, uint32_t mask, uint32_t dacSelect, bool useExtRefADC)
 {
-    //Ensure VFAT3 Hardware
-    if (fw_version_check("dacScanLocal", la) < 3) {
-        LOGGER->log_message(LogManager::ERROR, "dacScanLocal is only supported in V3 electronics");
-        la->response->set_string("error","dacScanLocal is only supported in V3 electronics");
-        std::vector<uint32_t> emptyVec;
-        return emptyVec;
-    }
-
     vfat3DACAndSize dacInfo;
-    auto map_dacSelect = dacInfo.map_dacInfo;
+    std::string regName = std::get<0>(dacInfo.map_dacInfo[dacSelect]);
 
-    // Check if dacSelect is valid
-    if (map_dacSelect.count(dacSelect) == 0) { //Case: dacSelect not found, exit
-        std::string errMsg = "Monitoring Select value " + std::to_string(dacSelect) + " not found, possible values are:\n";
-
-        for (auto iterDacSel = map_dacSelect.begin(); iterDacSel != map_dacSelect.end(); ++iterDacSel) {
-            errMsg+="\t" + std::to_string((*iterDacSel).first) + "\t" + std::get<0>((*iterDacSel).second) + "\n";
-        }
-        la->response->set_string("error",errMsg);
-        std::vector<uint32_t> emptyVec;
-        return emptyVec;
-    } //End Case: dacSelect not found, exit
+    link.ohN = ohN;
+    link.notmask = ~mask & 0xFFFFFF; //Inverse of the vfatmask
 
     //Check which VFATs are sync'd
-    uint32_t notmask = ~mask & 0xFFFFFF; //Inverse of the vfatmask
     uint32_t goodVFATs = vfatSyncCheckLocal(la, ohN);
-    if ( (notmask & goodVFATs) != notmask) {
-        la->response->set_string("error",stdsprintf("One of the unmasked VFATs is not Synced. goodVFATs: %x\tnotmask: %x",goodVFATs,notmask));
-        std::vector<uint32_t> emptyVec;
-        return emptyVec;
+    if ( (link.notmask & goodVFATs) != link.notmask) {
+        la->response->set_string("error",stdsprintf("One of the unmasked VFATs is not Synced. goodVFATs: %x\tnotmask: %x",goodVFATs,link.notmask));
+        return false;
     }
 
-    //Determine the addresses
-    std::string regName = std::get<0>(map_dacSelect[dacSelect]);
-    LOGGER->log_message(LogManager::INFO, stdsprintf("Scanning DAC: %s",regName.c_str()));
-    uint32_t adcAddr[24];
-    uint32_t adcCacheUpdateAddr[24];
-    bool foundAdcCached = false;
+    //Determine the registers
+    std::string adcName = useExtRefADC ? "ADC1" : "ADC0";
+    link.dacReg.assign(24, RegHandle());
+    link.adc.assign(24, RegHandle());
+    link.adcUpdate.assign(24, RegHandle());
     for (int vfatN=0; vfatN<24; ++vfatN) {
         //Skip Masked VFATs
-        if ( !( (notmask >> vfatN) & 0x1)) continue;
+        if ( !( (link.notmask >> vfatN) & 0x1)) continue;
 
         //Determine Register Base string
         std::string strRegBase = stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.",ohN,vfatN);
 
-        //Get ADC address
-        if (useExtRefADC) { //Case: Use ADC with external reference
-            //for backward compatibility, use ADC1 instead of ADC1_CACHED if it exists
-            if ((foundAdcCached = la->dbi.get(la->rtxn, strRegBase + "ADC1_CACHED"))) {
-                adcAddr[vfatN] = getAddress(la, strRegBase + "ADC1_CACHED");
-                adcCacheUpdateAddr[vfatN] = getAddress(la, strRegBase + "ADC1_UPDATE");
-            }
-            else
-                adcAddr[vfatN] = getAddress(la, strRegBase + "ADC1");
-        } //End Case: Use ADC with external reference
-        else{ //Case: Use ADC with internal reference
-            //for backward compatibility, use ADC0 instead of ADC0_CACHED if it exists
-            if ((foundAdcCached = la->dbi.get(la->rtxn, strRegBase + "ADC0_CACHED"))) {
-                adcAddr[vfatN] = getAddress(la, strRegBase + "ADC0_CACHED");
-                adcCacheUpdateAddr[vfatN] = getAddress(la, strRegBase + "ADC0_UPDATE");
-            }
-            else
-                adcAddr[vfatN] = getAddress(la, strRegBase + "ADC0");
-        } //End Case: Use ADC with internal reference
+        link.dacReg[vfatN] = resolveReg(la, strRegBase + regName);
+        //for backward compatibility, use ADCx instead of ADCx_CACHED if it does not exist
+        if (la->dbi.get(la->rtxn, strRegBase + adcName + "_CACHED")) {
+            link.adc[vfatN] = resolveReg(la, strRegBase + adcName + "_CACHED");
+            link.adcUpdate[vfatN] = resolveReg(la, strRegBase + adcName + "_UPDATE");
+        }
+        else
+            link.adc[vfatN] = resolveReg(la, strRegBase + adcName);
     } //End Loop over VFATs
 
-    //make the output container and correctly size it
-    uint32_t dacMax = std::get<2>(map_dacSelect[dacSelect]);
-    uint32_t dacMin = std::get<1>(map_dacSelect[dacSelect]);
-    int nDacValues = (dacMax-dacMin+1)/dacStep;
-    std::vector<uint32_t> vec_dacScanData(24*nDacValues); //Each element has bits [0:7] as the current dacValue, and bits [8:17] as the ADC read back value
-
     //Configure the DAC Monitoring on all the VFATs
     configureVFAT3DacMonitorLocal(la, ohN, mask, dacSelect);
 
@@ -1186,52 +1759,148 @@ std::vector<uint32_t> dacScanLocal(localArgs *la, uint32_t ohN, uint32_t dacSele
 
     //Set the VFATs into Run Mode
     broadcastWriteLocal(la, ohN, "CFG_RUN", 0x1, mask);
-    LOGGER->log_message(LogManager::INFO, stdsprintf("VFATs not in 0x%x were set to run mode", mask));
-    std::this_thread::sleep_for(std::chrono::seconds(1)); //I noticed that DAC values behave weirdly immediately after VFAT is placed in run mode (probably voltage/current takes a moment to stabalize)
+    LOGGER->log_message(LogManager::INFO, stdsprintf("VFATs of OH%i not in 0x%x were set to run mode", ohN, mask));
+    return true;
+} //End dacScanPrepareLocal(...)
 
-    //Scan the DAC
+void dacScanLoopLocal(localArgs *la, std::vector<DacScanLink> & links, uint32_t dacSelect, uint32_t dacStep, uint32_t nReads, bool parallel)
+{
+    vfat3DACAndSize dacInfo;
+    uint32_t dacMax = std::get<2>(dacInfo.map_dacInfo[dacSelect]);
+    uint32_t dacMin = std::get<1>(dacInfo.map_dacInfo[dacSelect]);
+    int nDacValues = (dacMax-dacMin)/dacStep+1; //dacMin, dacMin+dacStep, ... up to dacMax, also when dacStep does not divide the range
+
+    //Each element has bits [0:7] as the current dacValue, and bits [8:17] as the ADC read back value, 0 until measured
+    for (auto & link : links) {
+        link.data.resize(24*nDacValues);
+        link.rms.assign(24*nDacValues, 0xdeaddead);
+        for (int vfatN=0; vfatN<24; ++vfatN) {
+            for (uint32_t dacVal=dacMin; dacVal<=dacMax; dacVal += dacStep) {
+                int idx = vfatN*nDacValues+(dacVal-dacMin)/dacStep;
+                link.data[idx] = ((link.ohN & 0xf) << 23) + ((vfatN & 0x1f) << 18) + (dacVal & 0xff);
+            }
+        }
+    }
+
+    //VFATs sampled together: all of them in parallel mode, otherwise one VFAT position at a time on all links
+    struct SampleGroup {
+        std::vector<DacScanLink*> link;
+        std::vector<int> vfatN;
+        std::vector<RegHandle> dacReg, adc, adcUpdate;
+    };
+    std::vector<SampleGroup> groups(parallel ? 1 : 24);
+    for (int vfatN=0; vfatN<24; ++vfatN) {
+        SampleGroup & group = groups[parallel ? 0 : vfatN];
+        for (auto & link : links) {
+            if ( !( (link.notmask >> vfatN) & 0x1)) continue;
+            group.link.push_back(&link);
+            group.vfatN.push_back(vfatN);
+            group.dacReg.push_back(link.dacReg[vfatN]);
+            group.adc.push_back(link.adc[vfatN]);
+            if (link.adcUpdate[vfatN].valid)
+                group.adcUpdate.push_back(link.adcUpdate[vfatN]);
+        }
+    }
+
+    std::vector<uint32_t> samples(24*links.size()), nGood(24*links.size());
+    std::vector<uint64_t> adcSum(24*links.size()), adcSumSq(24*links.size());
+    uint32_t progressOH = links.size() == 1 ? links[0].ohN : 0xffffffff;
+    for (uint32_t dacVal=dacMin; dacVal<=dacMax && !calJobCancelled(); dacVal += dacStep) { //Loop over DAC values
+        calJobProgress((dacVal-dacMin)/dacStep, nDacValues, progressOH, 0xffffffff, dacVal);
+        for (auto const& group : groups) {
+            if (group.adc.empty()) continue;
 
-    uint32_t nReads=100;
-    for (uint32_t dacVal=dacMin; dacVal<=dacMax; dacVal += dacStep) { //Loop over DAC values
-        for (int vfatN=0; vfatN<24; ++vfatN) { //Loop over VFATs
-            //Skip masked VFATs
-            if ( !( (notmask >> vfatN) & 0x1)) { //Case: VFAT is masked, skip
-                //Store word, but with adcVal = 0
-                int idx = vfatN*(dacMax-dacMin+1)/dacStep+(dacVal-dacMin)/dacStep;
-                vec_dacScanData[idx] = ((ohN & 0xf) << 23) + ((vfatN & 0x1f) << 18) + (dacVal & 0xff);
-
-                //skip
-                continue;
-            } //End Case: VFAT is masked, skip
-            else{ //Case: VFAT is not masked
             //Set DAC value
-                std::string strDacReg = stdsprintf("GEM_AMC.OH.OH%i.GEB.VFAT%i.",ohN,vfatN) + regName;
-                writeReg(la, strDacReg, dacVal);
-                //Read nReads times and take avg value
-                uint32_t adcVal=0;
-                for (uint32_t i=0; i<nReads; ++i) {
-                    //Read the ADC
-                    if (foundAdcCached) {
-                        //either reading or writing this register will trigger a cache update
-                        readRawAddress(adcCacheUpdateAddr[vfatN], la->response);
-                        //updating the cache takes 20 us, including a 50% safety factor
-                        std::this_thread::sleep_for(std::chrono::microseconds(20));
-                    }
-                    adcVal += readRawAddress(adcAddr[vfatN], la->response);
+            RegWriteBatch dacWrites(la);
+            for (auto const& dacReg : group.dacReg)
+                dacWrites.add(dacReg, dacVal);
+            dacWrites.commit();
+
+            //Read nReads times and take avg value
+            std::fill(nGood.begin(), nGood.end(), 0);
+            std::fill(adcSum.begin(), adcSum.end(), 0);
+            std::fill(adcSumSq.begin(), adcSumSq.end(), 0);
+            for (uint32_t i=0; i<nReads; ++i) {
+                if (!group.adcUpdate.empty()) {
+                    //either reading or writing these registers will trigger a cache update, on all VFATs at once
+                    readRegs(la, group.adcUpdate, samples.data());
+                    std::this_thread::sleep_for(std::chrono::microseconds(DAC_SCAN_ADC_UPDATE_US));
+                }
+                readRegs(la, group.adc, samples.data());
+                for (size_t iVfat=0; iVfat<group.adc.size(); ++iVfat) {
+                    if (samples[iVfat] == 0xdeaddead) continue;
+                    ++nGood[iVfat];
+                    adcSum[iVfat]   += samples[iVfat];
+                    adcSumSq[iVfat] += uint64_t(samples[iVfat])*samples[iVfat];
                 }
-                adcVal = adcVal/nReads;
-                //Store value
-                int idx = vfatN*(dacMax-dacMin+1)/dacStep+(dacVal-dacMin)/dacStep;
-                vec_dacScanData[idx] = ((ohN & 0xf) << 23) + ((vfatN & 0x1f) << 18) + ((adcVal & 0x3ff) << 8) + (dacVal & 0xff);
-            } //End Case: VFAT is not masked
-        } //End Loop over VFATs
+            }
+
+            //Store value
+            for (size_t iVfat=0; iVfat<group.adc.size(); ++iVfat) {
+                if (nGood[iVfat] == 0) continue;
+                int vfatN = group.vfatN[iVfat];
+                int idx = vfatN*nDacValues+(dacVal-dacMin)/dacStep;
+                uint32_t adcVal = adcSum[iVfat]/nGood[iVfat];
+                double mean = static_cast<double>(adcSum[iVfat])/nGood[iVfat];
+                double var  = static_cast<double>(adcSumSq[iVfat])/nGood[iVfat] - mean*mean;
+                group.link[iVfat]->data[idx] = ((group.link[iVfat]->ohN & 0xf) << 23) + ((vfatN & 0x1f) << 18) + ((adcVal & 0x3ff) << 8) + (dacVal & 0xff);
+                group.link[iVfat]->rms[idx]  = static_cast<uint32_t>(lround(DAC_SCAN_RMS_SCALE*sqrt(var > 0. ? var : 0.)));
+            }
+        } //End Loop over sample groups
     } //End Loop over DAC values
+} //End dacScanLoopLocal(...)
 
+bool dacScanCheckArgsLocal(localArgs *la, uint32_t dacSelect, uint32_t dacStep, uint32_t nReads)
+{
+    //Ensure VFAT3 Hardware
+    if (fw_version_check("dacScanLocal", la) < 3) {
+        LOGGER->log_message(LogManager::ERROR, "dacScanLocal is only supported in V3 electronics");
+        la->response->set_string("error","dacScanLocal is only supported in V3 electronics");
+        return false;
+    }
+
+    if (nReads == 0 || dacStep == 0) {
+        la->response->set_string("error","dacScanLocal needs a non zero dacStep and at least one ADC read per point");
+        return false;
+    }
+
+    vfat3DACAndSize dacInfo;
+    auto map_dacSelect = dacInfo.map_dacInfo;
+
+    // Check if dacSelect is valid
+    if (map_dacSelect.count(dacSelect) == 0) { //Case: dacSelect not found, exit
+        std::string errMsg = "Monitoring Select value " + std::to_string(dacSelect) + " not found, possible values are:\n";
+
+        for (auto iterDacSel = map_dacSelect.begin(); iterDacSel != map_dacSelect.end(); ++iterDacSel) {
+            errMsg+="\t" + std::to_string((*iterDacSel).first) + "\t" + std::get<0>((*iterDacSel).second) + "\n";
+        }
+        la->response->set_string("error",errMsg);
+        return false;
+    } //End Case: dacSelect not found, exit
+    return true;
+} //End dacScanCheckArgsLocal(...)
+
+std::vector<uint32_t> dacScanLocal(localArgs *la, uint32_t ohN, uint32_t dacSelect, uint32_t dacStep, uint32_t mask, bool useExtRefADC, uint32_t nReads, bool parallel, std::vector<uint32_t> *adcRms)
+{
+    std::vector<DacScanLink> links(1);
+    if (!dacScanCheckArgsLocal(la, dacSelect, dacStep, nReads) || !dacScanPrepareLocal(la, links[0], ohN, mask, dacSelect, useExtRefADC)) {
+        std::vector<uint32_t> emptyVec;
+        return emptyVec;
+    }
+
+    vfat3DACAndSize dacInfo;
+    LOGGER->log_message(LogManager::INFO, stdsprintf("Scanning DAC: %s",std::get<0>(dacInfo.map_dacInfo[dacSelect]).c_str()));
+    std::this_thread::sleep_for(std::chrono::seconds(DAC_SCAN_SETTLE_S)); //I noticed that DAC values behave weirdly immediately after VFAT is placed in run mode (probably voltage/current takes a moment to stabalize)
+
+    //Scan the DAC
+    dacScanLoopLocal(la, links, dacSelect, dacStep, nReads, parallel);
 
     //Take the VFATs out of Run Mode
     broadcastWriteLocal(la, ohN, "CFG_RUN", 0x0, mask);
 
-    return vec_dacScanData;
+    if (adcRms)
+        adcRms->swap(links[0].rms);
+    return links[0].data;
 } //End dacScanLocal(...)
 
 void dacScan(const RPCMsg *request, RPCMsg *response)
@@ -1243,13 +1912,74 @@ void dacScan(const RPCMsg *request, RPCMsg *response)
     uint32_t dacStep = request->get_word("dacStep");
     uint32_t mask = request->get_word("mask");
     bool useExtRefADC = request->get_word("useExtRefADC");
+    uint32_t nReads = request->get_key_exists("nReads") ? request->get_word("nReads") : 100;
+    bool parallel = request->get_key_exists("parallel") && request->get_word("parallel");
 
-    std::vector<uint32_t> dacScanResults = dacScanLocal(&la, ohN, dacSelect, dacStep, mask, useExtRefADC);
+    std::vector<uint32_t> dacScanRms;
+    std::vector<uint32_t> dacScanResults = dacScanLocal(&la, ohN, dacSelect, dacStep, mask, useExtRefADC, nReads, parallel, &dacScanRms);
     response->set_word_array("dacScanResults",dacScanResults);
+    response->set_word_array("dacScanRms",dacScanRms);
 
     rtxn.abort();
 } //End dacScan(...)
 
+void dacScanMultiLinkLocal(localArgs *la, std::vector<uint32_t> & dacScanResultsAll, std::vector<uint32_t> & dacScanRmsAll, uint32_t ohMask, uint32_t NOH, uint32_t dacSelect, uint32_t dacStep, bool useExtRefADC, uint32_t nReads, bool parallel)
+{
+    if (!dacScanCheckArgsLocal(la, dacSelect, dacStep, nReads))
+        return;
+
+    vfat3DACAndSize dacInfo;
+    uint32_t dacMax = std::get<2>(dacInfo.map_dacInfo[dacSelect]);
+    uint32_t dacMin = std::get<1>(dacInfo.map_dacInfo[dacSelect]);
+    uint32_t nPoints = 24*((dacMax-dacMin)/dacStep+1);
+
+    //Configure all the links, then let them settle once
+    std::vector<DacScanLink> links;
+    std::vector<uint32_t> linkMasks;
+    for (unsigned int ohN=0; ohN<NOH; ++ohN) {
+        // If this Optohybrid is masked skip it
+        if (!((ohMask >> ohN) & 0x1))
+            continue;
+
+        //Get vfatmask for this OH
+        LOGGER->log_message(LogManager::INFO, stdsprintf("Getting VFAT Mask for OH%i", ohN));
+        uint32_t vfatMask = getOHVFATMaskLocal(la, ohN);
+
+        DacScanLink link;
+        if (!dacScanPrepareLocal(la, link, ohN, vfatMask, dacSelect, useExtRefADC)) {
+            LOGGER->log_message(LogManager::WARNING, stdsprintf("Skipping DAC scan for OH%i", ohN));
+            continue;
+        }
+        links.push_back(link);
+        linkMasks.push_back(vfatMask);
+    } //End Loop over all Optohybrids
+
+    if (!links.empty()) {
+        LOGGER->log_message(LogManager::INFO, stdsprintf("Performing DAC Scan of %s for %zu OH(s)", std::get<0>(dacInfo.map_dacInfo[dacSelect]).c_str(), links.size()));
+        std::this_thread::sleep_for(std::chrono::seconds(DAC_SCAN_SETTLE_S)); //DAC values need a moment to stabalize after the VFATs are placed in run mode
+
+        //Scan the DAC on all links together
+        dacScanLoopLocal(la, links, dacSelect, dacStep, nReads, parallel);
+
+        //Take the VFATs out of Run Mode
+        for (size_t iLink=0; iLink<links.size(); ++iLink)
+            broadcastWriteLocal(la, links[iLink].ohN, "CFG_RUN", 0x0, linkMasks[iLink]);
+    }
+
+    //Copy the results into the final container, 0xdeaddead for the links that were not scanned
+    auto link = links.begin();
+    for (unsigned int ohN=0; ohN<NOH; ++ohN) {
+        if (link != links.end() && link->ohN == ohN) {
+            std::copy(link->data.begin(), link->data.end(), std::back_inserter(dacScanResultsAll));
+            std::copy(link->rms.begin(), link->rms.end(), std::back_inserter(dacScanRmsAll));
+            ++link;
+        } else {
+            dacScanResultsAll.insert(dacScanResultsAll.end(), nPoints, 0xdeaddead);
+            dacScanRmsAll.insert(dacScanRmsAll.end(), nPoints, 0xdeaddead);
+        }
+    }
+} //End dacScanMultiLinkLocal(...)
+
 void dacScanMultiLink(const RPCMsg *request, RPCMsg *response)
 {
     GETLOCALARGS(response);
@@ -1258,6 +1988,8 @@ void dacScanMultiLink(const RPCMsg *request, RPCMsg *response)
     uint32_t dacSelect = request->get_word("dacSelect");
     uint32_t dacStep = request->get_word("dacStep");
     bool useExtRefADC = request->get_word("useExtRefADC");
+    uint32_t nReads = request->get_key_exists("nReads") ? request->get_word("nReads") : 100;
+    bool parallel = request->get_key_exists("parallel") && request->get_word("parallel");
 
     unsigned int NOH = readReg(&la, "GEM_AMC.GEM_SYSTEM.CONFIG.NUM_OF_OH");
     if (request->get_key_exists("NOH")) {
@@ -1268,39 +2000,79 @@ void dacScanMultiLink(const RPCMsg *request, RPCMsg *response)
             LOGGER->log_message(LogManager::WARNING, stdsprintf("NOH requested (%i) > NUM_OF_OH AMC register value (%i), NOH request will be disregarded",NOH_requested,NOH));
     }
 
-    vfat3DACAndSize dacInfo;
-    std::vector<uint32_t> dacScanResultsAll;
-    for (unsigned int ohN=0; ohN<NOH; ++ohN) {
-        std::vector<uint32_t> dacScanResults;
+    std::shared_ptr<ResultJob> job = resultJobFor(request);
+    std::vector<uint32_t> dacScanResultsAll, dacScanRmsAll;
+    dacScanMultiLinkLocal(&la, dacScanResultsAll, dacScanRmsAll, ohMask, NOH, dacSelect, dacStep, useExtRefADC, nReads, parallel);
 
-        // If this Optohybrid is masked skip it
-        if (!((ohMask >> ohN) & 0x1)) {
-            int dacMax = std::get<2>(dacInfo.map_dacInfo[dacSelect]);
-            dacScanResults.assign( (dacMax+1)*24/dacStep, 0xdeaddead );
-            std::copy(dacScanResults.begin(), dacScanResults.end(), std::back_inserter(dacScanResultsAll));
-            continue;
-        }
+    setResultArray(response, job.get(), "dacScanResultsAll", dacScanResultsAll.data(), dacScanResultsAll.size());
+    setResultArray(response, job.get(), "dacScanRmsAll", dacScanRmsAll.data(), dacScanRmsAll.size());
+    if (job)
+        publishResultJob(response, job);
+    LOGGER->log_message(LogManager::INFO, stdsprintf("Finished DAC scans for OH Mask 0x%x", ohMask));
 
-        //Get vfatmask for this OH
-        LOGGER->log_message(LogManager::INFO, stdsprintf("Getting VFAT Mask for OH%i", ohN));
-        uint32_t vfatMask = getOHVFATMaskLocal(&la, ohN);
+    rtxn.abort();
+} //End dacScanMultiLink(...)
 
-        //Get dac scan results for this optohybrid
-        LOGGER->log_message(LogManager::INFO, stdsprintf("Performing DAC Scan for OH%i", ohN));
-        dacScanResults = dacScanLocal(&la, ohN, dacSelect, dacStep, vfatMask, useExtRefADC);
+void genChannelScanLocal(localArgs *la, uint32_t *outData, uint32_t ohN, uint32_t mask, bool useCalPulse, bool currentPulse, uint32_t calScaleFactor, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, std::string scanReg, bool useUltra, bool useExtTrig, uint32_t minTrigRate)
+{
+    const uint32_t nPoints = 24*(dacMax-dacMin+1)/dacStep;
 
-        //Copy the results into the final container
-        LOGGER->log_message(LogManager::INFO, stdsprintf("Storing results of DAC scan for OH%i", ohN));
-        std::copy(dacScanResults.begin(), dacScanResults.end(), std::back_inserter(dacScanResultsAll));
+    if (fw_version_check("genChannelScanLocal", la) != 3) {
+        //v2b electronics: the scan module is configured for each channel
+        for (uint32_t ch = 0; ch < 128 && !calJobCancelled(); ch++) {
+            calJobStage(ch, 128);
+            genScanLocal(la, &(outData[ch*nPoints]), ohN, mask, ch, useCalPulse, currentPulse, calScaleFactor, nevts, dacMin, dacMax, dacStep, scanReg, useUltra, useExtTrig, nullptr, minTrigRate);
+        }
+        return;
+    }
 
-        LOGGER->log_message(LogManager::INFO, stdsprintf("Finished DAC scan for OH%i", ohN));
-    } //End Loop over all Optohybrids
+    //Determine the inverse of the vfatmask
+    uint32_t notmask = ~mask & 0xFFFFFF;
 
-    response->set_word_array("dacScanResultsAll",dacScanResultsAll);
-    LOGGER->log_message(LogManager::INFO, stdsprintf("Finished DAC scans for OH Mask 0x%x", ohMask));
+    //Sync check, calpulse, TTC and VFAT_DAQ_MONITOR are set up for the first channel,
+    //the calpulse mode is configured once and only CALPULSE_ENABLE follows the scanned channel
+    uint32_t pulsedCh = 0;
+    GenScanRegs scanRegs;
+    if (!genScanPrepareLocal(la, scanRegs, ohN, mask, pulsedCh, useCalPulse, currentPulse, calScaleFactor, nevts, scanReg, useExtTrig))
+        return; //Error already reported
+
+    //Get register handles used in the channel loop
+    RegHandle daqMonChanSelect = resolveReg(la, "GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.CTRL.VFAT_CHANNEL_SELECT");
+    std::vector<std::vector<RegHandle> > calPulseEnable(24);
+    if (useCalPulse) {
+        for (int vfatN = 0; vfatN < 24; vfatN++) if ((notmask >> vfatN) & 0x1)
+            calPulseEnable[vfatN] = resolveFamily(la, "GEM_AMC.OH.OH{}.GEB.VFAT{}.VFAT_CHANNELS.CHANNEL{}.CALPULSE_ENABLE", 128, ohN, vfatN);
+    }
 
-    rtxn.abort();
-} //End dacScanMultiLink(...)
+    std::chrono::microseconds trigTimeout = triggerCycleTimeout(la, nevts, useExtTrig, minTrigRate);
+    for (uint32_t ch = 0; ch < 128 && !calJobCancelled(); ch++) {
+        calJobStage(ch, 128);
+        if (ch > 0) {
+            //Move the channel selection and the calpulse to this channel
+            RegWriteBatch chanSwap(la);
+            chanSwap.add(daqMonChanSelect, ch);
+            if (useCalPulse) {
+                for (int vfatN = 0; vfatN < 24; vfatN++) if ((notmask >> vfatN) & 0x1) {
+                    chanSwap.add(calPulseEnable[vfatN][pulsedCh], 0x0);
+                    chanSwap.add(calPulseEnable[vfatN][ch], 0x1);
+                }
+                pulsedCh = ch;
+            }
+            chanSwap.commit();
+        }
+
+        if (!genScanDacLoopLocal(la, scanRegs, &(outData[ch*nPoints]), notmask, nevts, dacMin, dacMax, dacStep, scanReg, useExtTrig, trigTimeout))
+            break;
+    } //End Loop over channels
+
+    //Turn off the calpulse of the last channel scanned
+    if (useCalPulse) {
+        if (confCalPulseLocal(la, ohN, mask, pulsedCh, false, currentPulse, calScaleFactor) == false) {
+            la->response->set_string("error",stdsprintf("Unable to configure calpulse OFF for ohN %i mask %x chan %i", ohN, mask, pulsedCh));
+        }
+    }
+    return;
+} //End genChannelScanLocal(...)
 
 void genChannelScan(const RPCMsg *request, RPCMsg *response)
 {
@@ -1316,6 +2088,7 @@ void genChannelScan(const RPCMsg *request, RPCMsg *response)
     bool currentPulse = request->get_word("currentPulse");
     uint32_t calScaleFactor = request->get_word("calScaleFactor");
     bool useExtTrig = request->get_word("useExtTrig");
+    uint32_t minTrigRate = request->get_key_exists("minTrigRate") ? request->get_word("minTrigRate") : 0;
     std::string scanReg = request->get_string("scanReg");
 
     bool useUltra = false;
@@ -1323,14 +2096,15 @@ void genChannelScan(const RPCMsg *request, RPCMsg *response)
         useUltra = true;
     }
 
-    uint32_t outData[128*24*(dacMax-dacMin+1)/dacStep];
-    for (uint32_t ch = 0; ch < 128; ch++) {
-        genScanLocal(&la, &(outData[ch*24*(dacMax-dacMin+1)/dacStep]), ohN, mask, ch, useCalPulse, currentPulse, calScaleFactor, nevts, dacMin, dacMax, dacStep, scanReg, useUltra, useExtTrig);
-    }
-    response->set_word_array("data",outData,24*128*(dacMax-dacMin+1)/dacStep);
+    std::shared_ptr<ResultJob> job = resultJobFor(request);
+    std::vector<uint32_t> outData(128*24*(dacMax-dacMin+1)/dacStep);
+    genChannelScanLocal(&la, outData.data(), ohN, mask, useCalPulse, currentPulse, calScaleFactor, nevts, dacMin, dacMax, dacStep, scanReg, useUltra, useExtTrig, minTrigRate);
+    setResultArray(response, job.get(), "data", outData.data(), outData.size());
+    if (job)
+        publishResultJob(response, job);
 
     rtxn.abort();
-}
+} //End genChannelScan(...)
 
 extern "C" {
     const char *module_version_key = "calibration_routines v1.0.1";
@@ -1341,13 +2115,20 @@ extern "C" {
             LOGGER->log_message(LogManager::ERROR, "Unable to load module");
             return; // Do not register our functions, we depend on memsvc.
         }
+        openAddressTable(); // retried on the first call if the address table is not available yet
         modmgr->register_method("calibration_routines", "checkSbitMappingWithCalPulse", checkSbitMappingWithCalPulse);
         modmgr->register_method("calibration_routines", "checkSbitRateWithCalPulse", checkSbitRateWithCalPulse);
         modmgr->register_method("calibration_routines", "dacScan", dacScan);
         modmgr->register_method("calibration_routines", "dacScanMultiLink", dacScanMultiLink);
         modmgr->register_method("calibration_routines", "genScan", genScan);
+        modmgr->register_method("calibration_routines", "genScanMultiLink", genScanMultiLink);
         modmgr->register_method("calibration_routines", "genChannelScan", genChannelScan);
+        modmgr->register_method("calibration_routines", "latencyScan", latencyScan);
         modmgr->register_method("calibration_routines", "sbitRateScan", sbitRateScan);
+        modmgr->register_method("calibration_routines", "submitJob", submitJob);
+        modmgr->register_method("calibration_routines", "jobStatus", jobStatus);
+        modmgr->register_method("calibration_routines", "cancelJob", cancelJob);
+        modmgr->register_method("calibration_routines", "jobResult", jobResult);
         modmgr->register_method("calibration_routines", "ttcGenConf", ttcGenConf);
         modmgr->register_method("calibration_routines", "ttcGenToggle", ttcGenToggle);
     }
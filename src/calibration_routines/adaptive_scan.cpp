@@ -0,0 +1,171 @@
+/*!
+ * \file calibration_routines/adaptive_scan.cpp
+ * \brief Choice of the DAC points of an adaptive scan
+ */
+
+#include "calibration_routines/adaptive_scan.h"
+
+#include <algorithm>
+#include <cmath>
+
+AdaptiveScan::AdaptiveScan(uint32_t notmask, uint32_t dacMin, uint32_t dacMax, uint32_t coarseStep, uint32_t fineStep) :
+    m_notmask(notmask & 0xFFFFFF),
+    m_dacMin(dacMin),
+    m_dacMax(dacMax),
+    m_coarseStep(std::max<uint32_t>(coarseStep, 1)),
+    m_fineStep(std::max<uint32_t>(fineStep, 1)),
+    m_relative(true),
+    m_fraction(0.5),
+    m_level(0),
+    m_phase(dacMin <= dacMax ? COARSE : DONE),
+    m_coarseVal(dacMin),
+    m_measuring(0),
+    m_refining(0),
+    m_steps(0)
+{
+    std::fill(m_dacVals, m_dacVals+24, dacMin);
+}
+
+void AdaptiveScan::setRelativeLevel(double fraction)
+{
+    m_relative = true;
+    m_fraction = fraction;
+}
+
+void AdaptiveScan::setAbsoluteLevel(uint32_t level)
+{
+    m_relative = false;
+    m_level    = level;
+}
+
+uint32_t AdaptiveScan::next(uint32_t * dacVals)
+{
+    m_measuring = 0;
+    if (m_phase == COARSE) {
+        std::fill(m_dacVals, m_dacVals+24, m_coarseVal);
+        m_measuring = m_notmask;
+    } else if (m_phase == REFINE) {
+        for (uint32_t vfatN = 0; vfatN < 24; ++vfatN) {
+            if (!((m_refining >> vfatN) & 0x1))
+                continue;
+            // middle of the bracket on the fine grid, strictly inside since the bracket is wider than fineStep
+            uint32_t mid = m_lo[vfatN] + (m_hi[vfatN]-m_lo[vfatN])/2/m_fineStep*m_fineStep;
+            m_dacVals[vfatN] = std::max(mid, m_lo[vfatN]+m_fineStep);
+        }
+        m_measuring = m_refining;
+    }
+    std::copy(m_dacVals, m_dacVals+24, dacVals);
+    return m_measuring;
+}
+
+void AdaptiveScan::record(const uint32_t * values)
+{
+    if (m_measuring == 0)
+        return;
+    ++m_steps;
+
+    for (uint32_t vfatN = 0; vfatN < 24; ++vfatN)
+        if ((m_measuring >> vfatN) & 0x1)
+            m_points[vfatN].push_back(Point(m_dacVals[vfatN], values[vfatN]));
+
+    if (m_phase == COARSE) {
+        // stop on the last value of the grid, without wrapping around
+        if (m_dacMax-m_coarseVal < m_coarseStep)
+            startRefinement();
+        else
+            m_coarseVal += m_coarseStep;
+    } else if (m_phase == REFINE) {
+        for (uint32_t vfatN = 0; vfatN < 24; ++vfatN) {
+            if (!((m_measuring >> vfatN) & 0x1))
+                continue;
+            if (values[vfatN] == 0xdeaddead) {
+                m_refining &= ~(0x1 << vfatN);
+                continue;
+            }
+            bool above = values[vfatN] >= m_vfatLevel[vfatN];
+            if (above == m_loAbove[vfatN])
+                m_lo[vfatN] = m_dacVals[vfatN];
+            else
+                m_hi[vfatN] = m_dacVals[vfatN];
+            if (m_hi[vfatN]-m_lo[vfatN] <= m_fineStep)
+                m_refining &= ~(0x1 << vfatN);
+        }
+        if (m_refining == 0)
+            m_phase = DONE;
+    }
+
+    if (m_phase == DONE)
+        for (uint32_t vfatN = 0; vfatN < 24; ++vfatN)
+            std::sort(m_points[vfatN].begin(), m_points[vfatN].end());
+}
+
+void AdaptiveScan::startRefinement()
+{
+    m_refining = 0;
+    if (m_fineStep < m_coarseStep) {
+        for (uint32_t vfatN = 0; vfatN < 24; ++vfatN) {
+            if (!((m_notmask >> vfatN) & 0x1))
+                continue;
+
+            const std::vector<Point> & coarse = m_points[vfatN];
+            uint32_t vMin = 0xffffffff, vMax = 0;
+            for (auto const& point : coarse) {
+                if (point.second == 0xdeaddead)
+                    continue;
+                vMin = std::min(vMin, point.second);
+                vMax = std::max(vMax, point.second);
+            }
+            if (vMin > vMax)
+                continue; // nothing was measured
+            m_vfatLevel[vfatN] = m_relative ? vMin + uint32_t(std::lround(m_fraction*(vMax-vMin))) : m_level;
+
+            // first coarse interval where the value crosses the level
+            for (size_t i = 1; i < coarse.size(); ++i) {
+                if (coarse[i-1].second == 0xdeaddead || coarse[i].second == 0xdeaddead)
+                    continue;
+                bool loAbove = coarse[i-1].second >= m_vfatLevel[vfatN];
+                bool hiAbove = coarse[i].second   >= m_vfatLevel[vfatN];
+                if (loAbove != hiAbove) {
+                    m_lo[vfatN]      = coarse[i-1].first;
+                    m_hi[vfatN]      = coarse[i].first;
+                    m_loAbove[vfatN] = loAbove;
+                    if (m_hi[vfatN]-m_lo[vfatN] > m_fineStep)
+                        m_refining |= (0x1 << vfatN);
+                    break;
+                }
+            }
+        }
+    }
+    m_phase = m_refining ? REFINE : DONE;
+}
+
+void AdaptiveScan::appendPoints(std::vector<uint32_t> & nPoints, std::vector<uint32_t> & dacVals, std::vector<uint32_t> & values) const
+{
+    for (uint32_t vfatN = 0; vfatN < 24; ++vfatN) {
+        nPoints.push_back(m_points[vfatN].size());
+        for (auto const& point : m_points[vfatN]) {
+            dacVals.push_back(point.first);
+            values.push_back(point.second);
+        }
+    }
+}
+
+uint32_t AdaptiveScan::plannedSteps() const
+{
+    uint32_t nCoarse = m_dacMin <= m_dacMax ? (m_dacMax-m_dacMin)/m_coarseStep+1 : 0;
+    uint32_t nRefine = 0;
+    for (uint32_t width = m_coarseStep; width > m_fineStep; width = (width+1)/2)
+        ++nRefine;
+    return nCoarse + nRefine;
+}
+
+AdaptiveScan adaptiveScanFor(const RPCMsg *request, uint32_t notmask, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep)
+{
+    uint32_t fineStep = request->get_key_exists("fineStep") ? request->get_word("fineStep") : 1;
+    AdaptiveScan scan(notmask, dacMin, dacMax, dacStep, fineStep);
+    if (request->get_key_exists("level"))
+        scan.setAbsoluteLevel(request->get_word("level"));
+    else if (request->get_key_exists("levelPercent"))
+        scan.setRelativeLevel(request->get_word("levelPercent")/100.);
+    return scan;
+}
@@ -0,0 +1,340 @@
+/*!
+ * \file calibration_routines/jobs.cpp
+ * \brief Background execution of the calibration scans
+ */
+
+#include "calibration_routines/jobs.h"
+#include "amc.h"
+#include "calibration_routines.h"
+#include "utils/result_stream.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+    typedef void (*CalJobMethod)(const RPCMsg *request, RPCMsg *response);
+
+    /// \var scan methods that can run as a job
+    const std::map<std::string, CalJobMethod> calJobMethods = {
+        {"checkSbitMappingWithCalPulse", checkSbitMappingWithCalPulse},
+        {"checkSbitRateWithCalPulse",    checkSbitRateWithCalPulse},
+        {"dacScan",                      dacScan},
+        {"dacScanMultiLink",             dacScanMultiLink},
+        {"genScan",                      genScan},
+        {"genScanMultiLink",             genScanMultiLink},
+        {"genChannelScan",               genChannelScan},
+        {"latencyScan",                  latencyScan},
+        {"sbitRateScan",                 sbitRateScan},
+        {"sbitReadOut",                  sbitReadOut},
+    };
+
+    struct CalJob {
+        CalJob(uint32_t jobId, const std::string & jobName, CalJobMethod jobMethod, const RPCMsg & jobRequest) :
+            id(jobId), name(jobName), method(jobMethod), request(jobRequest),
+            state(CAL_JOB_QUEUED), cancel(false),
+            stage(0), nStages(1), done(0), total(0), ohN(0), vfatN(0), dacVal(0)
+        {
+        }
+
+        const uint32_t     id;
+        const std::string  name;
+        const CalJobMethod method;
+        const RPCMsg       request;
+        RPCMsg             response; ///< written by the worker, read once the job is finished
+        std::shared_ptr<ResultJob> results; ///< result arrays fetched while the scan runs, set if the request has a "stream" word
+
+        std::atomic<uint32_t> state;
+        std::atomic<bool>     cancel;
+
+        /// progress, updated by the scan through calJobStage and calJobProgress
+        std::atomic<uint32_t> stage, nStages, done, total;
+        std::atomic<uint32_t> ohN, vfatN, dacVal;
+
+        /// guarded by jobsMutex
+        std::chrono::steady_clock::time_point started, finished;
+    };
+
+    std::mutex jobsMutex;
+    std::condition_variable jobsChanged;
+    std::map<uint32_t, std::shared_ptr<CalJob> > calJobs;
+    std::deque<std::shared_ptr<CalJob> > jobQueue;
+    std::shared_ptr<CalJob> runningJob;
+    uint32_t nextJobId = 1;
+    bool     exiting   = false;
+
+    /// \var job run by this thread, nullptr on the thread serving the RPC calls
+    thread_local CalJob *currentJob = nullptr;
+
+    bool finished(const CalJob & job)
+    {
+        return job.state == CAL_JOB_DONE || job.state == CAL_JOB_CANCELLED;
+    }
+
+    /// \brief Drops the oldest finished jobs beyond CAL_JOB_MAX, called with jobsMutex held
+    void dropOldJobs()
+    {
+        uint32_t nFinished = 0;
+        for (auto const& job : calJobs)
+            if (finished(*job.second))
+                ++nFinished;
+
+        // ids increase, so the first finished job is the oldest one
+        for (auto job = calJobs.begin(); job != calJobs.end() && nFinished > CAL_JOB_MAX; ) {
+            if (finished(*job->second)) {
+                LOGGER->log_message(LogManager::WARNING, stdsprintf("Too many finished jobs, dropping job %u (%s)", job->first, job->second->name.c_str()));
+                job = calJobs.erase(job);
+                --nFinished;
+            } else {
+                ++job;
+            }
+        }
+    }
+
+    void runJob(CalJob & job)
+    {
+        LOGGER->log_message(LogManager::INFO, stdsprintf("Starting job %u (%s)", job.id, job.name.c_str()));
+        currentJob = &job;
+        try {
+            ResultJobScope results(job.results);
+            job.method(&job.request, &job.response);
+        } catch (const std::exception& e) {
+            job.response.set_string("error", stdsprintf("Job %u (%s) failed: %s", job.id, job.name.c_str(), e.what()));
+            LOGGER->log_message(LogManager::ERROR, stdsprintf("Job %u (%s) failed: %s", job.id, job.name.c_str(), e.what()));
+        }
+        // arrays the method did not set are reported empty
+        if (job.results)
+            job.results->close();
+        currentJob = nullptr;
+        LOGGER->log_message(LogManager::INFO, stdsprintf("Job %u (%s) %s", job.id, job.name.c_str(), job.cancel ? "cancelled" : "done"));
+    }
+
+    void runJobs()
+    {
+        std::unique_lock<std::mutex> lock(jobsMutex);
+        while (true) {
+            jobsChanged.wait(lock, [] { return exiting || !jobQueue.empty(); });
+            if (exiting)
+                return;
+
+            runningJob = jobQueue.front();
+            jobQueue.pop_front();
+            runningJob->state   = CAL_JOB_RUNNING;
+            runningJob->started = std::chrono::steady_clock::now();
+            lock.unlock();
+
+            runJob(*runningJob);
+
+            lock.lock();
+            runningJob->finished = std::chrono::steady_clock::now();
+            runningJob->state    = runningJob->cancel ? CAL_JOB_CANCELLED : CAL_JOB_DONE;
+            runningJob.reset();
+            dropOldJobs();
+            jobsChanged.notify_all();
+        }
+    }
+
+    /// \brief Requests the cancellation of a job, called with jobsMutex held
+    /// \details Closing its result streams releases a scan waiting for the client to fetch them, further results are discarded
+    void cancel(CalJob & job)
+    {
+        job.cancel = true;
+        if (job.results)
+            job.results->close();
+    }
+
+    /// \brief Cancels the jobs and gives the running scan time to restore the front-end
+    /// \returns true once the worker has nothing left to run and exits
+    bool stopJobs()
+    {
+        std::unique_lock<std::mutex> lock(jobsMutex);
+        exiting = true;
+        for (auto const& job : calJobs)
+            cancel(*job.second);
+        jobsChanged.notify_all();
+        if (!jobsChanged.wait_for(lock, std::chrono::seconds(CAL_JOB_EXIT_WAIT_S), [] { return !runningJob; })) {
+            LOGGER->log_message(LogManager::ERROR, stdsprintf("Job %u (%s) did not stop within %u s", runningJob->id, runningJob->name.c_str(), CAL_JOB_EXIT_WAIT_S));
+            return false;
+        }
+        return true;
+    }
+
+    /// \brief Worker thread running the queued jobs, stopped and joined when the connection process exits normally
+    /// \details Destroyed with the other statics on exit(), before the job state it uses as it is defined after it.
+    ///          Processes killed by a signal leave through die(), which skips this shutdown.
+    ///          A scan that does not stop in time would use the statics destroyed after the worker, so the process then
+    ///          leaves through die() as well, which releases the memhub lock if the scan holds it.
+    class CalJobWorker
+    {
+        public:
+            ~CalJobWorker()
+            {
+                if (!m_thread.joinable())
+                    return;
+                if (!stopJobs())
+                    die(0);
+                m_thread.join();
+            }
+
+            /// \brief Starts the worker on the first job, called with jobsMutex held
+            void start()
+            {
+                if (!m_thread.joinable())
+                    m_thread = std::thread(runJobs);
+            }
+
+        private:
+            std::thread m_thread;
+    };
+
+    CalJobWorker worker;
+
+    /// \brief Returns the job named in the request, sets an error in the response if there is none
+    std::shared_ptr<CalJob> requestedJob(const RPCMsg *request, RPCMsg *response)
+    {
+        uint32_t jobId = request->get_word("jobId");
+        auto job = calJobs.find(jobId);
+        if (job == calJobs.end()) {
+            std::string errmsg = stdsprintf("No job %u", jobId);
+            response->set_string("error", errmsg);
+            LOGGER->log_message(LogManager::ERROR, errmsg);
+            return nullptr;
+        }
+        return job->second;
+    }
+}
+
+bool calJobCancelled()
+{
+    return currentJob && currentJob->cancel;
+}
+
+void calJobStage(uint32_t stage, uint32_t nStages)
+{
+    if (!currentJob)
+        return;
+    currentJob->done    = 0;
+    currentJob->total   = 0;
+    currentJob->nStages = nStages > 0 ? nStages : 1;
+    currentJob->stage   = stage;
+}
+
+void calJobProgress(uint32_t done, uint32_t total, uint32_t ohN, uint32_t vfatN, uint32_t dacVal)
+{
+    if (!currentJob)
+        return;
+    currentJob->total  = total;
+    currentJob->done   = done;
+    currentJob->ohN    = ohN;
+    currentJob->vfatN  = vfatN;
+    currentJob->dacVal = dacVal;
+}
+
+void submitJob(const RPCMsg *request, RPCMsg *response)
+{
+    std::string name = request->get_key_exists("job") ? request->get_string("job") : "";
+    auto method = calJobMethods.find(name);
+    if (method == calJobMethods.end()) {
+        std::string errmsg = stdsprintf("Unknown job method '%s'", name.c_str());
+        response->set_string("error", errmsg);
+        LOGGER->log_message(LogManager::ERROR, errmsg);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(jobsMutex);
+    worker.start();
+
+    uint32_t jobId = nextJobId++;
+    auto job = std::make_shared<CalJob>(jobId, name, method->second, *request);
+    if (request->get_key_exists("stream")) {
+        job->results = startResultJob();
+        response->set_word("streamId", job->results->id());
+    }
+    calJobs.emplace(jobId, job);
+    jobQueue.push_back(job);
+    jobsChanged.notify_all();
+
+    LOGGER->log_message(LogManager::INFO, stdsprintf("Queued job %u (%s), %zu job(s) ahead", jobId, name.c_str(), jobQueue.size()-1+(runningJob ? 1 : 0)));
+    response->set_word("jobId", jobId);
+}
+
+void jobStatus(const RPCMsg *request, RPCMsg *response)
+{
+    std::lock_guard<std::mutex> guard(jobsMutex);
+    std::shared_ptr<CalJob> job = requestedJob(request, response);
+    if (!job)
+        return;
+
+    uint32_t percent = 0;
+    if (job->state == CAL_JOB_DONE) {
+        percent = 100;
+    } else if (job->state != CAL_JOB_QUEUED) {
+        uint32_t total = job->total;
+        double stageDone = total > 0 ? static_cast<double>(job->done)/total : 0.;
+        percent = static_cast<uint32_t>(100.*(job->stage+stageDone)/job->nStages);
+    }
+
+    std::chrono::steady_clock::duration elapsed(0);
+    if (job->state == CAL_JOB_RUNNING)
+        elapsed = std::chrono::steady_clock::now()-job->started;
+    else if (finished(*job) && job->started != std::chrono::steady_clock::time_point())
+        elapsed = job->finished-job->started;
+
+    response->set_string("job", job->name);
+    response->set_word("state", job->state);
+    response->set_word("percent", percent);
+    response->set_word("ohN", job->ohN);
+    response->set_word("vfatN", job->vfatN);
+    response->set_word("dacVal", job->dacVal);
+    response->set_word("elapsedMs", std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
+
+void cancelJob(const RPCMsg *request, RPCMsg *response)
+{
+    std::lock_guard<std::mutex> guard(jobsMutex);
+    std::shared_ptr<CalJob> job = requestedJob(request, response);
+    if (!job)
+        return;
+
+    cancel(*job);
+    if (job->state == CAL_JOB_QUEUED) {
+        for (auto queued = jobQueue.begin(); queued != jobQueue.end(); ++queued) {
+            if (*queued == job) {
+                jobQueue.erase(queued);
+                break;
+            }
+        }
+        job->response.set_string("error", stdsprintf("Job %u (%s) cancelled before it started", job->id, job->name.c_str()));
+        job->finished = std::chrono::steady_clock::now();
+        job->state    = CAL_JOB_CANCELLED;
+        dropOldJobs();
+    }
+    LOGGER->log_message(LogManager::INFO, stdsprintf("Cancellation of job %u (%s) requested", job->id, job->name.c_str()));
+    response->set_word("state", job->state);
+}
+
+void jobResult(const RPCMsg *request, RPCMsg *response)
+{
+    std::lock_guard<std::mutex> guard(jobsMutex);
+    std::shared_ptr<CalJob> job = requestedJob(request, response);
+    if (!job)
+        return;
+
+    if (!finished(*job)) {
+        std::string errmsg = stdsprintf("Job %u (%s) is not finished", job->id, job->name.c_str());
+        response->set_string("error", errmsg);
+        LOGGER->log_message(LogManager::ERROR, errmsg);
+        return;
+    }
+
+    RPCMsg result(job->response);
+    result.set_method(response->get_method());
+  *response = result;
+    calJobs.erase(job->id);
+}
@@ -416,7 +416,17 @@ void getmonOHmain(const RPCMsg *request, RPCMsg *response)
 
 void getmonOHSCAmainLocal(localArgs *la, int NOH, int ohMask)
 {
-    std::string strRegName, strKeyName;
+    std::string strKeyName;
+
+    //SCA ADC monitoring values: SCA temperature, OH temperature sensors and voltage monitors
+    const std::vector<std::string> scaMonNames = {"SCA_TEMP",
+                                                  "BOARD_TEMP1", "BOARD_TEMP2", "BOARD_TEMP3",
+                                                  "BOARD_TEMP4", "BOARD_TEMP5", "BOARD_TEMP6",
+                                                  "BOARD_TEMP7", "BOARD_TEMP8", "BOARD_TEMP9",
+                                                  "AVCCN", "AVTTN", "1V0_INT", "1V8F", "1V5", "2V5_IO", "3V0", "1V8",
+                                                  "VTRX_RSSI2", "VTRX_RSSI1"};
+    std::vector<RegHandle> scaMonRegs(scaMonNames.size());
+    std::vector<uint32_t> scaMonValues(scaMonNames.size());
 
     //Get original monitoring mask
     uint32_t initSCAMonOffMask = readReg(la, "GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.MONITORING_OFF");
@@ -429,111 +439,26 @@ void getmonOHSCAmainLocal(localArgs *la, int NOH, int ohMask)
     for (int ohN = 0; ohN < NOH; ++ohN) { //Loop over all optohybrids
         // If this Optohybrid is masked skip it
         if (!((ohMask >> ohN) & 0x1)) {
-          //SCA Temperature
-          strKeyName = stdsprintf("OH%i.SCA_TEMP",ohN);
-          la->response->set_word(strKeyName,0xdeaddead);
-          //OH Temperature Sensors
-          for (int tempVal=1; tempVal <= 9; ++tempVal) { //Loop over optohybrid temperatures sensosrs
-              strKeyName = stdsprintf("OH%i.BOARD_TEMP%i",ohN,tempVal);
-              la->response->set_word(strKeyName, 0xdeaddead);
-          } //End Loop over optohybrid temeprature sensors
-          //Voltage Monitor - AVCCN
-          strKeyName = stdsprintf("OH%i.AVCCN",ohN);
-          la->response->set_word(strKeyName, 0xdeaddead);
-          //Voltage Monitor - AVTTN
-          strKeyName = stdsprintf("OH%i.AVTTN",ohN);
-          la->response->set_word(strKeyName, 0xdeaddead);
-          //Voltage Monitor - 1V0_INT
-          strKeyName = stdsprintf("OH%i.1V0_INT",ohN);
-          la->response->set_word(strKeyName, 0xdeaddead);
-          //Voltage Monitor - 1V8F
-          strKeyName = stdsprintf("OH%i.1V8F",ohN);
-          la->response->set_word(strKeyName, 0xdeaddead);
-          //Voltage Monitor - 1V5
-          strKeyName = stdsprintf("OH%i.1V5",ohN);
-          la->response->set_word(strKeyName, 0xdeaddead);
-          //Voltage Monitor - 2V5_IO
-          strKeyName = stdsprintf("OH%i.2V5_IO",ohN);
-          la->response->set_word(strKeyName, 0xdeaddead);
-          //Voltage Monitor - 3V0
-          strKeyName = stdsprintf("OH%i.3V0",ohN);
-          la->response->set_word(strKeyName, 0xdeaddead);
-          //Voltage Monitor - 1V8
-          strKeyName = stdsprintf("OH%i.1V8",ohN);
-          la->response->set_word(strKeyName, 0xdeaddead);
-          //Voltage Monitor - VTRX_RSSI2
-          strKeyName = stdsprintf("OH%i.VTRX_RSSI2",ohN);
-          la->response->set_word(strKeyName, 0xdeaddead);
-          //Voltage Monitor - VTRX_RSSI1
-          strKeyName = stdsprintf("OH%i.VTRX_RSSI1",ohN);
-          la->response->set_word(strKeyName, 0xdeaddead);
+          for (auto const& monName : scaMonNames) {
+              strKeyName = stdsprintf("OH%i.%s",ohN,monName.c_str());
+              la->response->set_word(strKeyName,0xdeaddead);
+          }
           continue;
         }
 
         //Log Message
         LOGGER->log_message(LogManager::INFO, stdsprintf("Reading SCA Monitoring Values for OH%i",ohN));
 
-        //SCA Temperature
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.SCA_TEMP",ohN);
-        strKeyName = stdsprintf("OH%i.SCA_TEMP",ohN);
-        la->response->set_word(strKeyName,readReg(la, strRegName));
-
-        //OH Temperature Sensors
-        for (int tempVal=1; tempVal <= 9; ++tempVal) { //Loop over optohybrid temperatures sensosrs
-            strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.BOARD_TEMP%i",ohN,tempVal);
-            strKeyName = stdsprintf("OH%i.BOARD_TEMP%i",ohN,tempVal);
-            la->response->set_word(strKeyName, readReg(la, strRegName));
-        } //End Loop over optohybrid temeprature sensors
-
-        //Voltage Monitor - AVCCN
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.AVCCN",ohN);
-        strKeyName = stdsprintf("OH%i.AVCCN",ohN);
-        la->response->set_word(strKeyName, readReg(la, strRegName));
-
-        //Voltage Monitor - AVTTN
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.AVTTN",ohN);
-        strKeyName = stdsprintf("OH%i.AVTTN",ohN);
-        la->response->set_word(strKeyName, readReg(la, strRegName));
-
-        //Voltage Monitor - 1V0_INT
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.1V0_INT",ohN);
-        strKeyName = stdsprintf("OH%i.1V0_INT",ohN);
-        la->response->set_word(strKeyName, readReg(la, strRegName));
-
-        //Voltage Monitor - 1V8F
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.1V8F",ohN);
-        strKeyName = stdsprintf("OH%i.1V8F",ohN);
-        la->response->set_word(strKeyName, readReg(la, strRegName));
-
-        //Voltage Monitor - 1V5
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.1V5",ohN);
-        strKeyName = stdsprintf("OH%i.1V5",ohN);
-        la->response->set_word(strKeyName, readReg(la, strRegName));
-
-        //Voltage Monitor - 2V5_IO
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.2V5_IO",ohN);
-        strKeyName = stdsprintf("OH%i.2V5_IO",ohN);
-        la->response->set_word(strKeyName, readReg(la, strRegName));
-
-        //Voltage Monitor - 3V0
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.3V0",ohN);
-        strKeyName = stdsprintf("OH%i.3V0",ohN);
-        la->response->set_word(strKeyName, readReg(la, strRegName));
-
-        //Voltage Monitor - 1V8
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.1V8",ohN);
-        strKeyName = stdsprintf("OH%i.1V8",ohN);
-        la->response->set_word(strKeyName, readReg(la, strRegName));
-
-        //Voltage Monitor - VTRX_RSSI2
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.VTRX_RSSI2",ohN);
-        strKeyName = stdsprintf("OH%i.VTRX_RSSI2",ohN);
-        la->response->set_word(strKeyName, readReg(la, strRegName));
-
-        //Voltage Monitor - VTRX_RSSI1
-        strRegName = stdsprintf("GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH%i.VTRX_RSSI1",ohN);
-        strKeyName = stdsprintf("OH%i.VTRX_RSSI1",ohN);
-        la->response->set_word(strKeyName, readReg(la, strRegName));
+        //Read all monitoring values of this optohybrid in one batch
+        for (size_t monIdx = 0; monIdx < scaMonNames.size(); ++monIdx) {
+            scaMonRegs[monIdx] = resolve(la, "GEM_AMC.SLOW_CONTROL.SCA.ADC_MONITORING.OH{}."+scaMonNames[monIdx], ohN);
+        }
+        readRegs(la, scaMonRegs, scaMonValues.data());
+
+        for (size_t monIdx = 0; monIdx < scaMonNames.size(); ++monIdx) {
+            strKeyName = stdsprintf("OH%i.%s",ohN,scaMonNames[monIdx].c_str());
+            la->response->set_word(strKeyName, scaMonValues[monIdx]);
+        }
     } //End Loop over all optohybrids
 
     //Return monitoring to original value
@@ -754,14 +679,16 @@ void getmonVFATLinkLocal(localArgs * la, int NOH, bool doReset)
          std::this_thread::sleep_for(std::chrono::microseconds(92)); // FIXME sleep for N orbits
     }
 
-    std::string regName, respName; //regName used for read/write, respName sets word in RPC response
+    std::string respName; //respName sets word in RPC response
     bool vfatOutOfSync = false;
     for (int ohN=0; ohN < NOH; ++ohN) {
+        std::vector<RegHandle> syncErrCnt   = resolveFamily(la, "GEM_AMC.OH_LINKS.OH{}.VFAT{}.SYNC_ERR_CNT", oh::VFATS_PER_OH, ohN);
+        std::vector<RegHandle> daqEventCnt  = resolveFamily(la, "GEM_AMC.OH_LINKS.OH{}.VFAT{}.DAQ_EVENT_CNT", oh::VFATS_PER_OH, ohN);
+        std::vector<RegHandle> daqCRCErrCnt = resolveFamily(la, "GEM_AMC.OH_LINKS.OH{}.VFAT{}.DAQ_CRC_ERROR_CNT", oh::VFATS_PER_OH, ohN);
         for (unsigned int vfatN=0; vfatN < oh::VFATS_PER_OH; ++vfatN) {
             //Sync Error Counters
             respName = stdsprintf("OH%i.VFAT%i.SYNC_ERR_CNT",ohN,vfatN);
-            regName = stdsprintf("GEM_AMC.OH_LINKS.OH%i.VFAT%i.SYNC_ERR_CNT",ohN,vfatN);
-            int nSyncErrs = readReg(la,regName);
+            int nSyncErrs = readReg(la,syncErrCnt[vfatN]);
             la->response->set_word(respName,nSyncErrs);
             if ( nSyncErrs > 0 ) {
                 vfatOutOfSync = true;
@@ -769,13 +696,11 @@ void getmonVFATLinkLocal(localArgs * la, int NOH, bool doReset)
 
             //DAQ Event Counters
             respName = stdsprintf("OH%i.VFAT%i.DAQ_EVENT_CNT",ohN,vfatN);
-            regName = stdsprintf("GEM_AMC.OH_LINKS.OH%i.VFAT%i.DAQ_EVENT_CNT",ohN,vfatN);
-            la->response->set_word(respName,readReg(la,regName));
+            la->response->set_word(respName,readReg(la,daqEventCnt[vfatN]));
 
             //DAQ CRC Error Counters
             respName = stdsprintf("OH%i.VFAT%i.DAQ_CRC_ERROR_CNT",ohN,vfatN);
-            regName = stdsprintf("GEM_AMC.OH_LINKS.OH%i.VFAT%i.DAQ_CRC_ERROR_CNT",ohN,vfatN);
-            la->response->set_word(respName,readReg(la,regName));
+            la->response->set_word(respName,readReg(la,daqCRCErrCnt[vfatN]));
         } //End Loop Over VFAT's
     } //End Loop Over All OH's
 
@@ -819,6 +744,7 @@ extern "C" {
             LOGGER->log_message(LogManager::ERROR, "Unable to load module");
             return; // Do not register our functions, we depend on memsvc.
         }
+        openAddressTable(); // retried on the first call if the address table is not available yet
         modmgr->register_method("daq_monitor", "getmonTTCmain", getmonTTCmain);
         modmgr->register_method("daq_monitor", "getmonTRIGGERmain", getmonTRIGGERmain);
         modmgr->register_method("daq_monitor", "getmonTRIGGEROHmain", getmonTRIGGEROHmain);
@@ -216,6 +216,7 @@ extern "C" {
             LOGGER->log_message(LogManager::ERROR, "Unable to load module");
             return; // Do not register our functions, we depend on memsvc.
         }
+        openAddressTable(); // retried on the first call if the address table is not available yet
         modmgr->register_method("gbt", "writeGBTConfig", writeGBTConfig);
         modmgr->register_method("gbt", "writeGBTPhase", writeGBTPhase);
         modmgr->register_method("gbt", "scanGBTPhases", scanGBTPhases);
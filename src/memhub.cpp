@@ -1,21 +1,311 @@
 #include "memhub.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <semaphore.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 #define SEM_NAME "/memhub"
 #define SEM_PERMS (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP)
 #define SEM_INIT 1
+#define STATS_SHM_NAME "/memhub_stats"
 
+static thread_local unsigned int lock_depth = 0; // number of nested memhub_lock() calls held by this thread
+static thread_local uint64_t lock_start_ns = 0; // monotonic time at which this thread took the lock
+static pid_t lock_owner = 0; // thread id of the holder of the lock in this process, 0 if none, read by die() on any thread
+
+static pid_t thread_id(void) {
+    return (pid_t)syscall(SYS_gettid);
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static memhub_stats_table_t *stats_table = NULL;
+static memhub_stats_slot_t *process_slot = NULL; // accesses of this process
+static thread_local memhub_stats_slot_t *context_slot = NULL; // accesses of the current context of this thread
+
+static memhub_stats_slot_t *stats_find(memhub_stats_slot_t *slots, int nslots, const char *name) {
+    for (int i = 0; i < nslots; ++i) {
+        if (__atomic_load_n(&slots[i].state, __ATOMIC_ACQUIRE) == 2 && strncmp(slots[i].name, name, MEMHUB_STATS_NAME_LEN) == 0) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+static bool stats_take(memhub_stats_slot_t *slot, uint32_t from, int32_t pid, const char *name) {
+    if (!__atomic_compare_exchange_n(&slot->state, &from, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+    slot->pid = pid;
+    strncpy(slot->name, name, MEMHUB_STATS_NAME_LEN-1);
+    slot->name[MEMHUB_STATS_NAME_LEN-1] = '\0';
+    memset(&slot->stats, 0, sizeof(slot->stats));
+    __atomic_store_n(&slot->state, 2, __ATOMIC_RELEASE);
+    return true;
+}
+
+static memhub_stats_slot_t *stats_claim_context(const char *name) {
+    memhub_stats_slot_t *slot = stats_find(stats_table->contexts, MEMHUB_STATS_CONTEXTS, name);
+    for (int i = 0; slot == NULL && i < MEMHUB_STATS_CONTEXTS; ++i) {
+        if (stats_take(&stats_table->contexts[i], 0, 0, name)) {
+            slot = &stats_table->contexts[i];
+        }
+    }
+    return slot;
+}
+
+static memhub_stats_slot_t *stats_claim_process(void) {
+    int32_t pid = getpid();
+    char name[MEMHUB_STATS_NAME_LEN];
+    snprintf(name, sizeof(name), "pid%d", pid);
+    memhub_stats_slot_t *slots = stats_table->processes;
+    for (int i = 0; i < MEMHUB_STATS_PROCESSES; ++i) {
+        if (stats_take(&slots[i], 0, pid, name)) {
+            return &slots[i];
+        }
+    }
+    // table full, take over the slot of a process that is gone
+    for (int i = 0; i < MEMHUB_STATS_PROCESSES; ++i) {
+        if (kill(slots[i].pid, 0) != 0 && errno == ESRCH && stats_take(&slots[i], 2, pid, name)) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+static void stats_atfork_child(void) {
+    process_slot = NULL;
+    context_slot = NULL;
+    if (stats_table != NULL) {
+        process_slot = stats_claim_process();
+    }
+}
+
+static int stats_open(void) {
+    if (stats_table != NULL) {
+        return 0;
+    }
+    int fd = shm_open(STATS_SHM_NAME, O_RDWR | O_CREAT, SEM_PERMS);
+    if (fd < 0) {
+        perror("shm_open(3) error");
+        return -1;
+    }
+    // a new segment is zero filled, which is an empty table
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(memhub_stats_table_t)) {
+        if (ftruncate(fd, sizeof(memhub_stats_table_t)) != 0) {
+            perror("ftruncate(2) error");
+            close(fd);
+            return -1;
+        }
+    }
+    void *addr = mmap(NULL, sizeof(memhub_stats_table_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        perror("mmap(2) error");
+        return -1;
+    }
+    stats_table = (memhub_stats_table_t *)addr;
+    process_slot = stats_claim_process();
+    pthread_atfork(NULL, NULL, stats_atfork_child);
+    return 0;
+}
+
+static unsigned int stats_bin(uint64_t ns) {
+    if (ns < 2) {
+        return 0;
+    }
+    unsigned int bin = 63 - __builtin_clzll(ns);
+    return bin < MEMHUB_STATS_HIST_BINS ? bin : MEMHUB_STATS_HIST_BINS-1;
+}
+
+static void stats_add(memhub_stats_slot_t *slot, int kind, uint32_t words, uint64_t wait_ns, uint64_t memsvc_ns) {
+    memhub_access_stats_t *stats = &slot->stats;
+    __atomic_fetch_add(&stats->calls[kind], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->words[kind], words, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->wait_ns[kind], wait_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->memsvc_ns[kind], memsvc_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->wait_hist[kind][stats_bin(wait_ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->memsvc_hist[kind][stats_bin(memsvc_ns)], 1, __ATOMIC_RELAXED);
+}
+
+static void stats_record(int kind, uint32_t words, uint64_t wait_ns, uint64_t memsvc_ns) {
+    if (process_slot != NULL) {
+        stats_add(process_slot, kind, words, wait_ns, memsvc_ns);
+    }
+    if (context_slot != NULL) {
+        stats_add(context_slot, kind, words, wait_ns, memsvc_ns);
+    }
+}
+
+static void lock_record_hold(memhub_lock_stats_t *stats, uint64_t hold_ns) {
+    stats->total_hold_ns += hold_ns;
+    if (hold_ns > stats->max_hold_ns) {
+        stats->max_hold_ns = hold_ns;
+    }
+}
+
+static void lock_record_wait(memhub_lock_stats_t *stats, uint64_t wait_ns, bool contended) {
+    stats->acquisitions++;
+    if (contended) {
+        stats->contended++;
+    }
+    stats->total_wait_ns += wait_ns;
+    if (wait_ns > stats->max_wait_ns) {
+        stats->max_wait_ns = wait_ns;
+    }
+}
+
+#ifdef MEMHUB_ROBUST_MUTEX
+/*
+ * Robust process-shared mutex backend.
+ * If the owner dies while holding the lock, whatever the signal (including SIGKILL), the next locker gets EOWNERDEAD
+ * and marks the mutex consistent again, so no signal handlers are needed.
+ * The wait statistics live next to the mutex and are updated while holding it, so they cover all processes.
+ */
+#define SHM_NAME "/memhub_mutex"
+#define SHM_MAGIC 0x6d656d68 // "memh"
+#define SHM_INIT_ATTEMPTS 1000
+
+typedef struct memhub_shared_lock {
+    uint32_t magic; // set once the mutex is initialized
+    pthread_mutex_t mutex;
+    memhub_lock_stats_t stats;
+} memhub_shared_lock_t;
+
+static memhub_shared_lock_t *shared_lock = NULL;
+
+static int backend_open(void) {
+    if (shared_lock != NULL) {
+        return 0;
+    }
+
+    bool creator = true;
+    int fd = shm_open(SHM_NAME, O_RDWR | O_CREAT | O_EXCL, SEM_PERMS);
+    if (fd < 0 && errno == EEXIST) {
+        creator = false;
+        fd = shm_open(SHM_NAME, O_RDWR, SEM_PERMS);
+    }
+    if (fd < 0) {
+        perror("shm_open(3) error");
+        return -1;
+    }
+    if (creator && ftruncate(fd, sizeof(memhub_shared_lock_t)) != 0) {
+        perror("ftruncate(2) error");
+        close(fd);
+        return -1;
+    }
+    // another process may still be sizing the segment
+    struct stat st;
+    for (int attempt = 0; !creator && attempt < SHM_INIT_ATTEMPTS; ++attempt) {
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(memhub_shared_lock_t)) {
+            break;
+        }
+        usleep(1000);
+    }
+
+    void *addr = mmap(NULL, sizeof(memhub_shared_lock_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        perror("mmap(2) error");
+        return -1;
+    }
+    memhub_shared_lock_t *lock = (memhub_shared_lock_t *)addr;
+
+    if (creator) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&lock->mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+        memset(&lock->stats, 0, sizeof(lock->stats));
+        __atomic_store_n(&lock->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    } else {
+        int attempt = 0;
+        while (__atomic_load_n(&lock->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC) {
+            if (++attempt == SHM_INIT_ATTEMPTS) {
+                LOGGER->log_message(LogManager::ERROR, "Memhub mutex was never initialized, please clean up /dev/shm" SHM_NAME);
+                munmap(addr, sizeof(memhub_shared_lock_t));
+                return -1;
+            }
+            usleep(1000);
+        }
+    }
+
+    shared_lock = lock;
+    LOGGER->log_message(LogManager::INFO, stdsprintf("Memhub %s the robust mutex in %s", creator ? "initialized" : "attached to", SHM_NAME));
+    return 0;
+}
+
+static void backend_close(void) {
+    if (shared_lock != NULL) {
+        munmap(shared_lock, sizeof(memhub_shared_lock_t));
+        shared_lock = NULL;
+    }
+}
+
+static int backend_lock(bool *contended) {
+    uint64_t start = monotonic_ns();
+    *contended = false;
+    int rc = pthread_mutex_trylock(&shared_lock->mutex);
+    if (rc == EBUSY) {
+        *contended = true;
+        rc = pthread_mutex_lock(&shared_lock->mutex);
+    }
+    if (rc == EOWNERDEAD) {
+        LOGGER->log_message(LogManager::WARNING, "[!] Previous memhub lock owner died while holding the lock, recovering");
+        pthread_mutex_consistent(&shared_lock->mutex);
+        shared_lock->stats.owner_deaths++;
+        rc = 0;
+    }
+    if (rc != 0) {
+        LOGGER->log_message(LogManager::ERROR, stdsprintf("Unable to take the memhub lock: %s", strerror(rc)));
+        return -1;
+    }
+    lock_record_wait(&shared_lock->stats, monotonic_ns() - start, *contended);
+    return 0;
+}
+
+static void backend_unlock(void) {
+    pthread_mutex_unlock(&shared_lock->mutex);
+}
+
+// only updated while holding the lock
+static memhub_lock_stats_t *backend_stats(void) {
+    return &shared_lock->stats;
+}
+
+static void backend_get_stats(memhub_lock_stats_t *stats) {
+    // a snapshot without taking the lock, the counters may be mid-update
+    *stats = shared_lock->stats;
+}
+
+#else
+/*
+ * POSIX semaphore backend.
+ * A process killed while holding the semaphore can only release it from a signal handler, see die().
+ */
 static sem_t *semaphore = NULL;
-static bool busy = false;
+static memhub_lock_stats_t lock_stats = {0, 0, 0, 0, 0, 0, 0, 0, 0};
 
-int memhub_open(memsvc_handle_t *handle) {
+static int backend_open(void) {
     if (semaphore == NULL) {
         semaphore = sem_open(SEM_NAME, O_CREAT, SEM_PERMS, SEM_INIT);
         int semval = 0;
@@ -38,41 +328,214 @@ int memhub_open(memsvc_handle_t *handle) {
     signal(SIGINT, die);
     signal(SIGSEGV, die);
     signal(SIGTERM, die);
+    return 0;
+}
+
+static void backend_close(void) {
+    sem_close(semaphore);
+}
+
+static int backend_lock(bool *contended) {
+    uint64_t start = monotonic_ns();
+    *contended = false;
+    if (sem_trywait(semaphore) != 0) {
+        *contended = true;
+        if (sem_wait(semaphore) != 0) {
+            return -1;
+        }
+    }
+    lock_record_wait(&lock_stats, monotonic_ns() - start, *contended);
+    return 0;
+}
 
+static void backend_unlock(void) {
+    sem_post(semaphore);
+}
+
+// only updated while holding the lock
+static memhub_lock_stats_t *backend_stats(void) {
+    return &lock_stats;
+}
+
+static void backend_get_stats(memhub_lock_stats_t *stats) {
+    // process local, the semaphore has no room for shared counters
+    *stats = lock_stats;
+}
+#endif
+
+int memhub_open(memsvc_handle_t *handle) {
+    if (backend_open() != 0) {
+        return -1;
+    }
+    if (stats_open() != 0) {
+        LOGGER->log_message(LogManager::WARNING, "Memhub access statistics are not available");
+    }
     return memsvc_open(handle);
 }
 
 int memhub_close(memsvc_handle_t *handle) {
-    sem_close(semaphore);
+    backend_close();
     return memsvc_close(handle);
 }
 
+static int lock_outermost(bool *contended) {
+    if (backend_lock(contended) != 0) {
+        return -1;
+    }
+    __atomic_store_n(&lock_owner, thread_id(), __ATOMIC_RELEASE);
+    lock_start_ns = monotonic_ns();
+    return 0;
+}
+
+static void unlock_outermost(void) {
+    lock_record_hold(backend_stats(), monotonic_ns() - lock_start_ns);
+    __atomic_store_n(&lock_owner, 0, __ATOMIC_RELEASE);
+    backend_unlock();
+}
+
+int memhub_lock(void) {
+    bool contended;
+    if (lock_depth == 0 && lock_outermost(&contended) != 0) {
+        return -1;
+    }
+    ++lock_depth;
+    return 0;
+}
+
+int memhub_unlock(void) {
+    if (lock_depth == 0) {
+        return -1;
+    }
+    if (--lock_depth == 0) {
+        unlock_outermost();
+    }
+    return 0;
+}
+
+int memhub_lease_acquire(memhub_lease_t *lease, uint32_t max_hold_us) {
+    lease->start_ns = 0;
+    lease->max_hold_us = max_hold_us;
+    lease->yields = 0;
+    if (memhub_lock() != 0) {
+        return -1;
+    }
+    lease->start_ns = monotonic_ns();
+    return 0;
+}
+
+int memhub_lease_yield(memhub_lease_t *lease) {
+    if (lease->start_ns == 0) {
+        return -1;
+    }
+    // nested in an outer lock, which decides when the lock is released
+    if (lock_depth != 1) {
+        return 0;
+    }
+    uint64_t now = monotonic_ns();
+    if (now - lease->start_ns < (uint64_t)lease->max_hold_us*1000ULL) {
+        return 0;
+    }
+    backend_stats()->lease_yields++;
+    lease->yields++;
+    unlock_outermost();
+    sched_yield();
+    bool contended;
+    if (lock_outermost(&contended) != 0) {
+        lock_depth = 0;
+        lease->start_ns = 0;
+        return -1;
+    }
+    if (contended) {
+        backend_stats()->lease_handoffs++;
+    }
+    lease->start_ns = monotonic_ns();
+    return 1;
+}
+
+int memhub_lease_release(memhub_lease_t *lease) {
+    if (lease->start_ns == 0) {
+        return -1;
+    }
+    lease->start_ns = 0;
+    return memhub_unlock();
+}
+
+void memhub_lock_get_stats(memhub_lock_stats_t *stats) {
+    backend_get_stats(stats);
+}
+
+void memhub_set_context(const char *name) {
+    if (stats_table == NULL || name == NULL) {
+        context_slot = NULL;
+        return;
+    }
+    if (context_slot != NULL && strncmp(context_slot->name, name, MEMHUB_STATS_NAME_LEN-1) == 0) {
+        return;
+    }
+    context_slot = stats_claim_context(name);
+}
+
+const memhub_stats_table_t *memhub_get_stats_table(void) {
+    return stats_table;
+}
+
+void memhub_reset_stats(void) {
+    if (stats_table == NULL) {
+        return;
+    }
+    for (int i = 0; i < MEMHUB_STATS_CONTEXTS; ++i) {
+        memset(&stats_table->contexts[i].stats, 0, sizeof(memhub_access_stats_t));
+    }
+    for (int i = 0; i < MEMHUB_STATS_PROCESSES; ++i) {
+        memset(&stats_table->processes[i].stats, 0, sizeof(memhub_access_stats_t));
+    }
+}
+
 int memhub_read(memsvc_handle_t handle, uint32_t addr, uint32_t words, uint32_t *data) {
-    sem_wait(semaphore);
-    busy = true;
+    uint64_t start = monotonic_ns();
+    memhub_lock();
+    uint64_t locked = monotonic_ns();
     int ret = memsvc_read(handle, addr, words, data);
-    sem_post(semaphore);
-    busy = false;
+    uint64_t done = monotonic_ns();
+    memhub_unlock();
+    stats_record(MEMHUB_ACCESS_READ, words, locked - start, done - locked);
     return ret;
 }
 
 int memhub_write(memsvc_handle_t handle, uint32_t addr, uint32_t words, const uint32_t *data) {
-    sem_wait(semaphore);
-    busy = true;
+    uint64_t start = monotonic_ns();
+    memhub_lock();
+    uint64_t locked = monotonic_ns();
     int ret = memsvc_write(handle, addr, words, data);
-    sem_post(semaphore);
-    busy = false;
+    uint64_t done = monotonic_ns();
+    memhub_unlock();
+    stats_record(MEMHUB_ACCESS_WRITE, words, locked - start, done - locked);
     return ret;
 }
 
+// The signal may be handled by any thread, the lock is released for whichever thread of the process holds it.
+// _exit() skips the atexit handlers and static destructors, which may block on state held by the interrupted thread.
 void die(int signo) {
+    pid_t owner = __atomic_load_n(&lock_owner, __ATOMIC_ACQUIRE);
+#ifdef MEMHUB_ROBUST_MUTEX
+    // only the owner can unlock the mutex, otherwise the next locker recovers it with EOWNERDEAD once this process is gone
+    if (owner != 0 && owner == thread_id()) {
+        LOGGER->log_message(LogManager::ERROR, stdsprintf("[!] Application is dying, releasing the memhub lock..\n"));
+        lock_depth = 0;
+        __atomic_store_n(&lock_owner, 0, __ATOMIC_RELEASE);
+        backend_unlock();
+    }
+    LOGGER->log_message(LogManager::ERROR, stdsprintf("[!] Application was killed or died with signal %d...\n", signo));
+#else
     int semval = 0;
     sem_getvalue(semaphore, &semval);
 
-    if (busy && (semval == 0)) {
-        LOGGER->log_message(LogManager::ERROR, stdsprintf("[!] Application is dying, trying to undo an active semaphore..\n"));
+    if ((owner != 0) && (semval == 0)) {
+        LOGGER->log_message(LogManager::ERROR, stdsprintf("[!] Application is dying, trying to undo an active semaphore held by thread %d..\n", owner));
+        __atomic_store_n(&lock_owner, 0, __ATOMIC_RELEASE);
         sem_post(semaphore);
     }
     LOGGER->log_message(LogManager::ERROR, stdsprintf("[!] Application was killed or died with signal %d (semaphore value at the time of the kill = %d)...\n", signo, semval));
-    exit(1);
+#endif
+    _exit(1);
 }
@@ -0,0 +1,430 @@
+/*! \file mock/memsvc.cpp
+ *  \brief Simulated memsvc backend, drop-in replacement for libmemsvc when running the modules off-board
+ *  \details The register file is built from the LMDB address table at $GEM_PATH/address_table.mdb,
+ *           addresses that are not in the table are rejected like on the board.
+ *           Behaviour of individual registers is described by rules, read from the file named by
+ *           MEMSVC_MOCK_SCRIPT or taken from a built-in set that lets the calibration and monitoring
+ *           routines run to completion.
+ *
+ *           Script format, one rule per line, '#' starts a comment, register names accept fnmatch globs:
+ *             value     REG VALUE                  REG reads VALUE until written
+ *             selfclear REG                        REG reads 0 right after being written
+ *             decay     REG TRIGGER NREADS         writing TRIGGER sets REG to 1, cleared after NREADS reads
+ *             counter   REG TRIGGER INCREMENT      writing TRIGGER adds INCREMENT to REG
+ *             counter   REG TRIGGER COUNTREG       writing TRIGGER adds the value of COUNTREG to REG
+ *             clear     REG TRIGGER                writing TRIGGER sets REG to 0
+ *             fifo      REG VALUE [VALUE...]       reads of REG pop the given words, 0 once empty
+ *             latency   NANOSECONDS                busy wait per word accessed, to model the AXI bus
+ */
+
+#include <libmemsvc.h>
+
+#include "address_table.h"
+#include "lmdb_cpp_wrapper.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fnmatch.h>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct memsvc_handle {
+    std::string last_error;
+};
+
+namespace {
+
+    /*! \brief Register field as found in the address table
+     */
+    struct MockField {
+        uint32_t address;
+        uint32_t mask;
+        uint8_t  shift;
+    };
+
+    enum MockRuleType {
+        RULE_SELFCLEAR,
+        RULE_DECAY,
+        RULE_COUNTER,
+        RULE_CLEAR,
+    };
+
+    /*! \brief Behaviour attached to a write of the trigger register
+     */
+    struct MockRule {
+        MockRuleType type;
+        MockField    target;
+        uint32_t     amount;    ///< reads before a decay clears, or counter increment
+        bool         useCount;  ///< counter increment is taken from count
+        MockField    count;
+    };
+
+    struct MockDecay {
+        MockField field;
+        uint32_t  remaining;
+    };
+
+    std::mutex mockMutex;
+    bool mockLoaded = false;
+    std::string mockError;
+    std::unordered_map<std::string, MockField>  nodes;
+    std::unordered_map<uint32_t, uint32_t>      regFile;
+    std::unordered_multimap<uint32_t, MockRule> writeRules;  ///< keyed by trigger address
+    std::unordered_map<uint32_t, std::deque<uint32_t> > fifos;
+    std::unordered_map<uint32_t, std::vector<MockDecay> > decays;
+    uint32_t latencyNs = 0;
+
+    /*! \brief Built-in rules, enough for fw_version_check, the link checks and the cyclic generator driven scans
+     */
+    const char *defaultScript =
+        "value     GEM_AMC.GEM_SYSTEM.RELEASE.MAJOR 3\n"
+        "value     GEM_AMC.GEM_SYSTEM.CONFIG.NUM_OF_OH 12\n"
+        "value     GEM_AMC.OH_LINKS.OH*.VFAT*.LINK_GOOD 1\n"
+        "value     GEM_AMC.OH_LINKS.OH*.VFAT*.SYNC_ERR_CNT 0\n"
+        "selfclear *RESET\n"
+        "selfclear *_START\n"
+        "selfclear *RESYNC\n"
+        "decay     GEM_AMC.TTC.GENERATOR.CYCLIC_RUNNING GEM_AMC.TTC.GENERATOR.CYCLIC_START 3\n"
+        "counter   GEM_AMC.TTC.CMD_COUNTERS.L1A GEM_AMC.TTC.GENERATOR.CYCLIC_START GEM_AMC.TTC.GENERATOR.CYCLIC_L1A_COUNT\n"
+        "counter   GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.VFAT*.GOOD_EVENTS_COUNT GEM_AMC.TTC.GENERATOR.CYCLIC_START GEM_AMC.TTC.GENERATOR.CYCLIC_L1A_COUNT\n"
+        "clear     GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.VFAT*.GOOD_EVENTS_COUNT GEM_AMC.GEM_TESTS.VFAT_DAQ_MONITOR.CTRL.RESET\n"
+        "clear     GEM_AMC.TTC.CMD_COUNTERS.L1A GEM_AMC.TTC.CTRL.CNT_RESET\n";
+
+    bool parseTextNode(const lmdb::val & value, MockField & field, uint32_t & size)
+    {
+        // address|permission|mask|mode|size, as written by the text address table format
+        std::string text(value.data(), value.size());
+        std::vector<std::string> fields;
+        std::stringstream ss(text);
+        std::string item;
+        while (std::getline(ss, item, '|'))
+            fields.push_back(item);
+        if (fields.size() != 5)
+            return false;
+        field.address = strtoul(fields[0].c_str(), nullptr, 16);
+        field.mask    = strtoul(fields[2].c_str(), nullptr, 16);
+        size          = strtoul(fields[4].c_str(), nullptr, 16);
+        field.shift   = field.mask ? __builtin_ctz(field.mask) : 0;
+        return true;
+    }
+
+    /*! \brief Populate nodes and the register file from the address table
+     *  \details The environment is closed again before returning: the modules open the same table in this
+     *           process afterwards, and LMDB does not allow one file to be open twice in a process
+     */
+    bool loadAddressTable()
+    {
+        const char *gem_path = std::getenv("GEM_PATH");
+        if (gem_path == nullptr) {
+            mockError = "mock memsvc: GEM_PATH is not set";
+            return false;
+        }
+        std::string lmdb_area_file = std::string(gem_path)+"/address_table.mdb";
+        try {
+            auto env = lmdb::env::create();
+            env.set_mapsize(1UL * 1024UL * 1024UL * 40UL);
+            env.open(lmdb_area_file.c_str(), MDB_RDONLY, 0664);
+            auto rtxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+            auto dbi  = lmdb::dbi::open(rtxn, nullptr);
+
+            lmdb::val key, value;
+            uint32_t format = AT_FORMAT_TEXT;
+            key.assign(AT_FORMAT_KEY);
+            if (dbi.get(rtxn, key, value) && value.size() == sizeof(uint32_t))
+                std::memcpy(&format, value.data(), sizeof(uint32_t));
+
+            auto cursor = lmdb::cursor::open(rtxn, dbi);
+            bool found = cursor.get(key, value, MDB_FIRST);
+            while (found) {
+                std::string name(key.data(), key.size());
+                MockField field;
+                uint32_t size = 1;
+                bool ok = false;
+                if (name == AT_FORMAT_KEY) {
+                    ok = false;
+                } else if (format == AT_FORMAT_BINARY && value.size() == sizeof(RegRecord)) {
+                    const RegRecord *record = reinterpret_cast<const RegRecord*>(value.data());
+                    field.address = record->address;
+                    field.mask    = record->mask;
+                    field.shift   = record->shift;
+                    size          = record->size;
+                    ok = true;
+                } else if (format == AT_FORMAT_TEXT) {
+                    ok = parseTextNode(value, field, size);
+                }
+                if (ok) {
+                    nodes.emplace(name, field);
+                    for (uint32_t word = 0; word < (size ? size : 1); ++word)
+                        regFile.emplace(field.address+word, 0);
+                }
+                found = cursor.get(key, value, MDB_NEXT);
+            }
+            cursor.close();
+            rtxn.abort();
+        } catch (const lmdb::error& e) {
+            mockError = std::string("mock memsvc: unable to open address table ")+lmdb_area_file+": "+e.what();
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<MockField> matchFields(const std::string & pattern)
+    {
+        std::vector<MockField> fields;
+        auto exact = nodes.find(pattern);
+        if (exact != nodes.end()) {
+            fields.push_back(exact->second);
+            return fields;
+        }
+        for (auto const& node : nodes)
+            if (fnmatch(pattern.c_str(), node.first.c_str(), 0) == 0)
+                fields.push_back(node.second);
+        return fields;
+    }
+
+    uint32_t getField(const MockField & field)
+    {
+        return (regFile[field.address] & field.mask) >> field.shift;
+    }
+
+    void setField(const MockField & field, uint32_t value)
+    {
+        uint32_t & word = regFile[field.address];
+        word = (word & ~field.mask) | ((value << field.shift) & field.mask);
+    }
+
+    /*! \brief Parse one script line, unknown registers are reported on stderr and skipped
+     */
+    void parseRule(const std::string & line, size_t lineNo)
+    {
+        std::stringstream ss(line.substr(0, line.find('#')));
+        std::vector<std::string> words;
+        std::string word;
+        while (ss >> word)
+            words.push_back(word);
+        if (words.empty())
+            return;
+
+        const std::string & kind = words[0];
+        if (kind == "latency" && words.size() == 2) {
+            latencyNs = strtoul(words[1].c_str(), nullptr, 0);
+            return;
+        }
+
+        if (words.size() < 2) {
+            fprintf(stderr, "mock memsvc: line %zu: malformed rule '%s'\n", lineNo, line.c_str());
+            return;
+        }
+        std::vector<MockField> targets = matchFields(words[1]);
+        if (targets.empty()) {
+            fprintf(stderr, "mock memsvc: line %zu: no register matches %s\n", lineNo, words[1].c_str());
+            return;
+        }
+
+        if (kind == "value" && words.size() == 3) {
+            uint32_t value = strtoul(words[2].c_str(), nullptr, 0);
+            for (auto const& target : targets)
+                setField(target, value);
+        } else if (kind == "fifo" && words.size() >= 3) {
+            for (auto const& target : targets)
+                for (size_t i = 2; i < words.size(); ++i)
+                    fifos[target.address].push_back(strtoul(words[i].c_str(), nullptr, 0));
+        } else if (kind == "selfclear" && words.size() == 2) {
+            for (auto const& target : targets)
+                writeRules.emplace(target.address, MockRule{RULE_SELFCLEAR, target, 0, false, target});
+        } else if ((kind == "decay" || kind == "counter") && words.size() == 4) {
+            std::vector<MockField> triggers = matchFields(words[2]);
+            if (triggers.size() != 1) {
+                fprintf(stderr, "mock memsvc: line %zu: trigger %s must name one register\n", lineNo, words[2].c_str());
+                return;
+            }
+            MockRule rule = {kind == "decay" ? RULE_DECAY : RULE_COUNTER, targets[0], 0, false, targets[0]};
+            char *end = nullptr;
+            rule.amount = strtoul(words[3].c_str(), &end, 0);
+            if (*end != '\0') {
+                std::vector<MockField> count = matchFields(words[3]);
+                if (kind == "decay" || count.size() != 1) {
+                    fprintf(stderr, "mock memsvc: line %zu: bad amount %s\n", lineNo, words[3].c_str());
+                    return;
+                }
+                rule.useCount = true;
+                rule.count    = count[0];
+            }
+            for (auto const& target : targets) {
+                rule.target = target;
+                writeRules.emplace(triggers[0].address, rule);
+            }
+        } else if (kind == "clear" && words.size() == 3) {
+            std::vector<MockField> triggers = matchFields(words[2]);
+            for (auto const& trigger : triggers)
+                for (auto const& target : targets)
+                    writeRules.emplace(trigger.address, MockRule{RULE_CLEAR, target, 0, false, target});
+        } else {
+            fprintf(stderr, "mock memsvc: line %zu: malformed rule '%s'\n", lineNo, line.c_str());
+        }
+    }
+
+    void loadScript()
+    {
+        const char *scriptFile = std::getenv("MEMSVC_MOCK_SCRIPT");
+        std::stringstream script;
+        if (scriptFile != nullptr) {
+            std::ifstream in(scriptFile);
+            if (!in)
+                fprintf(stderr, "mock memsvc: unable to read %s, using the built-in rules\n", scriptFile);
+            else
+                script << in.rdbuf();
+        }
+        if (script.str().empty())
+            script << defaultScript;
+
+        std::string line;
+        size_t lineNo = 0;
+        while (std::getline(script, line))
+            parseRule(line, ++lineNo);
+    }
+
+    /*! \brief Apply the rules triggered by a write to address, self-clearing rules go last so counters see the bit set
+     */
+    void applyWriteRules(uint32_t address)
+    {
+        auto range = writeRules.equal_range(address);
+        for (auto rule = range.first; rule != range.second; ++rule) {
+            const MockRule & r = rule->second;
+            switch (r.type) {
+            case RULE_DECAY:
+                setField(r.target, 1);
+                decays[r.target.address].push_back(MockDecay{r.target, r.amount});
+                break;
+            case RULE_COUNTER:
+                setField(r.target, getField(r.target) + (r.useCount ? getField(r.count) : r.amount));
+                break;
+            case RULE_CLEAR:
+                setField(r.target, 0);
+                break;
+            default:
+                break;
+            }
+        }
+        for (auto rule = range.first; rule != range.second; ++rule)
+            if (rule->second.type == RULE_SELFCLEAR)
+                setField(rule->second.target, 0);
+    }
+
+    uint32_t readWord(uint32_t address)
+    {
+        auto fifo = fifos.find(address);
+        if (fifo != fifos.end()) {
+            if (fifo->second.empty())
+                return 0;
+            uint32_t value = fifo->second.front();
+            fifo->second.pop_front();
+            return value;
+        }
+
+        uint32_t value = regFile[address];
+        auto decay = decays.find(address);
+        if (decay != decays.end()) {
+            std::vector<MockDecay> & pending = decay->second;
+            for (auto it = pending.begin(); it != pending.end();) {
+                if (it->remaining == 0 || --(it->remaining) == 0) {
+                    setField(it->field, 0);
+                    it = pending.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        return value;
+    }
+
+    void busWait(uint32_t words)
+    {
+        if (latencyNs == 0)
+            return;
+        auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(uint64_t(latencyNs)*words);
+        while (std::chrono::steady_clock::now() < end) {}
+    }
+
+    bool checkRange(memsvc_handle_t handle, uint32_t addr, uint32_t words)
+    {
+        for (uint32_t word = 0; word < words; ++word) {
+            if (regFile.find(addr+word) == regFile.end()) {
+                char msg[64];
+                snprintf(msg, sizeof(msg), "mock memsvc: no register at 0x%08x", addr+word);
+                handle->last_error = msg;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+extern "C" {
+
+int memsvc_open(memsvc_handle_t *handle)
+{
+    std::lock_guard<std::mutex> guard(mockMutex);
+    // the register file is loaded once per process, every module calls memhub_open
+    if (!mockLoaded) {
+        if (!loadAddressTable()) {
+            fprintf(stderr, "%s\n", mockError.c_str());
+            return -1;
+        }
+        loadScript();
+        mockLoaded = true;
+        fprintf(stderr, "mock memsvc: %zu nodes, %zu registers, %zu rules\n",
+                nodes.size(), regFile.size(), writeRules.size());
+    }
+    *handle = new memsvc_handle;
+    return 0;
+}
+
+int memsvc_close(memsvc_handle_t *handle)
+{
+    delete *handle;
+    *handle = nullptr;
+    return 0;
+}
+
+const char *memsvc_get_last_error(memsvc_handle_t handle)
+{
+    return handle ? handle->last_error.c_str() : mockError.c_str();
+}
+
+int memsvc_read(memsvc_handle_t handle, uint32_t addr, uint32_t words, uint32_t *data)
+{
+    std::lock_guard<std::mutex> guard(mockMutex);
+    if (!checkRange(handle, addr, words))
+        return -1;
+    for (uint32_t word = 0; word < words; ++word)
+        data[word] = readWord(addr+word);
+    busWait(words);
+    return 0;
+}
+
+int memsvc_write(memsvc_handle_t handle, uint32_t addr, uint32_t words, const uint32_t *data)
+{
+    std::lock_guard<std::mutex> guard(mockMutex);
+    if (!checkRange(handle, addr, words))
+        return -1;
+    for (uint32_t word = 0; word < words; ++word) {
+        auto fifo = fifos.find(addr+word);
+        if (fifo != fifos.end())
+            fifo->second.push_back(data[word]);
+        else
+            regFile[addr+word] = data[word];
+        applyWriteRules(addr+word);
+    }
+    busWait(words);
+    return 0;
+}
+
+}
@@ -0,0 +1,130 @@
+/*! \file mock/scan_bench.cxx
+ *  \brief Runs genScanLocal and the DAC scan loop against the simulated memsvc and reports their timing
+ *  \details Built by make bench together with the host modules (HOST=1) and the mock libmemsvc, see the README.
+ *           The address table is the one at $GEM_PATH/address_table.mdb and the register behaviour the one of the
+ *           mock, scripted by MEMSVC_MOCK_SCRIPT, so per-word bus latency can be added to approach the board timing.
+ *
+ *           The DAC scan is timed from dacScanLoopLocal(...) only: the DAC_SCAN_SETTLE_S wait of dacScanLocal(...) after the
+ *           VFATs are placed in run mode would otherwise hide the software time being measured.
+ *
+ *           Usage: scan_bench [-o ohN] [-m vfatMask] [-n nevts] [-s dacStep] [-r repetitions] [-p] [-v]
+ *             -p samples the VFATs in parallel in the DAC scan, -v prints the module log messages.
+ */
+
+#include "calibration_routines.h"
+#include "optohybrid.h"
+#include "utils.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
+
+// The logger and stdsprintf are provided by the rpcsvc core on the board
+static bool verbose = false;
+
+LogManager *LOGGER = nullptr;
+
+LogManager::LogManager(std::string logpathf, LogLevel output_level) :
+    logfd(stderr),
+    output_level(output_level),
+    ledstate(0)
+{
+}
+
+void LogManager::log_message(LogLevel level, std::string message)
+{
+    if (verbose || level <= ERROR)
+        fprintf(logfd, "%s\n", message.c_str());
+}
+
+std::string stdsprintf(const char *fmt, ...)
+{
+    va_list va;
+    va_start(va, fmt);
+    int len = vsnprintf(nullptr, 0, fmt, va);
+    va_end(va);
+
+    std::vector<char> buf(len+1);
+    va_start(va, fmt);
+    vsnprintf(buf.data(), buf.size(), fmt, va);
+    va_end(va);
+    return std::string(buf.data(), len);
+}
+
+template<typename F>
+static double timeMs(F && f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t ohN = 0, mask = 0, nevts = 100, dacStep = 1, repetitions = 1;
+    bool parallel = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:m:n:s:r:pv")) != -1) {
+        switch (opt) {
+            case 'o': ohN = strtoul(optarg, nullptr, 0); break;
+            case 'm': mask = strtoul(optarg, nullptr, 0); break;
+            case 'n': nevts = strtoul(optarg, nullptr, 0); break;
+            case 's': dacStep = strtoul(optarg, nullptr, 0); break;
+            case 'r': repetitions = strtoul(optarg, nullptr, 0); break;
+            case 'p': parallel = true; break;
+            case 'v': verbose = true; break;
+            default:
+                fprintf(stderr, "Usage: %s [-o ohN] [-m vfatMask] [-n nevts] [-s dacStep] [-r repetitions] [-p] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (dacStep == 0)
+        dacStep = 1;
+
+    LOGGER = new LogManager("stderr", LogManager::DEBUG);
+    if (memhub_open(&memsvc) != 0) {
+        fprintf(stderr, "Unable to connect to memory service: %s\n", memsvc_get_last_error(memsvc));
+        return 1;
+    }
+    if (!openAddressTable()) {
+        fprintf(stderr, "Unable to open the address table, check GEM_PATH\n");
+        return 1;
+    }
+
+    const uint32_t dacMin = 0, dacMax = 254, dacSelect = 1, nReads = 1;
+    std::vector<uint32_t> genScanData(24*(dacMax-dacMin+1)/dacStep);
+
+    for (uint32_t rep = 0; rep < repetitions; ++rep) {
+        RPCMsg msg;
+        RPCMsg *response = &msg;
+        GETLOCALARGS(response);
+
+        double genScanMs = timeMs([&]() {
+            genScanLocal(&la, genScanData.data(), ohN, mask, 0, true, true, 0, nevts, dacMin, dacMax, dacStep, "CAL_DAC", false, false);
+        });
+
+        //As dacScanLocal(...), without the settling wait
+        double dacScanMs = 0;
+        std::vector<DacScanLink> links(1);
+        if (dacScanCheckArgsLocal(&la, dacSelect, dacStep, nReads) && dacScanPrepareLocal(&la, links[0], ohN, mask, dacSelect, false)) {
+            dacScanMs = timeMs([&]() {
+                dacScanLoopLocal(&la, links, dacSelect, dacStep, nReads, parallel);
+            });
+            broadcastWriteLocal(&la, ohN, "CFG_RUN", 0x0, mask);
+        }
+        rtxn.abort();
+
+        if (response->get_key_exists("error")) {
+            fprintf(stderr, "Scan failed: %s\n", response->get_string("error").c_str());
+            return 1;
+        }
+        printf("repetition %u: genScan %.3f ms, dacScan loop %.3f ms\n", rep, genScanMs, dacScanMs);
+    }
+
+    memhub_close(&memsvc);
+    return 0;
+}
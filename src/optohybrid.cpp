@@ -419,7 +419,7 @@ void startScanModule(const RPCMsg *request, RPCMsg *response){
     rtxn.abort();
 } //End startScanModule(...)
 
-void getUltraScanResultsLocal(localArgs * la, uint32_t *outData, uint32_t ohN, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep){
+void getUltraScanResultsLocal(localArgs * la, uint32_t *outData, uint32_t ohN, uint32_t nevts, uint32_t dacMin, uint32_t dacMax, uint32_t dacStep, uint32_t minTrigRate){
     std::stringstream sstream;
     sstream<<ohN;
     std::string strOhN = sstream.str();
@@ -446,23 +446,32 @@ void getUltraScanResultsLocal(localArgs * la, uint32_t *outData, uint32_t ohN, u
                 );
     }
 
-    //Check if the scan is still running
-    while(readReg(la, scanBase + ".MONITOR.STATUS") > 0){
-        stdsprintf("OH %i: Ultra scan still running (0x%x), not returning results",ohN,
-                    readReg(la, scanBase + ".MONITOR.STATUS"));
+    //Wait for the scan to finish, latency scans report their progress meanwhile
+    RegHandle scanStatus = resolveReg(la, scanBase + ".MONITOR.STATUS");
+    RegHandle l1aSent    = resolveReg(la, "GEM_AMC.OH.OH" + strOhN + ".COUNTERS.T1.SENT.L1A");
+    auto scanDone = [&](uint32_t status) {
+        if (status == 0)
+            return true;
         if (bIsLatency){
-            if( (readReg(la, "GEM_AMC.OH.OH" + strOhN + ".COUNTERS.T1.SENT.L1A") - ohnL1A ) > numtrigs){
-                stdsprintf(
-                        "At Link %i: %d/%d L1As processed, %d%% done",
-                            ohN,
-                            readReg(la, "GEM_AMC.OH.OH" + strOhN + ".COUNTERS.T1.SENT.L1A") - ohnL1A_0,
-                            nevts*numtrigs,
-                            (readReg(la, "GEM_AMC.OH.OH" + strOhN + ".COUNTERS.T1.SENT.L1A") - ohnL1A_0)*100./(nevts*numtrigs)
-                        );
-                ohnL1A   =  readReg(la, "GEM_AMC.OH.OH" + strOhN + ".COUNTERS.T1.SENT.L1A");
+            uint32_t l1aCnt = readReg(la, l1aSent);
+            if( (l1aCnt - ohnL1A) > numtrigs){
+                LOGGER->log_message(LogManager::DEBUG, stdsprintf("At Link %i: %d/%d L1As processed, %d%% done",
+                            ohN, l1aCnt - ohnL1A_0, nevts*numtrigs, int((l1aCnt - ohnL1A_0)*100./(nevts*numtrigs))));
+                ohnL1A = l1aCnt;
             }
         }
-        sleep(0.1);
+        return false;
+    };
+
+    //Without a minimum trigger rate the scan is waited for without limit
+    std::chrono::microseconds scanTimeout = std::chrono::microseconds::max();
+    if (minTrigRate) {
+        uint64_t nTrigs = uint64_t(nevts) * ((dacMax-dacMin)/dacStep + 1);
+        scanTimeout = std::chrono::microseconds(1000000 + nTrigs*1000000/minTrigRate);
+    }
+    if (!waitForRegister(la, scanStatus, scanDone, waitDeadline(scanTimeout))) {
+        LOGGER->log_message(LogManager::ERROR, stdsprintf("OH %i: Ultra scan did not finish, not returning results",ohN));
+        return;
     }
 
     LOGGER->log_message(LogManager::DEBUG, "OH " + strOhN + ": getUltraScanResults(...)");
@@ -488,9 +497,10 @@ void getUltraScanResults(const RPCMsg *request, RPCMsg *response){
     uint32_t dacMin = request->get_word("dacMin");
     uint32_t dacMax = request->get_word("dacMax");
     uint32_t dacStep = request->get_word("dacStep");
+    uint32_t minTrigRate = request->get_key_exists("minTrigRate") ? request->get_word("minTrigRate") : 0;
 
     uint32_t outData[24*(dacMax-dacMin+1)/dacStep];
-    getUltraScanResultsLocal(&la, outData, ohN, nevts, dacMin, dacMax, dacStep);
+    getUltraScanResultsLocal(&la, outData, ohN, nevts, dacMin, dacMax, dacStep, minTrigRate);
     response->set_word_array("data",outData,24*(dacMax-dacMin+1)/dacStep);
 
     rtxn.abort();
@@ -565,16 +575,21 @@ void statusOHLocal(localArgs * la, uint32_t ohEnMask){
                            "CLOCKING.CLOCKING.LOGIC_MMCM_LOCKED",
                            "CLOCKING.CLOCKING.GBT_MMCM_UNLOCKED_CNT",
                            "CLOCKING.CLOCKING.LOGIC_MMCM_UNLOCKED_CNT"};
-    std::string regName;
+    const size_t nRegs = sizeof(regs)/sizeof(regs[0]);
+    std::vector<RegHandle> regHandles(nRegs);
+    uint32_t regValues[nRegs];
 
     for(int ohN = 0; ohN < 12; ohN++) if((ohEnMask >> ohN) & 0x1)
 
     {
         char regBase [100];
         sprintf(regBase, "GEM_AMC.OH.OH%i.",ohN);
-        for (auto &reg : regs) {
-            regName = std::string(regBase)+reg;
-            la->response->set_word(regName,readReg(la,regName));
+        for (size_t regIdx = 0; regIdx < nRegs; ++regIdx) {
+            regHandles[regIdx] = resolveReg(la, std::string(regBase)+regs[regIdx]);
+        }
+        readRegs(la, regHandles, regValues);
+        for (size_t regIdx = 0; regIdx < nRegs; ++regIdx) {
+            la->response->set_word(regHandles[regIdx].name, regValues[regIdx]);
         }
     }
 }
@@ -599,6 +614,7 @@ extern "C" {
             LOGGER->log_message(LogManager::ERROR, "Unable to load module");
             return; // Do not register our functions, we depend on memsvc.
         }
+        openAddressTable(); // retried on the first call if the address table is not available yet
         modmgr->register_method("optohybrid", "broadcastRead", broadcastRead);
         modmgr->register_method("optohybrid", "broadcastWrite", broadcastWrite);
         modmgr->register_method("optohybrid", "configureScanModule", configureScanModule);
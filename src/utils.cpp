@@ -1,18 +1,328 @@
 #include "utils.h"
+#include "utils/result_stream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
 
 memsvc_handle_t memsvc;
 
+namespace {
+  /// \var address table handles shared by every module loaded in this process
+  lmdb::env atEnv(nullptr);
+  lmdb::dbi atDbi(0);
+
+  /// \var reader transaction of each thread, LMDB ties a reader slot to the thread using it
+  thread_local lmdb::txn atRtxn(nullptr);
+
+  /// \var reader transaction state, the snapshot is held while rtxnDepth > 0
+  thread_local bool         rtxnActive = false;
+  thread_local unsigned int rtxnDepth  = 0;
+  thread_local size_t       rtxnTxnId  = 0;
+
+  /// \var value encoding of the table seen by the snapshot of this thread, see AddressTableFormat
+  thread_local uint32_t rtxnFormat      = AT_FORMAT_TEXT;
+  thread_local size_t   rtxnFormatTxnId = ~size_t(0); ///< rtxnTxnId of the snapshot rtxnFormat was read from
+
+  typedef std::unordered_map<std::string, RegInfo> RegInfoMap;
+
+  /// \var compiled register nodes, keyed by register name, filled one node at a time as registers are looked up
+  std::mutex regInfoCacheMutex;
+  std::shared_ptr<RegInfoMap> regInfoCache;
+  size_t regInfoCacheTxnId = 0; ///< last committed address table transaction the cache was filled from
+
+  /// \var cache used by this thread until its snapshot ends, keeps the RegInfo returned by getRegInfo alive
+  thread_local std::shared_ptr<RegInfoMap> threadRegInfoCache;
+
+  size_t lastAddressTableTxnId(lmdb::env & env = atEnv)
+  {
+    MDB_envinfo info;
+    lmdb::env_info(env.handle(), &info);
+    return info.me_last_txnid;
+  }
+
+  /// \brief Returns the AT_FORMAT_KEY of the table seen by txn, text if it has none
+  uint32_t readAddressTableFormat(MDB_txn *txn, lmdb::dbi & dbi)
+  {
+    lmdb::val key(AT_FORMAT_KEY);
+    lmdb::val value;
+    uint32_t format = AT_FORMAT_TEXT;
+    if (dbi.get(txn, key, value) && value.size() == sizeof(format))
+      std::memcpy(&format, value.data(), sizeof(format));
+    return format;
+  }
+
+  void renewReadTxn()
+  {
+    if (rtxnActive)
+      return;
+    if (!openAddressTable())
+      throw std::runtime_error("Unable to open address table");
+
+    // read before renewing, the snapshot is at least this recent
+    size_t txnid = lastAddressTableTxnId();
+    if (atRtxn.handle() == nullptr)
+      atRtxn = lmdb::txn::begin(atEnv, nullptr, MDB_RDONLY);
+    else
+      atRtxn.renew();
+    rtxnActive = true;
+    rtxnTxnId  = txnid;
+    threadRegInfoCache.reset();
+
+    // a new table may have a different format, which applies to this snapshot only
+    if (rtxnFormatTxnId != txnid) {
+      rtxnFormat      = readAddressTableFormat(atRtxn, atDbi);
+      rtxnFormatTxnId = txnid;
+    }
+
+    std::lock_guard<std::mutex> guard(regInfoCacheMutex);
+    // only a newer table replaces the shared cache, a thread on an older snapshot keeps a private one
+    if (regInfoCache && regInfoCacheTxnId < rtxnTxnId) {
+      LOGGER->log_message(LogManager::INFO, "Address table changed, dropping compiled register cache");
+      regInfoCache.reset();
+    }
+  }
+
+  void resetReadTxn()
+  {
+    if (!rtxnActive)
+      return;
+    atRtxn.reset();
+    rtxnActive = false;
+    threadRegInfoCache.reset();
+  }
+
+  uint8_t parseRegPerm(const char *perm)
+  {
+    uint8_t result = REG_PERM_NONE;
+    for (const char *c = perm; *c != '\0'; ++c) {
+      if (*c == 'r')
+        result |= REG_PERM_READ;
+      else if (*c == 'w')
+        result |= REG_PERM_WRITE;
+    }
+    return result;
+  }
+
+  uint8_t parseRegMode(const char *mode)
+  {
+    if (strstr(mode, "single"))
+      return REG_MODE_SINGLE;
+    else if (strstr(mode, "non-incremental"))
+      return REG_MODE_NON_INCREMENTAL;
+    else if (strstr(mode, "port"))
+      return REG_MODE_PORT;
+    else if (strstr(mode, "fifo"))
+      return REG_MODE_FIFO;
+    else if (strstr(mode, "incremental"))
+      return REG_MODE_INCREMENTAL;
+    else if (strstr(mode, "block"))
+      return REG_MODE_BLOCK;
+    return REG_MODE_UNKNOWN;
+  }
+
+  std::string regPermString(uint8_t perm)
+  {
+    std::string result;
+    if (perm & REG_PERM_READ)
+      result += "r";
+    if (perm & REG_PERM_WRITE)
+      result += "w";
+    return result;
+  }
+
+  std::string regModeString(uint8_t mode)
+  {
+    switch (mode) {
+    case REG_MODE_SINGLE:
+      return "single";
+    case REG_MODE_BLOCK:
+      return "block";
+    case REG_MODE_PORT:
+      return "port";
+    case REG_MODE_INCREMENTAL:
+      return "incremental";
+    case REG_MODE_NON_INCREMENTAL:
+      return "non-incremental";
+    case REG_MODE_FIFO:
+      return "fifo";
+    default:
+      return "";
+    }
+  }
+
+  uint32_t readRegNode(const RegInfo & reg, const std::string & regName)
+  {
+    if (!(reg.perm & REG_PERM_READ)) {
+      // response->set_string("error", std::string("No read permissions"));
+      LOGGER->log_message(LogManager::ERROR, stdsprintf("No read permissions for %s", regName.c_str()));
+      return 0xdeaddead;
+    }
+    uint32_t data[1];
+    if (memhub_read(memsvc, reg.address, 1, data) != 0) {
+      // response->set_string("error", std::string("memsvc error: ")+memsvc_get_last_error(memsvc));
+      LOGGER->log_message(LogManager::ERROR, stdsprintf("read memsvc error: %s", memsvc_get_last_error(memsvc)));
+      return 0xdeaddead;
+    }
+    if (reg.mask!=0xFFFFFFFF) {
+      return (data[0] & reg.mask) >> reg.shift;
+    } else {
+      return data[0];
+    }
+  }
+
+  void writeRegNode(localArgs * la, const RegInfo & reg, const std::string & regName, uint32_t value)
+  {
+    if (reg.mask==0xFFFFFFFF) {
+      writeAddress(reg, value, la->response);
+    } else {
+      uint32_t current_value = readAddress(reg, la->response);
+      if (current_value == 0xdeaddead) {
+        std::stringstream errmsg;
+        errmsg << "Writing masked register failed due to problem reading: " << regName;
+        la->response->set_string("error", errmsg.str());
+        LOGGER->log_message(LogManager::ERROR, errmsg.str().c_str());
+        return;
+      }
+      uint32_t val_to_write = value << reg.shift;
+      val_to_write = (val_to_write & reg.mask) | (current_value & ~reg.mask);
+      writeAddress(reg, val_to_write, la->response);
+    }
+  }
+
+  uint32_t saturateWord(uint64_t value)
+  {
+    return value > 0xffffffff ? 0xffffffff : value;
+  }
+
+  void addAccessStats(memhub_access_stats_t & sum, const memhub_access_stats_t & stats)
+  {
+    for (int kind = 0; kind < MEMHUB_ACCESS_KINDS; ++kind) {
+      sum.calls[kind]     += stats.calls[kind];
+      sum.words[kind]     += stats.words[kind];
+      sum.wait_ns[kind]   += stats.wait_ns[kind];
+      sum.memsvc_ns[kind] += stats.memsvc_ns[kind];
+      for (int bin = 0; bin < MEMHUB_STATS_HIST_BINS; ++bin) {
+        sum.wait_hist[kind][bin]   += stats.wait_hist[kind][bin];
+        sum.memsvc_hist[kind][bin] += stats.memsvc_hist[kind][bin];
+      }
+    }
+  }
+
+  /// \brief sets <prefix>.calls, .words, .wait_us, .memsvc_us as {read, write} and .wait_hist, .memsvc_hist as read bins followed by write bins
+  void setAccessStats(RPCMsg *response, const std::string & prefix, const memhub_access_stats_t & stats)
+  {
+    std::vector<uint32_t> calls, words, wait, memsvc, waitHist, memsvcHist;
+    for (int kind = 0; kind < MEMHUB_ACCESS_KINDS; ++kind) {
+      calls.push_back(saturateWord(stats.calls[kind]));
+      words.push_back(saturateWord(stats.words[kind]));
+      wait.push_back(saturateWord(stats.wait_ns[kind]/1000));
+      memsvc.push_back(saturateWord(stats.memsvc_ns[kind]/1000));
+      for (int bin = 0; bin < MEMHUB_STATS_HIST_BINS; ++bin) {
+        waitHist.push_back(saturateWord(stats.wait_hist[kind][bin]));
+        memsvcHist.push_back(saturateWord(stats.memsvc_hist[kind][bin]));
+      }
+    }
+    response->set_word_array(prefix+".calls",       calls);
+    response->set_word_array(prefix+".words",       words);
+    response->set_word_array(prefix+".wait_us",     wait);
+    response->set_word_array(prefix+".memsvc_us",   memsvc);
+    response->set_word_array(prefix+".wait_hist",   waitHist);
+    response->set_word_array(prefix+".memsvc_hist", memsvcHist);
+  }
+
+  /// \brief Returns the cache of the snapshot of this thread, to be called with regInfoCacheMutex held
+  /// \details The shared cache is used only if it was filled from the same snapshot, otherwise the thread gets a private map
+  std::shared_ptr<RegInfoMap> currentRegInfoCache(localArgs * la)
+  {
+    if (!threadRegInfoCache) {
+      if (!regInfoCache) {
+        regInfoCache      = std::make_shared<RegInfoMap>();
+        regInfoCacheTxnId = rtxnTxnId;
+      }
+      if (regInfoCacheTxnId == rtxnTxnId)
+        threadRegInfoCache = regInfoCache;
+      else
+        threadRegInfoCache = std::make_shared<RegInfoMap>();
+    }
+    return threadRegInfoCache;
+  }
+}
+
+bool openAddressTable()
+{
+  if (atEnv.handle() != nullptr)
+    return true;
+
+  const char *gem_path = std::getenv("GEM_PATH");
+  if (gem_path == nullptr) {
+    LOGGER->log_message(LogManager::ERROR, "Unable to open address table: GEM_PATH is not set");
+    return false;
+  }
+  std::string lmdb_area_file = std::string(gem_path)+"/address_table.mdb";
+  try {
+    auto env = lmdb::env::create();
+    env.set_mapsize(LMDB_SIZE);
+    env.open(lmdb_area_file.c_str(), 0, 0664);
+    auto rtxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    auto dbi  = lmdb::dbi::open(rtxn, nullptr);
+    rtxn.reset();
+    atEnv  = std::move(env);
+    atDbi  = std::move(dbi);
+    atRtxn = std::move(rtxn);  // the reader of the opening thread, other threads begin their own
+  } catch (const lmdb::error& e) {
+    LOGGER->log_message(LogManager::ERROR, stdsprintf("Unable to open address table %s: %s", lmdb_area_file.c_str(), e.what()));
+    return false;
+  }
+  rtxnActive = false;
+  rtxnDepth  = 0;
+  LOGGER->log_message(LogManager::INFO, stdsprintf("Opened address table %s", lmdb_area_file.c_str()));
+  return true;
+}
+
+lmdb::dbi & getAddressTableDbi()
+{
+  return atDbi;
+}
+
+ScopedReadTxn::ScopedReadTxn() :
+  m_active(false)
+{
+  renewReadTxn();
+  ++rtxnDepth;
+  m_active = true;
+}
+
+ScopedReadTxn::~ScopedReadTxn()
+{
+  abort();
+}
+
+void ScopedReadTxn::abort()
+{
+  if (!m_active)
+    return;
+  m_active = false;
+  if (rtxnDepth > 0 && --rtxnDepth == 0)
+    resetReadTxn();
+}
+
+ScopedReadTxn::operator lmdb::txn&()
+{
+  return atRtxn;
+}
+
 struct localArgs getLocalArgs(RPCMsg *response)
 {
-  auto env = lmdb::env::create();
-  env.set_mapsize(LMDB_SIZE);
-  std::string gem_path       = std::getenv("GEM_PATH");
-  std::string lmdb_data_file = gem_path+"/address_table.mdb";
-  env.open(lmdb_data_file.c_str(), 0, 0664);
-  auto rtxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
-  auto dbi  = lmdb::dbi::open(rtxn, nullptr);
-  struct localArgs la = {.rtxn     = rtxn,
-                         .dbi      = dbi,
+  renewReadTxn();
+  struct localArgs la = {.rtxn     = atRtxn,
+                         .dbi      = atDbi,
                          .response = response};
   return la;
 }
@@ -35,14 +345,131 @@ std::string serialize(xhal::utils::Node n)
   return node.str();
 }
 
+RegRecord serializeRecord(const xhal::utils::Node & n)
+{
+  RegRecord record;
+  record.address  = n.real_address;
+  record.mask     = n.mask;
+  record.size     = n.size;
+  record.shift    = n.mask ? __builtin_ctz(n.mask) : 0;
+  record.perm     = parseRegPerm(n.permission.c_str());
+  record.mode     = parseRegMode(n.mode.c_str());
+  record.reserved = 0;
+  return record;
+}
+
+bool parseRegInfo(const lmdb::val & db_res, RegInfo & info)
+{
+  if (rtxnFormat == AT_FORMAT_BINARY) {
+    if (db_res.size() != sizeof(RegRecord))
+      return false;
+    const RegRecord *record = reinterpret_cast<const RegRecord*>(db_res.data());
+    info.address = record->address;
+    info.mask    = record->mask;
+    info.shift   = record->shift;
+    info.size    = record->size;
+    info.perm    = record->perm;
+    info.mode    = record->mode;
+    return true;
+  }
+
+  // text layout: address|permission|mask|mode|size, address, mask and size in hex
+  char buf[128];
+  if (db_res.size() >= sizeof(buf))
+    return false;
+  std::copy(db_res.data(), db_res.data()+db_res.size(), buf);
+  buf[db_res.size()] = '\0';
+
+  char *fields[5];
+  size_t nfields = 0;
+  fields[nfields++] = buf;
+  for (char *c = buf; *c != '\0'; ++c) {
+    if (*c == '|') {
+      if (nfields == 5)
+        return false;
+      *c = '\0';
+      fields[nfields++] = c+1;
+    }
+  }
+  if (nfields != 5)
+    return false;
+
+  info.address = strtoul(fields[0], nullptr, 16);
+  info.perm    = parseRegPerm(fields[1]);
+  info.mask    = strtoul(fields[2], nullptr, 16);
+  info.mode    = parseRegMode(fields[3]);
+  info.size    = strtoul(fields[4], nullptr, 16);
+  info.shift   = info.mask ? __builtin_ctz(info.mask) : 0;
+  return true;
+}
+
+const RegInfo * getRegInfo(localArgs * la, const std::string & regName)
+{
+  // the map is node based, so the RegInfo of a node stays in place when other nodes are added
+  std::lock_guard<std::mutex> guard(regInfoCacheMutex);
+  std::shared_ptr<RegInfoMap> cache = currentRegInfoCache(la);
+  auto node = cache->find(regName);
+  if (node != cache->end())
+    return &(node->second);
+
+  lmdb::val key(regName);
+  lmdb::val value;
+  if (!la->dbi.get(la->rtxn, key, value))
+    return nullptr;
+  RegInfo info;
+  if (!parseRegInfo(value, info)) {
+    LOGGER->log_message(LogManager::WARNING, stdsprintf("Unable to decode address table node %s", regName.c_str()));
+    return nullptr;
+  }
+  return &(cache->emplace(regName, info).first->second);
+}
+
+std::string formatRegName(const std::string & pattern, const std::vector<uint32_t> & indices)
+{
+  std::string regName;
+  regName.reserve(pattern.size()+2*indices.size());
+  size_t idx = 0;
+  size_t pos = 0;
+  size_t placeholder;
+  while ((placeholder = pattern.find("{}", pos)) != std::string::npos) {
+    regName.append(pattern, pos, placeholder-pos);
+    if (idx < indices.size())
+      regName += std::to_string(indices[idx++]);
+    else
+      regName += "{}";
+    pos = placeholder+2;
+  }
+  regName.append(pattern, pos, std::string::npos);
+  return regName;
+}
+
+RegHandle resolveReg(localArgs * la, const std::string & regName)
+{
+  RegHandle handle;
+  handle.name = regName;
+  const RegInfo *reg = getRegInfo(la, regName);
+  if (reg) {
+    handle.info  = *reg;
+    handle.valid = true;
+  } else {
+    LOGGER->log_message(LogManager::ERROR, stdsprintf("Key: %s is NOT found", regName.c_str()));
+    handle.info  = RegInfo();
+    handle.valid = false;
+  }
+  return handle;
+}
+
+void invalidateRegInfoCache()
+{
+  std::lock_guard<std::mutex> guard(regInfoCacheMutex);
+  regInfoCache.reset();
+  threadRegInfoCache.reset();
+}
+
 void update_address_table(const RPCMsg *request, RPCMsg *response)
 {
   LOGGER->log_message(LogManager::INFO, "START UPDATE ADDRESS TABLE");
   std::string at_xml = request->get_string("at_xml");
-  std::string gem_path = std::getenv("GEM_PATH");
-  std::string lmdb_data_file = gem_path+"/address_table.mdb/data.mdb";
-  std::string lmdb_lock_file = gem_path+"/address_table.mdb/lock.mdb";
-  std::string lmdb_area_file = gem_path+"/address_table.mdb";
   xhal::utils::XHALXMLParser * m_parser = new xhal::utils::XHALXMLParser(at_xml.c_str());
   try {
     m_parser->setLogLevel(0);
@@ -58,37 +485,39 @@ void update_address_table(const RPCMsg *request, RPCMsg *response)
   m_parsed_at.erase("top");
   xhal::utils::Node t_node;
 
-  // Remove old DB
-  LOGGER->log_message(LogManager::INFO, "REMOVE OLD DB");
-  std::remove(lmdb_data_file.c_str());
-  std::remove(lmdb_lock_file.c_str());
-
-  auto env = lmdb::env::create();
-  env.set_mapsize(LMDB_SIZE);
-  env.open(lmdb_area_file.c_str(), 0, 0664);
-
-  LOGGER->log_message(LogManager::INFO, "LMDB ENV OPEN");
+  // The environment stays open in every process that loaded the modules, so the table is rewritten in place
+  // rather than removing the files from under them. Readers pick up the new table when they renew their transaction
+  if (!openAddressTable()) {
+    response->set_string("error", "Unable to open address table");
+    return;
+  }
 
   lmdb::val key;
   lmdb::val value;
-  auto wtxn = lmdb::txn::begin(env);
-  auto dbi  = lmdb::dbi::open(wtxn, nullptr);
+  auto wtxn = lmdb::txn::begin(atEnv);
+
+  LOGGER->log_message(LogManager::INFO, "REMOVE OLD DB");
+  atDbi.drop(wtxn);
 
   LOGGER->log_message(LogManager::INFO, "START ITERATING OVER MAP");
 
   std::string t_key;
-  std::string t_value;
+  RegRecord t_value;
   for (auto it:m_parsed_at) {
     t_key = it.first;
     t_node = it.second;
-    t_value = serialize(t_node);
+    t_value = serializeRecord(t_node);
     key.assign(t_key);
-    value.assign(t_value);
-    dbi.put(wtxn, key, value);
+    value.assign(&t_value, sizeof(t_value));
+    atDbi.put(wtxn, key, value);
   }
+  const uint32_t format = AT_FORMAT_BINARY;
+  key.assign(AT_FORMAT_KEY);
+  value.assign(&format, sizeof(format));
+  atDbi.put(wtxn, key, value);
   wtxn.commit();
   LOGGER->log_message(LogManager::INFO, "COMMIT DB");
-  wtxn.abort();
+  invalidateRegInfoCache();
 }
 
 void readRegFromDB(const RPCMsg *request, RPCMsg *response)
@@ -97,22 +526,14 @@ void readRegFromDB(const RPCMsg *request, RPCMsg *response)
 
   GETLOCALARGS(response);
 
-  LOGGER->log_message(LogManager::INFO, "LMDB ENV OPEN");
-  lmdb::val key;
-  lmdb::val value;
-
-  key.assign(regName.c_str());
-  bool found = dbi.get(rtxn,key,value);
-  if (found) {
+  const RegInfo *reg = getRegInfo(&la, regName);
+  if (reg) {
     LOGGER->log_message(LogManager::INFO, stdsprintf("Key: %s is found", regName.c_str()));
-    std::string t_value = std::string(value.data());
-    t_value = t_value.substr(0,value.size());
-    std::vector<std::string> tmp = split(t_value,'|');
-    uint32_t raddr = stoull(tmp[0], nullptr, 16);
-    uint32_t rmask = stoull(tmp[2], nullptr, 16);
-    uint32_t rsize = stoull(tmp[4], nullptr, 16);
-    std::string rperm = tmp[1];
-    std::string rmode = tmp[3];
+    uint32_t raddr = reg->address;
+    uint32_t rmask = reg->mask;
+    uint32_t rsize = reg->size;
+    std::string rperm = regPermString(reg->perm);
+    std::string rmode = regModeString(reg->mode);
     LOGGER->log_message(LogManager::DEBUG, stdsprintf("node %s properties: 0x%x  0x%x  0x%x  %s  %s",
                                                       regName.c_str(), raddr, rmask, rsize, rmode.c_str(), rperm.c_str()));
 
@@ -128,6 +549,65 @@ void readRegFromDB(const RPCMsg *request, RPCMsg *response)
   rtxn.abort();
 }
 
+void memhubStats(const RPCMsg *request, RPCMsg *response)
+{
+  const memhub_stats_table_t *table = memhub_get_stats_table();
+  if (table == nullptr) {
+    LOGGER->log_message(LogManager::ERROR, "memhub statistics segment is not available");
+    response->set_string("error", "memhub statistics segment is not available");
+    return;
+  }
+
+  // Lock backend of this process
+  memhub_lock_stats_t lockStats;
+  memhub_lock_get_stats(&lockStats);
+  response->set_word("lock.acquisitions",   saturateWord(lockStats.acquisitions));
+  response->set_word("lock.contended",      saturateWord(lockStats.contended));
+  response->set_word("lock.owner_deaths",   saturateWord(lockStats.owner_deaths));
+  response->set_word("lock.wait_us",        saturateWord(lockStats.total_wait_ns/1000));
+  response->set_word("lock.max_wait_us",    saturateWord(lockStats.max_wait_ns/1000));
+  response->set_word("lock.hold_us",        saturateWord(lockStats.total_hold_ns/1000));
+  response->set_word("lock.max_hold_us",    saturateWord(lockStats.max_hold_ns/1000));
+  response->set_word("lock.lease_yields",   saturateWord(lockStats.lease_yields));
+  response->set_word("lock.lease_handoffs", saturateWord(lockStats.lease_handoffs));
+
+  // Contexts claimed concurrently by two processes may appear twice in the table
+  std::map<std::string, memhub_access_stats_t> contexts;
+  for (int i = 0; i < MEMHUB_STATS_CONTEXTS; ++i) {
+    const memhub_stats_slot_t & slot = table->contexts[i];
+    if (__atomic_load_n(&slot.state, __ATOMIC_ACQUIRE) != 2)
+      continue;
+    std::string name(slot.name, strnlen(slot.name, MEMHUB_STATS_NAME_LEN));
+    auto ctx = contexts.find(name);
+    if (ctx == contexts.end())
+      contexts.emplace(name, slot.stats);
+    else
+      addAccessStats(ctx->second, slot.stats);
+  }
+  std::vector<std::string> contextNames;
+  for (auto const& ctx : contexts) {
+    contextNames.push_back(ctx.first);
+    setAccessStats(response, ctx.first, ctx.second);
+  }
+  response->set_string_array("contexts", contextNames);
+
+  std::vector<std::string> processNames;
+  for (int i = 0; i < MEMHUB_STATS_PROCESSES; ++i) {
+    const memhub_stats_slot_t & slot = table->processes[i];
+    if (__atomic_load_n(&slot.state, __ATOMIC_ACQUIRE) != 2)
+      continue;
+    std::string name(slot.name, strnlen(slot.name, MEMHUB_STATS_NAME_LEN));
+    processNames.push_back(name);
+    setAccessStats(response, name, slot.stats);
+  }
+  response->set_string_array("processes", processNames);
+
+  if (request->get_key_exists("reset") && request->get_word("reset")) {
+    LOGGER->log_message(LogManager::INFO, "Resetting memhub statistics");
+    memhub_reset_stats();
+  }
+}
+
 uint32_t getNumNonzeroBits(uint32_t value)
 {
   // https://stackoverflow.com/questions/4244274/how-do-i-count-the-number-of-zero-bits-in-an-integer
@@ -143,16 +623,10 @@ uint32_t getNumNonzeroBits(uint32_t value)
 
 uint32_t getMask(localArgs * la, const std::string & regName)
 {
-  lmdb::val key, db_res;
-  bool found=false;
-  key.assign(regName.c_str());
-  found = la->dbi.get(la->rtxn,key,db_res);
+  const RegInfo *reg = getRegInfo(la, regName);
   uint32_t rmask = 0x0;
-  if (found) {
-    std::string t_db_res = std::string(db_res.data());
-    t_db_res = t_db_res.substr(0,db_res.size());
-    std::vector<std::string> tmp = split(t_db_res,'|');
-    rmask = stoull(tmp[2], nullptr, 16);
+  if (reg) {
+    rmask = reg->mask;
   } else {
     LOGGER->log_message(LogManager::ERROR, stdsprintf("Key: %s is NOT found", regName.c_str()));
     la->response->set_string("error", "Register not found");
@@ -182,33 +656,31 @@ uint32_t readRawAddress(uint32_t address, RPCMsg* response)
 
 uint32_t getAddress(localArgs * la, const std::string & regName)
 {
-  lmdb::val key, db_res;
-  bool found;
-  key.assign(regName.c_str());
-  found = la->dbi.get(la->rtxn,key,db_res);
-  uint32_t raddr;
-  if (found){
-    std::string t_db_res = std::string(db_res.data());
-    t_db_res = t_db_res.substr(0,db_res.size());
-    std::vector<std::string> tmp = split(t_db_res,'|');
-    raddr = stoull(tmp[0], nullptr, 16);
-  } else {
+  const RegInfo *reg = getRegInfo(la, regName);
+  if (!reg) {
     LOGGER->log_message(LogManager::ERROR, stdsprintf("Key: %s is NOT found", regName.c_str()));
     la->response->set_string("error", "Register not found");
     return 0xdeaddead;
   }
-  return raddr;
+  return reg->address;
 }
 
 void writeAddress(lmdb::val & db_res, uint32_t value, RPCMsg *response)
 {
-  std::string t_db_res = std::string(db_res.data());
-  t_db_res = t_db_res.substr(0,db_res.size());
-  std::vector<std::string> tmp = split(t_db_res,'|');
+  RegInfo reg;
+  if (!parseRegInfo(db_res, reg)) {
+    response->set_string("error", "Unable to decode address table node");
+    LOGGER->log_message(LogManager::ERROR, "Unable to decode address table node");
+    return;
+  }
+  writeAddress(reg, value, response);
+}
+
+void writeAddress(const RegInfo & reg, uint32_t value, RPCMsg *response)
+{
   uint32_t data[1];
-  uint32_t raddr = stoull(tmp[0], nullptr, 16);
   data[0] = value;
-  if (memhub_write(memsvc, raddr, 1, data) != 0) {
+  if (memhub_write(memsvc, reg.address, 1, data) != 0) {
     response->set_string("error", std::string("memsvc error: ")+memsvc_get_last_error(memsvc));
     LOGGER->log_message(LogManager::INFO, stdsprintf("write memsvc error: %s", memsvc_get_last_error(memsvc)));
   }
@@ -216,17 +688,24 @@ void writeAddress(lmdb::val & db_res, uint32_t value, RPCMsg *response)
 
 uint32_t readAddress(lmdb::val & db_res, RPCMsg *response)
 {
-  std::string t_db_res = std::string(db_res.data());
-  t_db_res = t_db_res.substr(0,db_res.size());
-  std::vector<std::string> tmp = split(t_db_res,'|');
+  RegInfo reg;
+  if (!parseRegInfo(db_res, reg)) {
+    response->set_string("error", "Unable to decode address table node");
+    LOGGER->log_message(LogManager::ERROR, "Unable to decode address table node");
+    return 0xdeaddead;
+  }
+  return readAddress(reg, response);
+}
+
+uint32_t readAddress(const RegInfo & reg, RPCMsg *response)
+{
   uint32_t data[1];
-  uint32_t raddr = stoull(tmp[0], nullptr, 16);
   int n_current_tries = 0;
   while (true) {
-    if (memhub_read(memsvc, raddr, 1, data) != 0) {
+    if (memhub_read(memsvc, reg.address, 1, data) != 0) {
       if (n_current_tries < 9) {
         n_current_tries++;
-        LOGGER->log_message(LogManager::ERROR, stdsprintf("Reading reg %08X failed %i times.", raddr, n_current_tries));
+        LOGGER->log_message(LogManager::ERROR, stdsprintf("Reading reg %08X failed %i times.", reg.address, n_current_tries));
       } else {
         response->set_string("error", std::string("memsvc error: ")+memsvc_get_last_error(memsvc));
         LOGGER->log_message(LogManager::ERROR, stdsprintf("read memsvc error: %s failed 10 times", memsvc_get_last_error(memsvc)));
@@ -241,11 +720,9 @@ uint32_t readAddress(lmdb::val & db_res, RPCMsg *response)
 
 void writeRawReg(localArgs * la, const std::string & regName, uint32_t value)
 {
-  lmdb::val key, db_res;
-  key.assign(regName.c_str());
-  bool found = la->dbi.get(la->rtxn,key,db_res);
-  if (found) {
-    writeAddress(db_res, value, la->response);
+  const RegInfo *reg = getRegInfo(la, regName);
+  if (reg) {
+    writeAddress(*reg, value, la->response);
   } else {
     LOGGER->log_message(LogManager::ERROR, stdsprintf("Key: %s is NOT found", regName.c_str()));
     la->response->set_string("error", "Register not found");
@@ -254,11 +731,9 @@ void writeRawReg(localArgs * la, const std::string & regName, uint32_t value)
 
 uint32_t readRawReg(localArgs * la, const std::string & regName)
 {
-  lmdb::val key, db_res;
-  key.assign(regName.c_str());
-  bool found = la->dbi.get(la->rtxn,key,db_res);
-  if (found) {
-    return readAddress(db_res, la->response);
+  const RegInfo *reg = getRegInfo(la, regName);
+  if (reg) {
+    return readAddress(*reg, la->response);
   } else {
     LOGGER->log_message(LogManager::ERROR, stdsprintf("Key: %s is NOT found", regName.c_str()));
     la->response->set_string("error", "Register not found");
@@ -282,32 +757,9 @@ uint32_t applyMask(uint32_t data, uint32_t mask)
 
 uint32_t readReg(localArgs * la, const std::string & regName)
 {
-  lmdb::val key, db_res;
-  key.assign(regName.c_str());
-  bool found = la->dbi.get(la->rtxn,key,db_res);
-  if (found) {
-    std::string t_db_res = std::string(db_res.data());
-    t_db_res = t_db_res.substr(0,db_res.size());
-    std::vector<std::string> tmp = split(t_db_res,'|');
-    std::size_t found = tmp[1].find_first_of("r");
-    if (found==std::string::npos) {
-      // response->set_string("error", std::string("No read permissions"));
-      LOGGER->log_message(LogManager::ERROR, stdsprintf("No read permissions for %s: %s", regName.c_str(), tmp[1].c_str()));
-      return 0xdeaddead;
-    }
-    uint32_t data[1];
-    uint32_t raddr = stoull(tmp[0], nullptr, 16);
-    uint32_t rmask = stoull(tmp[2], nullptr, 16);
-    if (memhub_read(memsvc, raddr, 1, data) != 0) {
-      // response->set_string("error", std::string("memsvc error: ")+memsvc_get_last_error(memsvc));
-      LOGGER->log_message(LogManager::ERROR, stdsprintf("read memsvc error: %s", memsvc_get_last_error(memsvc)));
-      return 0xdeaddead;
-    }
-    if (rmask!=0xFFFFFFFF) {
-      return applyMask(data[0],rmask);
-    } else {
-      return data[0];
-    }
+  const RegInfo *reg = getRegInfo(la, regName);
+  if (reg) {
+    return readRegNode(*reg, regName);
   } else {
     // response->set_string("error", "Register not found");
     LOGGER->log_message(LogManager::ERROR, stdsprintf("Key: %s is NOT found", regName.c_str()));
@@ -315,50 +767,105 @@ uint32_t readReg(localArgs * la, const std::string & regName)
   }
 }
 
+uint32_t readReg(localArgs * la, const RegHandle & reg)
+{
+  if (reg.valid) {
+    return readRegNode(reg.info, reg.name);
+  } else {
+    LOGGER->log_message(LogManager::ERROR, stdsprintf("Key: %s is NOT found", reg.name.c_str()));
+    return 0xdeaddead;
+  }
+}
+
+uint32_t readRegs(localArgs * la, const std::vector<RegHandle> & regs, uint32_t * result)
+{
+  // indices of the readable registers, in address order
+  std::vector<size_t> order;
+  order.reserve(regs.size());
+  for (size_t i = 0; i < regs.size(); ++i) {
+    result[i] = 0xdeaddead;
+    if (!regs[i].valid) {
+      LOGGER->log_message(LogManager::ERROR, stdsprintf("Key: %s is NOT found", regs[i].name.c_str()));
+    } else if (!(regs[i].info.perm & REG_PERM_READ)) {
+      LOGGER->log_message(LogManager::ERROR, stdsprintf("No read permissions for %s", regs[i].name.c_str()));
+    } else {
+      order.push_back(i);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&regs](size_t a, size_t b) {
+      return regs[a].info.address < regs[b].info.address;
+    });
+
+  uint32_t nread = 0;
+  std::vector<uint32_t> data;
+  memhub_lock();
+  size_t first = 0;
+  while (first < order.size()) {
+    // extend the transfer while the next register shares or directly follows the last address
+    const RegInfo & start = regs[order[first]].info;
+    uint32_t words = 1;
+    size_t last = first+1;
+    if (!regModeIsPort(start.mode)) {
+      while (last < order.size()) {
+        const RegInfo & next = regs[order[last]].info;
+        if (regModeIsPort(next.mode) || next.address > start.address+words)
+          break;
+        words = next.address-start.address+1;
+        ++last;
+      }
+    }
+
+    data.resize(words);
+    if (memhub_read(memsvc, start.address, words, data.data()) != 0) {
+      LOGGER->log_message(LogManager::ERROR, stdsprintf("read memsvc error: %s", memsvc_get_last_error(memsvc)));
+    } else {
+      for (size_t i = first; i < last; ++i) {
+        const RegInfo & reg = regs[order[i]].info;
+        uint32_t value = data[reg.address-start.address];
+        result[order[i]] = (reg.mask != 0xFFFFFFFF) ? (value & reg.mask) >> reg.shift : value;
+        ++nread;
+      }
+    }
+    first = last;
+  }
+  memhub_unlock();
+  return nread;
+}
+
 uint32_t readBlock(localArgs* la, const std::string& regName, uint32_t* result, const uint32_t& size, const uint32_t& offset)
 {
-  lmdb::val key, db_res;
-  key.assign(regName.c_str());
-  bool found = la->dbi.get(la->rtxn,key,db_res);
-  if (found) {
-    std::string t_db_res = std::string(db_res.data());
-    t_db_res = t_db_res.substr(0,db_res.size());
-    std::vector<std::string> tmp = split(t_db_res,'|');
-    uint32_t raddr = stoull(tmp[0], nullptr, 16);
-    uint32_t rmask = stoull(tmp[2], nullptr, 16);
-    uint32_t rsize = stoull(tmp[4], nullptr, 16);
-    std::string rperm = tmp[1];
-    std::string rmode = tmp[3];
-    LOGGER->log_message(LogManager::DEBUG, stdsprintf("node %s properties: 0x%x  0x%x  0x%x  %s  %s",
-                                                      regName.c_str(), raddr, rmask, rsize, rmode.c_str(), rperm.c_str()));
+  const RegInfo *reg = getRegInfo(la, regName);
+  if (reg) {
+    LOGGER->log_message(LogManager::DEBUG, stdsprintf("node %s properties: 0x%x  0x%x  0x%x  %d  %d",
+                                                      regName.c_str(), reg->address, reg->mask, reg->size, reg->mode, reg->perm));
 
-    if (rmask != 0xFFFFFFFF) {
+    if (reg->mask != 0xFFFFFFFF) {
       // deny block read on masked register, but what if mask is None?
       std::stringstream errmsg;
       errmsg << "Block read attempted on masked register";
       la->response->set_string("error", errmsg.str());
       LOGGER->log_message(LogManager::ERROR, stdsprintf("block read error: %s", errmsg.str().c_str()));
       // throw std::range_error(errmsg.str());
-    } else if (rmode.rfind("single") != std::string::npos && size > 1) {
+    } else if (reg->mode == REG_MODE_SINGLE && size > 1) {
       // only allow block read of size 1 on single registers?
       std::stringstream errmsg;
       errmsg << "Block read attempted on single register with size greater than 1";
       la->response->set_string("error", errmsg.str());
       LOGGER->log_message(LogManager::ERROR, stdsprintf("block read error: %s", errmsg.str().c_str()));
       // throw std::range_error(errmsg.str());
-    } else if ((offset+size) > rsize) {
+    } else if ((offset+size) > reg->size) {
       // don't allow the read to go beyond the range
       std::stringstream errmsg;
       errmsg << "Block read attempted would go beyond the size of the RAM: "
-             << "raddr: 0x"    << std::hex << raddr
+             << "raddr: 0x"    << std::hex << reg->address
              << ", offset: 0x" << std::hex << offset
              << ", size: 0x"   << std::hex << size
-             << ", rsize: 0x"  << std::hex << rsize;
+             << ", rsize: 0x"  << std::hex << reg->size;
       la->response->set_string("error", errmsg.str());
       LOGGER->log_message(LogManager::ERROR, stdsprintf("block read error: %s", errmsg.str().c_str()));
       // throw std::range_error(errmsg.str());
     } else {
-      if (memhub_read(memsvc, raddr+offset, size, result) != 0) {
+      if (memhub_read(memsvc, reg->address+offset, size, result) != 0) {
         std::stringstream errmsg;
         errmsg << "Read memsvc error: " << memsvc_get_last_error(memsvc);
         la->response->set_string("error", errmsg.str());
@@ -384,39 +891,9 @@ uint32_t readBlock(const uint32_t& regAddr, uint32_t* result, const uint32_t& si
 
 void writeReg(localArgs * la, const std::string & regName, uint32_t value)
 {
-  lmdb::val key, db_res;
-  key.assign(regName.c_str());
-  bool found = la->dbi.get(la->rtxn,key,db_res);
-  if (found) {
-    std::string t_db_res = std::string(db_res.data());
-    t_db_res = t_db_res.substr(0,db_res.size());
-    std::vector<std::string> tmp = split(t_db_res,'|');
-    uint32_t rmask = stoull(tmp[2], nullptr, 16);
-    if (rmask==0xFFFFFFFF) {
-      writeAddress(db_res, value, la->response);
-    } else {
-      uint32_t current_value = readAddress(db_res, la->response);
-      if (current_value == 0xdeaddead) {
-        std::stringstream errmsg;
-        errmsg << "Writing masked register failed due to problem reading: " << regName;
-        la->response->set_string("error", errmsg.str());
-        LOGGER->log_message(LogManager::ERROR, errmsg.str().c_str());
-        return;
-      }
-      int shift_amount = 0;
-      uint32_t mask_copy = rmask;
-      for (int i = 0; i < 32; i++) {
-        if (rmask & 1) {
-          break;
-        } else {
-          shift_amount +=1;
-          rmask = rmask >> 1;
-        }
-      }
-      uint32_t val_to_write = value << shift_amount;
-      val_to_write = (val_to_write & mask_copy) | (current_value & ~mask_copy);
-      writeAddress(db_res, val_to_write, la->response);
-    }
+  const RegInfo *reg = getRegInfo(la, regName);
+  if (reg) {
+    writeRegNode(la, *reg, regName, value);
   } else {
     std::stringstream errmsg;
     errmsg << "Register " << regName << " key not found";
@@ -425,47 +902,161 @@ void writeReg(localArgs * la, const std::string & regName, uint32_t value)
   }
 }
 
+void writeReg(localArgs * la, const RegHandle & reg, uint32_t value)
+{
+  if (reg.valid) {
+    writeRegNode(la, reg.info, reg.name, value);
+  } else {
+    std::stringstream errmsg;
+    errmsg << "Register " << reg.name << " key not found";
+    la->response->set_string("error", errmsg.str());
+    LOGGER->log_message(LogManager::ERROR, errmsg.str().c_str());
+  }
+}
+
+RegWriteBatch::RegWriteBatch(localArgs * la) :
+  m_la(la)
+{
+}
+
+void RegWriteBatch::add(const RegHandle & reg, uint32_t value)
+{
+  if (!reg.valid) {
+    std::stringstream errmsg;
+    errmsg << "Register " << reg.name << " key not found";
+    m_la->response->set_string("error", errmsg.str());
+    LOGGER->log_message(LogManager::ERROR, errmsg.str().c_str());
+    return;
+  }
+  m_writes.push_back(std::make_pair(reg, value));
+}
+
+void RegWriteBatch::add(const std::string & regName, uint32_t value)
+{
+  add(resolveReg(m_la, regName), value);
+}
+
+uint32_t RegWriteBatch::commit()
+{
+  // fields grouped by word, the words in the order their first field was added and the fields of a word in the order they were added
+  std::vector<std::vector<size_t> > words;
+  std::unordered_map<uint32_t, size_t> wordIdx;
+  for (size_t i = 0; i < m_writes.size(); ++i) {
+    auto word = wordIdx.emplace(m_writes[i].first.info.address, words.size());
+    if (word.second)
+      words.emplace_back();
+    words[word.first->second].push_back(i);
+  }
+
+  uint32_t nwords = 0;
+  memhub_lock();
+  for (auto const& fields : words) {
+    const RegInfo & word = m_writes[fields.front()].first.info;
+    uint32_t mask = 0x0;
+    for (size_t i : fields)
+      mask |= m_writes[i].first.info.mask;
+
+    uint32_t value = 0x0;
+    if (mask != 0xFFFFFFFF) {
+      value = readAddress(word, m_la->response);
+      if (value == 0xdeaddead) {
+        std::stringstream errmsg;
+        errmsg << "Writing masked register failed due to problem reading: " << m_writes[fields.front()].first.name;
+        m_la->response->set_string("error", errmsg.str());
+        LOGGER->log_message(LogManager::ERROR, errmsg.str().c_str());
+        continue;
+      }
+    }
+    for (size_t i : fields) {
+      const RegInfo & reg = m_writes[i].first.info;
+      value = ((m_writes[i].second << reg.shift) & reg.mask) | (value & ~reg.mask);
+    }
+    writeAddress(word, value, m_la->response);
+    ++nwords;
+  }
+  memhub_unlock();
+
+  m_writes.clear();
+  return nwords;
+}
+
+bool waitForRegister(LocalArgs * la, const RegHandle & reg, const std::function<bool(uint32_t)> & predicate,
+                     std::chrono::steady_clock::time_point deadline)
+{
+  const auto start = std::chrono::steady_clock::now();
+  std::chrono::microseconds backoff(1);
+  // The back to back polls are made under one lease, released before the first sleep
+  MemhubLease lease;
+  while (true) {
+    uint32_t value = readReg(la, reg);
+    if (value == 0xdeaddead) {
+      std::string errmsg = stdsprintf("Unable to read %s while waiting on it", reg.name.c_str());
+      la->response->set_string("error", errmsg);
+      LOGGER->log_message(LogManager::ERROR, errmsg);
+      return false;
+    }
+    if (predicate(value))
+      return true;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) {
+      std::string errmsg = stdsprintf("Timed out after %lld us waiting for %s, last value 0x%08x", static_cast<long long>(
+                                        std::chrono::duration_cast<std::chrono::microseconds>(now-start).count()),
+                                      reg.name.c_str(), value);
+      la->response->set_string("error", errmsg);
+      LOGGER->log_message(LogManager::ERROR, errmsg);
+      return false;
+    }
+    if (now-start < std::chrono::microseconds(WAIT_SPIN_US)) {
+      lease.yield();
+      continue;
+    }
+
+    lease.release();
+    std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(backoff, deadline-now));
+    backoff = std::min(backoff*2, std::chrono::microseconds(WAIT_MAX_SLEEP_US));
+  }
+}
+
+std::chrono::steady_clock::time_point waitDeadline(std::chrono::microseconds timeout)
+{
+  const auto now = std::chrono::steady_clock::now();
+  if (timeout >= std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::time_point::max()-now))
+    return std::chrono::steady_clock::time_point::max();
+  return now+timeout;
+}
+
 void writeBlock(localArgs* la, const std::string& regName, const uint32_t* values, const uint32_t& size, const uint32_t& offset)
 {
-  lmdb::val key, db_res;
-  key.assign(regName.c_str());
-  bool found = la->dbi.get(la->rtxn,key,db_res);
-  if (found) {
-    std::string t_db_res = std::string(db_res.data());
-    t_db_res = t_db_res.substr(0,db_res.size());
-    std::vector<std::string> tmp = split(t_db_res,'|');
-    uint32_t raddr = stoull(tmp[0], nullptr, 16);
-    uint32_t rmask = stoull(tmp[2], nullptr, 16);
-    uint32_t rsize = stoull(tmp[4], nullptr, 16);
-    std::string rmode = tmp[3];
-    std::string rperm = tmp[1];
-    LOGGER->log_message(LogManager::DEBUG, stdsprintf("node %s properties: 0x%x  0x%x  0x%x  %s  %s",
-                                                      regName.c_str(), raddr, rmask, rsize, rmode.c_str(), rperm.c_str()));
+  const RegInfo *reg = getRegInfo(la, regName);
+  if (reg) {
+    LOGGER->log_message(LogManager::DEBUG, stdsprintf("node %s properties: 0x%x  0x%x  0x%x  %d  %d",
+                                                      regName.c_str(), reg->address, reg->mask, reg->size, reg->mode, reg->perm));
 
-    if (rmask != 0xFFFFFFFF) {
+    if (reg->mask != 0xFFFFFFFF) {
       // deny block write on masked register
       std::stringstream errmsg;
       errmsg << "Block write attempted on masked register";
       la->response->set_string("error", errmsg.str());
       LOGGER->log_message(LogManager::ERROR, stdsprintf("block write error: %s", errmsg.str().c_str()));
-    } else if (rmode.rfind("single") != std::string::npos && size > 1) {
+    } else if (reg->mode == REG_MODE_SINGLE && size > 1) {
       // only allow block write of size 1 on single registers
       std::stringstream errmsg;
       errmsg << "Block write attempted on single register with size greater than 1";
       la->response->set_string("error", errmsg.str());
       LOGGER->log_message(LogManager::ERROR, stdsprintf("block write error: %s", errmsg.str().c_str()));
-    } else if ((offset+size) > rsize) {
+    } else if ((offset+size) > reg->size) {
       // don't allow the write to go beyond the block range
       std::stringstream errmsg;
       errmsg << "Block write attempted would go beyond the size of the RAM: "
-             << "raddr: 0x"    << std::hex << raddr
+             << "raddr: 0x"    << std::hex << reg->address
              << ", offset: 0x" << std::hex << offset
              << ", size: 0x"   << std::hex << size
-             << ", rsize: 0x"  << std::hex << rsize;
+             << ", rsize: 0x"  << std::hex << reg->size;
       la->response->set_string("error", errmsg.str());
       LOGGER->log_message(LogManager::ERROR, stdsprintf("block write error: %s", errmsg.str().c_str()));
     } else {
-      if (memhub_write(memsvc, raddr+offset, size, values) != 0) {
+      if (memhub_write(memsvc, reg->address+offset, size, values) != 0) {
         std::stringstream errmsg;
         errmsg << "Write memsvc error: " << memsvc_get_last_error(memsvc);
         la->response->set_string("error", errmsg.str());
@@ -497,7 +1088,10 @@ extern "C" {
       LOGGER->log_message(LogManager::ERROR, "Unable to load module");
       return; // Do not register our functions, we depend on memsvc.
     }
+    openAddressTable(); // retried on the first call if the address table is not available yet
     modmgr->register_method("utils", "update_address_table", update_address_table);
     modmgr->register_method("utils", "readRegFromDB",        readRegFromDB);
+    modmgr->register_method("utils", "memhubStats",          memhubStats);
+    modmgr->register_method("utils", "fetchResult",          fetchResult);
   }
 }
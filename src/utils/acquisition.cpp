@@ -0,0 +1,68 @@
+/*!
+ * \file utils/acquisition.cpp
+ * \brief Time, event and byte budgets of a readout loop
+ */
+
+#include "utils/acquisition.h"
+
+#include <algorithm>
+
+AcquisitionControl::AcquisitionControl(uint32_t timeMs, uint64_t maxEvents, uint64_t maxBytes) :
+  m_duration(timeMs),
+  m_maxEvents(maxEvents),
+  m_maxBytes(maxBytes),
+  m_started(false),
+  m_stopReason(RUNNING),
+  m_readouts(0),
+  m_events(0),
+  m_bytes(0),
+  m_liveNs(0)
+{
+}
+
+void AcquisitionControl::limitBytes(uint64_t maxBytes)
+{
+  if (m_maxBytes == 0 || maxBytes < m_maxBytes)
+    m_maxBytes = maxBytes;
+}
+
+void AcquisitionControl::start()
+{
+  m_started    = true;
+  m_stopReason = RUNNING;
+  m_start      = Clock::now();
+}
+
+bool AcquisitionControl::running()
+{
+  if (m_stopReason != RUNNING)
+    return false;
+  if (!m_started)
+    start();
+
+  Clock::time_point now = Clock::now();
+  if (m_maxEvents && m_events >= m_maxEvents)
+    m_stopReason = EVENTS;
+  else if (m_maxBytes && m_bytes >= m_maxBytes)
+    m_stopReason = BYTES;
+  else if (now-m_start >= m_duration)
+    m_stopReason = TIME;
+  else
+    return true;
+
+  m_stop = now;
+  return false;
+}
+
+uint64_t AcquisitionControl::elapsedUs() const
+{
+  if (!m_started)
+    return 0;
+  Clock::time_point end = m_stopReason == RUNNING ? Clock::now() : m_stop;
+  return std::chrono::duration_cast<std::chrono::microseconds>(end-m_start).count();
+}
+
+uint64_t AcquisitionControl::liveUs() const
+{
+  return std::min(m_liveNs/1000, elapsedUs());
+}
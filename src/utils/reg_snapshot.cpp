@@ -0,0 +1,55 @@
+/*!
+ * \file utils/reg_snapshot.cpp
+ * \brief Save and restore of the register state changed by a scan
+ */
+
+#include "utils/reg_snapshot.h"
+
+#include <exception>
+
+RegSnapshot::RegSnapshot(LocalArgs * la) :
+  m_la(la)
+{
+}
+
+RegSnapshot::RegSnapshot(LocalArgs * la, const std::vector<RegHandle> & regs) :
+  m_la(la)
+{
+  capture(regs);
+}
+
+RegSnapshot::~RegSnapshot()
+{
+  if (m_regs.empty())
+    return;
+  try {
+    restore();
+  } catch (const std::exception& e) {
+    LOGGER->log_message(LogManager::ERROR, stdsprintf("Restoring %zu registers failed: %s", m_regs.size(), e.what()));
+  }
+}
+
+uint32_t RegSnapshot::capture(const std::vector<RegHandle> & regs)
+{
+  size_t offset = m_regs.size();
+  m_regs.insert(m_regs.end(), regs.begin(), regs.end());
+  m_values.resize(m_regs.size());
+  return readRegs(m_la, regs, m_values.data()+offset);
+}
+
+uint32_t RegSnapshot::restore()
+{
+  RegWriteBatch writes(m_la);
+  for (size_t idx = 0; idx < m_regs.size(); ++idx) {
+    if (m_regs[idx].valid && m_values[idx] != 0xdeaddead)
+      writes.add(m_regs[idx], m_values[idx]);
+  }
+  release();
+  return writes.commit();
+}
+
+void RegSnapshot::release()
+{
+  m_regs.clear();
+  m_values.clear();
+}
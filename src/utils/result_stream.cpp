@@ -0,0 +1,251 @@
+/*!
+ * \file utils/result_stream.cpp
+ * \brief Chunked delivery of large RPC results
+ */
+
+#include "utils/result_stream.h"
+
+#include <algorithm>
+
+namespace {
+  std::mutex resultJobsMutex;
+  std::map<uint32_t, std::shared_ptr<ResultJob> > resultJobs;
+  uint32_t nextJobId = 1;
+
+  /// \var job bound to this thread by ResultJobScope
+  thread_local std::shared_ptr<ResultJob> boundJob;
+}
+
+ResultStream::ResultStream(size_t capacity) :
+  m_capacity(capacity),
+  m_closed(false),
+  m_total(0)
+{
+}
+
+void ResultStream::push(const uint32_t * data, size_t words)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (words > 0 && !m_closed) {
+    if (m_capacity > 0) {
+      m_notFull.wait(lock, [this] { return m_closed || m_words.size() < m_capacity; });
+      if (m_closed)
+        break;
+    }
+    size_t n = m_capacity > 0 ? std::min(words, m_capacity-m_words.size()) : words;
+    m_words.insert(m_words.end(), data, data+n);
+    m_total += n;
+    data    += n;
+    words   -= n;
+  }
+}
+
+size_t ResultStream::fetch(std::vector<uint32_t> & out, size_t maxWords)
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  size_t n = std::min(maxWords, m_words.size());
+  out.insert(out.end(), m_words.begin(), m_words.begin()+n);
+  m_words.erase(m_words.begin(), m_words.begin()+n);
+  if (n > 0)
+    m_notFull.notify_all();
+  return n;
+}
+
+void ResultStream::close()
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_closed = true;
+  m_notFull.notify_all();
+}
+
+bool ResultStream::closed() const
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_closed;
+}
+
+bool ResultStream::drained() const
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_closed && m_words.empty();
+}
+
+size_t ResultStream::size() const
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_words.size();
+}
+
+uint64_t ResultStream::total() const
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_total;
+}
+
+ResultJob::ResultJob(size_t capacity) :
+  m_capacity(capacity),
+  m_closed(false),
+  m_id(0)
+{
+}
+
+ResultStream & ResultJob::stream(const std::string & key)
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  auto & stream = m_streams[key];
+  if (!stream) {
+    stream.reset(new ResultStream(m_capacity));
+    if (m_closed)
+      stream->close();
+  }
+  return *stream;
+}
+
+ResultStream * ResultJob::find(const std::string & key)
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  auto stream = m_streams.find(key);
+  return stream == m_streams.end() ? nullptr : stream->second.get();
+}
+
+std::vector<std::string> ResultJob::keys() const
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  std::vector<std::string> keys;
+  for (auto const& stream : m_streams)
+    keys.push_back(stream.first);
+  return keys;
+}
+
+void ResultJob::close()
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_closed = true;
+  for (auto & stream : m_streams)
+    stream.second->close();
+}
+
+bool ResultJob::closed() const
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_closed;
+}
+
+bool ResultJob::drained() const
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  for (auto const& stream : m_streams)
+    if (!stream.second->drained())
+      return false;
+  return true;
+}
+
+uint32_t registerResultJob(std::shared_ptr<ResultJob> job)
+{
+  std::lock_guard<std::mutex> guard(resultJobsMutex);
+  if (resultJobs.size() >= RESULT_MAX_JOBS) {
+    // ids increase, so the first job is the oldest one
+    LOGGER->log_message(LogManager::WARNING, stdsprintf("Too many result jobs, dropping job %u", resultJobs.begin()->first));
+    resultJobs.begin()->second->close();
+    resultJobs.erase(resultJobs.begin());
+  }
+  uint32_t jobId = nextJobId++;
+  job->m_id = jobId;
+  resultJobs.emplace(jobId, job);
+  return jobId;
+}
+
+std::shared_ptr<ResultJob> findResultJob(uint32_t jobId)
+{
+  std::lock_guard<std::mutex> guard(resultJobsMutex);
+  auto job = resultJobs.find(jobId);
+  return job == resultJobs.end() ? nullptr : job->second;
+}
+
+void releaseResultJob(uint32_t jobId)
+{
+  std::lock_guard<std::mutex> guard(resultJobsMutex);
+  auto job = resultJobs.find(jobId);
+  if (job != resultJobs.end()) {
+    job->second->close();
+    resultJobs.erase(job);
+  }
+}
+
+ResultJobScope::ResultJobScope(std::shared_ptr<ResultJob> job) :
+  m_previous(boundJob)
+{
+  boundJob = job;
+}
+
+ResultJobScope::~ResultJobScope()
+{
+  boundJob = m_previous;
+}
+
+std::shared_ptr<ResultJob> startResultJob()
+{
+  auto job = std::make_shared<ResultJob>(RESULT_STREAM_CAPACITY);
+  registerResultJob(job);
+  return job;
+}
+
+std::shared_ptr<ResultJob> resultJobFor(const RPCMsg *request)
+{
+  if (boundJob)
+    return boundJob;
+  if (request->get_key_exists("stream"))
+    return std::make_shared<ResultJob>();
+  return nullptr;
+}
+
+void setResultArray(RPCMsg *response, ResultJob *job, const std::string & key, const uint32_t *data, size_t words)
+{
+  if (job) {
+    ResultStream & stream = job->stream(key);
+    stream.push(data, words);
+    stream.close();
+  } else {
+    response->set_word_array(key, const_cast<uint32_t*>(data), words);
+  }
+}
+
+void publishResultJob(RPCMsg *response, std::shared_ptr<ResultJob> job)
+{
+  job->close();
+  response->set_word("jobId", job->id() ? job->id() : registerResultJob(job));
+  for (auto const& key : job->keys())
+    response->set_word(key+".size", job->find(key)->total());
+}
+
+void fetchResult(const RPCMsg *request, RPCMsg *response)
+{
+  uint32_t jobId = request->get_word("jobId");
+  std::string key = request->get_string("key");
+  size_t maxWords = RESULT_CHUNK_WORDS;
+  if (request->get_key_exists("maxWords"))
+    maxWords = std::min<size_t>(request->get_word("maxWords"), RESULT_CHUNK_WORDS);
+
+  std::shared_ptr<ResultJob> job = findResultJob(jobId);
+  ResultStream *stream = job ? job->find(key) : nullptr;
+  if (job && !stream && !job->closed())
+    stream = &job->stream(key); // not set yet by the running method
+  if (!stream) {
+    std::string errmsg = stdsprintf("No result %s for job %u", key.c_str(), jobId);
+    response->set_string("error", errmsg);
+    LOGGER->log_message(LogManager::ERROR, errmsg);
+    return;
+  }
+
+  std::vector<uint32_t> data;
+  data.reserve(std::min(maxWords, stream->size()));
+  stream->fetch(data, maxWords);
+  bool done = stream->drained();
+
+  response->set_word_array("data", data);
+  response->set_word("remaining", stream->size());
+  response->set_word("done", done);
+
+  if (done && job->drained())
+    releaseResultJob(jobId);
+}
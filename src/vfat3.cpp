@@ -632,6 +632,7 @@ extern "C" {
             LOGGER->log_message(LogManager::ERROR, "Unable to load module");
             return; // Do not register our functions, we depend on memsvc.
         }
+        openAddressTable(); // retried on the first call if the address table is not available yet
         modmgr->register_method("vfat3", "configureVFAT3s", configureVFAT3s);
         modmgr->register_method("vfat3", "configureVFAT3DacMonitor", configureVFAT3DacMonitor);
         modmgr->register_method("vfat3", "configureVFAT3DacMonitorMultiLink", configureVFAT3DacMonitorMultiLink);